@@ -0,0 +1,185 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cxxabi.h>
+#include <iomanip>
+#include <mutex>
+#include <string>
+#include "arena.hpp"
+
+namespace holeyc{
+
+static const size_t FIRST_CHUNK = 64 * 1024;
+static const size_t MAX_CHUNK = 8 * 1024 * 1024;
+
+/*
+Kind names are shared by every arena in the process, so the
+registry is guarded for the benefit of concurrent compilations.
+*/
+static std::mutex kindLock;
+
+static std::vector<std::string>& kindNames(){
+	static std::vector<std::string> names;
+	return names;
+}
+
+size_t Arena::registerKind(const char * mangledName){
+	int status = 0;
+	char * demangled = abi::__cxa_demangle(mangledName,
+		nullptr, nullptr, &status);
+	std::string name = status == 0 ? demangled : mangledName;
+	std::free(demangled);
+	for (const char * noise : {"holeyc::", "__cxx11::"}){
+		size_t at;
+		while ((at = name.find(noise)) != std::string::npos){
+			name.erase(at, std::string(noise).size());
+		}
+	}
+	const std::string listPrefix = "std::list<";
+	const std::string nodePrefix = "std::_List_node<";
+	if (name.compare(0, listPrefix.size(), listPrefix) == 0){
+		size_t comma = name.find(", ArenaAllocator<");
+		name = "NodeList<" + name.substr(listPrefix.size(),
+			comma - listPrefix.size()) + ">";
+	} else if (name.compare(0, nodePrefix.size(), nodePrefix) == 0){
+		name = "NodeList<" + name.substr(nodePrefix.size()) + " (links)";
+	}
+
+	std::lock_guard<std::mutex> guard(kindLock);
+	kindNames().push_back(name);
+	return kindNames().size() - 1;
+}
+
+/* Returns the bytes given back */
+size_t Arena::freeChunks(Chunk * chunks){
+	size_t freed = 0;
+	while (chunks != nullptr){
+		Chunk * prev = chunks->prev;
+		freed += chunks->size;
+		std::free(chunks);
+		chunks = prev;
+	}
+	return freed;
+}
+
+Arena::Arena()
+: myCur(0), myEnd(0), myChunks(nullptr), myOldChunks(nullptr),
+  mySpareChunks(nullptr), myNextChunkSize(FIRST_CHUNK), myReserved(0),
+  myPeakReserved(0), myCleanups(nullptr), myOldCleanups(nullptr){
+}
+
+Arena::~Arena(){
+	runCleanups(myCleanups);
+	runCleanups(myOldCleanups);
+	freeChunks(myChunks);
+	freeChunks(myOldChunks);
+	freeChunks(mySpareChunks);
+}
+
+void Arena::runCleanups(Cleanup * cleanups){
+	for (Cleanup * c = cleanups; c != nullptr; c = c->next){
+		c->fn(c->obj);
+	}
+}
+
+void Arena::recycle(){
+	runCleanups(myOldCleanups);
+	/* Keep the old generation's chunks for the new one; any spares
+	   it did not need go back to the system */
+	myReserved -= freeChunks(mySpareChunks);
+	mySpareChunks = myOldChunks;
+	myOldChunks = myChunks;
+	myOldCleanups = myCleanups;
+	myChunks = nullptr;
+	myCleanups = nullptr;
+	myCur = 0;
+	myEnd = 0;
+	myNextChunkSize = FIRST_CHUNK;
+}
+
+void * Arena::allocateSlow(size_t size, size_t align){
+	size_t need = sizeof(Chunk) + size + align;
+	Chunk * chunk = nullptr;
+	if (mySpareChunks != nullptr && mySpareChunks->size >= need){
+		chunk = mySpareChunks;
+		mySpareChunks = chunk->prev;
+	} else {
+		size_t chunkSize = myNextChunkSize;
+		if (need > chunkSize){ chunkSize = need; }
+		if (myNextChunkSize < MAX_CHUNK){ myNextChunkSize *= 2; }
+		chunk = static_cast<Chunk *>(std::malloc(chunkSize));
+		if (chunk == nullptr){ throw std::bad_alloc(); }
+		chunk->size = chunkSize;
+		myReserved += chunkSize;
+		myPeakReserved = std::max(myPeakReserved, myReserved);
+	}
+	chunk->prev = myChunks;
+	myChunks = chunk;
+
+	myCur = reinterpret_cast<uintptr_t>(chunk + 1);
+	myEnd = reinterpret_cast<uintptr_t>(chunk) + chunk->size;
+	return allocate(size, align);
+}
+
+void Arena::addCleanup(void * obj, void (*fn)(void *)){
+	Cleanup * c = static_cast<Cleanup *>(
+		allocate(sizeof(Cleanup), alignof(Cleanup)));
+	c->fn = fn;
+	c->obj = obj;
+	c->next = myCleanups;
+	myCleanups = c;
+}
+
+void Arena::report(std::ostream& out,
+	const std::vector<const Arena *>& arenas){
+	std::vector<std::string> names;
+	{
+		std::lock_guard<std::mutex> guard(kindLock);
+		names = kindNames();
+	}
+	std::vector<KindStats> stats;
+	size_t reserved = 0;
+	size_t peak = 0;
+	for (const Arena * arena : arenas){
+		if (arena->myStats.size() > stats.size()){
+			stats.resize(arena->myStats.size(), {0, 0});
+		}
+		for (size_t k = 0; k < arena->myStats.size(); k++){
+			stats[k].count += arena->myStats[k].count;
+			stats[k].bytes += arena->myStats[k].bytes;
+		}
+		reserved += arena->myReserved;
+		peak += arena->myPeakReserved;
+	}
+	std::vector<size_t> order;
+	for (size_t k = 0; k < stats.size(); k++){
+		if (stats[k].count != 0){ order.push_back(k); }
+	}
+	/* Ties go by name: kind ids depend on which thread got there first */
+	std::sort(order.begin(), order.end(), [&](size_t a, size_t b){
+		if (stats[a].bytes != stats[b].bytes){
+			return stats[a].bytes > stats[b].bytes;
+		}
+		return names[a] < names[b];
+	});
+
+	size_t totalCount = 0;
+	size_t totalBytes = 0;
+	out << std::left << std::setw(48) << "kind"
+		<< std::right << std::setw(12) << "count"
+		<< std::setw(14) << "bytes" << "\n";
+	for (size_t k : order){
+		out << std::left << std::setw(48) << names[k]
+			<< std::right << std::setw(12) << stats[k].count
+			<< std::setw(14) << stats[k].bytes << "\n";
+		totalCount += stats[k].count;
+		totalBytes += stats[k].bytes;
+	}
+	out << std::left << std::setw(48) << "total"
+		<< std::right << std::setw(12) << totalCount
+		<< std::setw(14) << totalBytes << "\n";
+	out << "reserved " << reserved << " bytes";
+	if (peak != reserved){ out << " (peak " << peak << ")"; }
+	out << "\n";
+}
+
+} //End namespace holeyc
@@ -0,0 +1,185 @@
+#ifndef HOLEYC_ARENA_HPP
+#define HOLEYC_ARENA_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <new>
+#include <ostream>
+#include <type_traits>
+#include <typeinfo>
+#include <utility>
+#include <vector>
+
+namespace holeyc{
+
+/**
+* \class Arena
+* Bump-pointer region owning every Token, ASTNode and AST list built
+* during one compilation. Objects are never freed one at a time: the
+* whole region (and any destructors it has to run) is released at
+* once when the Arena is destroyed, or a generation at a time by
+* recycle().
+**/
+class Arena{
+public:
+	Arena();
+	~Arena();
+	Arena(const Arena&) = delete;
+	Arena& operator=(const Arena&) = delete;
+
+	/** Construct a T in the arena, charging its bytes to T's kind **/
+	template <typename T, typename... Args>
+	T * make(Args&&... args){
+		void * mem = allocate(sizeof(T), alignof(T));
+		T * obj = new (mem) T(std::forward<Args>(args)...);
+		if (needsCleanup<T>()){
+			addCleanup(obj, &destroy<T>);
+		}
+		charge(kindID<T>(), sizeof(T));
+		return obj;
+	}
+
+	/** Storage for n Ts that is not constructed here, charged to T **/
+	template <typename T>
+	T * allocateArray(size_t n){
+		charge(kindID<T>(), n * sizeof(T));
+		return static_cast<T *>(allocate(n * sizeof(T), alignof(T)));
+	}
+
+	/** Raw, uncharged storage **/
+	void * allocate(size_t size, size_t align){
+		size_t at = (myCur + align - 1) & ~(align - 1);
+		if (at + size > myEnd){
+			return allocateSlow(size, align);
+		}
+		myCur = at + size;
+		return reinterpret_cast<void *>(at);
+	}
+
+	/**
+	* Start a new generation. Everything made before the previous
+	* call is destroyed and its storage reused; what was made since
+	* (say, a parser's lookahead token) stays valid until the next
+	* call. Lets a streaming parse run in bounded memory.
+	**/
+	void recycle();
+
+	/** Total bytes reserved from the system (and still held) **/
+	size_t bytesReserved() const { return myReserved; }
+
+	/** Print a per-kind breakdown of the bytes handed out **/
+	void report(std::ostream& out) const { report(out, {this}); }
+
+	/** The same breakdown, summed over several arenas **/
+	static void report(std::ostream& out,
+		const std::vector<const Arena *>& arenas);
+
+private:
+	struct Chunk{
+		Chunk * prev;
+		size_t size;
+	};
+	struct Cleanup{
+		void (*fn)(void *);
+		void * obj;
+		Cleanup * next;
+	};
+	struct KindStats{
+		size_t count;
+		size_t bytes;
+	};
+
+	template <typename T>
+	static void destroy(void * obj){
+		static_cast<T *>(obj)->~T();
+	}
+
+	/** Lists whose storage already lives in the arena need no cleanup **/
+	template <typename T>
+	static constexpr bool needsCleanup();
+
+	/** Dense per-type index used to bucket the statistics **/
+	template <typename T>
+	static size_t kindID(){
+		static const size_t id = registerKind(typeid(T).name());
+		return id;
+	}
+
+	static size_t registerKind(const char * mangledName);
+	static void runCleanups(Cleanup * cleanups);
+	static size_t freeChunks(Chunk * chunks);
+	void * allocateSlow(size_t size, size_t align);
+	void addCleanup(void * obj, void (*fn)(void *));
+	void charge(size_t kind, size_t bytes){
+		if (kind >= myStats.size()){ myStats.resize(kind + 1, {0, 0}); }
+		myStats[kind].count++;
+		myStats[kind].bytes += bytes;
+	}
+
+	uintptr_t myCur;
+	uintptr_t myEnd;
+	Chunk * myChunks;
+	Chunk * myOldChunks;   /// The previous generation's, see recycle()
+	Chunk * mySpareChunks; /// Freed by recycle(), for reuse
+	size_t myNextChunkSize;
+	size_t myReserved;
+	size_t myPeakReserved; /// Differs from myReserved after recycle()
+	Cleanup * myCleanups;
+	Cleanup * myOldCleanups;
+	std::vector<KindStats> myStats;
+};
+
+/**
+* STL allocator that carves its storage out of an Arena. Deallocation
+* is a no-op; the memory goes away with the arena.
+**/
+template <typename T>
+class ArenaAllocator{
+public:
+	using value_type = T;
+
+	ArenaAllocator(Arena& arena) : myArena(&arena){ }
+	template <typename U>
+	ArenaAllocator(const ArenaAllocator<U>& other)
+	: myArena(other.arena()){ }
+
+	T * allocate(size_t n){
+		return myArena->allocateArray<T>(n);
+	}
+	void deallocate(T *, size_t){ }
+
+	Arena * arena() const { return myArena; }
+private:
+	Arena * myArena;
+};
+
+template <typename T, typename U>
+bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b){
+	return a.arena() == b.arena();
+}
+
+template <typename T, typename U>
+bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b){
+	return !(a == b);
+}
+
+/** The list type used for every sequence in the AST **/
+template <typename T>
+using NodeList = std::list<T, ArenaAllocator<T>>;
+
+template <typename T>
+struct ArenaStorageOnly : std::false_type{ };
+
+template <typename T>
+struct ArenaStorageOnly<NodeList<T>> : std::is_trivially_destructible<T>{ };
+
+template <typename T>
+constexpr bool Arena::needsCleanup(){
+	return !std::is_trivially_destructible<T>::value
+		&& !ArenaStorageOnly<T>::value;
+}
+
+} //End namespace holeyc
+
+#endif
@@ -1,9 +1,11 @@
 #ifndef HOLEYC_AST_HPP
 #define HOLEYC_AST_HPP
 
-#include <ostream>
-#include <list>
+#include "arena.hpp"
+#include "flat_ast.hpp"
+#include "writer.hpp"
 #include "tokens.hpp"
+#include "types.hpp"
 
 // **********************************************************************
 // ASTnode class (base class for all other kinds of nodes)
@@ -14,6 +16,7 @@ namespace holeyc{
 /* You may find it useful to forward declare AST subclasses
    here so that you can use a class before it's full definition
 */
+class ASTNode;
 class DeclListNode;
 class DeclNode;
 class TypeNode;
@@ -21,29 +24,50 @@ class IDNode;
 class StmtNode;
 class LValNode;
 
+/**
+* The concrete class of a node, one per class that can be
+* instantiated. Passes dispatch on it (see ASTVisitor in visitor.hpp)
+* rather than through virtual methods, so nodes carry no vtable.
+**/
+enum class NodeKind : uint8_t{
+	Program, VarDecl, FormalDecl, FnDecl, FormalsList, StmtList, FnBody,
+	IntType, BoolType, CharType, VoidType, IntPtr, BoolPtr, CharPtr,
+	AssignStmt, CallStmt, FromConsole, ToConsole, PostInc, PostDec,
+	If, IfElse, While, Return,
+	AssignExp, CallExp, Plus, Minus, Times, Divide, And, Or, Equals,
+	NotEquals, Less, Greater, LessEq, GreaterEq, Neg, Not,
+	ID, IntLit, CharLit, StrLit, True, False, NullPtr, Deref, Ref, Index,
+};
+
 class ASTNode{
 public:
-	ASTNode(size_t lineIn, size_t colIn)
-	: l(lineIn), c(colIn){
+	ASTNode(NodeKind kindIn, SourcePos posIn)
+	: myPos(posIn), myKind(kindIn), myShared(false){
 	}
-	virtual void unparse(std::ostream& out, int indent) = 0;
-	size_t line(){ return l; }
-	size_t col() { return c; }
-
+	/** Print this subtree; any depth is fine (see UnparseStack) **/
+	void unparse(Writer& out, int indent);
 	/**
-	* Return a string specifying the position this node begins.
-	* For some node a position doesn't really make sense (i.e.
-	* ProgramNode) but for the rest it's the position in the
-	* input file that represents that node
+	* Append this subtree to flat and return its root's index. lines
+	* turns node positions into the flat AST's lines and columns.
 	**/
-	std::string pos(){
-		return "[" + std::to_string(line()) + ","
-		+ std::to_string(col()) + "]";
-	}
+	FlatAST::NodeID flatten(FlatAST& flat, const LineTable& lines);
+	NodeKind kind() const { return myKind; }
+	/**
+	* Where the node starts, as an offset into the input file; resolve
+	* it to a line and column with the file's LineTable
+	**/
+	SourcePos pos() const { return myPos; }
+	/**
+	* Built by an ExpTable (-h): the node may have several parents,
+	* and its position is that of its first occurrence
+	**/
+	bool shared() const { return myShared; }
+	void markShared(){ myShared = true; }
 
 private:
-	size_t l; /// The line at which the node starts in the input file
-	size_t c; /// The column at which the node starts in the input file
+	SourcePos myPos;
+	NodeKind myKind;
+	bool myShared;
 };
 
 /**
@@ -55,18 +79,25 @@ private:
 **/
 class ProgramNode : public ASTNode{
 public:
-	ProgramNode(std::list<DeclNode *> * globalsIn)
-	: ASTNode(1, 1), myGlobals(globalsIn){
+	ProgramNode(NodeList<DeclNode *> * globalsIn)
+	: ASTNode(NodeKind::Program, 0), myGlobals(globalsIn){
 	}
-	void unparse(std::ostream& out, int indent) override;
+	NodeList<DeclNode *> * globals(){ return myGlobals; }
+	/** Globals and function signatures only, one per line (-i) **/
+	void unparseInterface(Writer& out);
+	/**
+	* Unparse with the type of each linked name after it, e.g. x(int)
+	* or f(int,bool->void) (-n); see NameAnalysis
+	**/
+	void unparseNames(Writer& out);
 private:
-	std::list<DeclNode * > * myGlobals;
+	NodeList<DeclNode * > * myGlobals;
 };
 
 class StmtNode : public ASTNode{
 public:
-	StmtNode(size_t lineIn, size_t colIn) : ASTNode(lineIn, colIn){ }
-	virtual void unparse(std::ostream& out, int indent) override = 0;
+	StmtNode(NodeKind kind, SourcePos posIn)
+	: ASTNode(kind, posIn){ }
 };
 
 /** \class DeclNode
@@ -75,10 +106,24 @@ public:
 **/
 class DeclNode : public StmtNode{
 public:
-	DeclNode(size_t line, size_t col)
-	: StmtNode(line, col) {
+	DeclNode(NodeKind kind, SourcePos pos)
+	: StmtNode(kind, pos) {
 	}
-	void unparse(std::ostream& out, int indent) override = 0;
+	/** This declaration as it appears in an interface (-i) **/
+	void unparseInterface(Writer& out);
+};
+
+/**
+* \class DeclSink
+* Takes each top-level declaration as soon as the parser has built
+* it, instead of the program's list of globals (streaming, -s). The
+* declaration, and everything it points to, may be freed once
+* declParsed returns.
+**/
+class DeclSink{
+public:
+	virtual ~DeclSink(){ }
+	virtual void declParsed(DeclNode * decl) = 0;
 };
 
 /**  \class ExpNode
@@ -87,16 +132,25 @@ public:
 * should inherit from this abstract superclass.
 **/
 class ExpNode : public ASTNode{
+public:
+	/** The type the checker gave this expression; nullptr before it ran **/
+	const DataType * type() const;
+	bool typed() const { return myType != TypeCode::Unchecked; }
+	void setType(const DataType * type){ myType = type->code(); }
 protected:
-	ExpNode(size_t line, size_t col)
-	: ASTNode(line, col){
+	ExpNode(NodeKind kind, SourcePos pos)
+	: ASTNode(kind, pos), myType(TypeCode::Unchecked){
 	}
+private:
+	/* One byte, which fits in ASTNode's tail padding, so typed nodes
+	   are no bigger than untyped ones */
+	TypeCode myType;
 };
 
 class LValNode : public ExpNode{
 public:
-	LValNode(size_t lineIn, size_t colIn): ExpNode(lineIn, colIn){ }
-	virtual void unparse(std::ostream& out, int indent) override = 0;
+	LValNode(NodeKind kind, SourcePos posIn)
+	: ExpNode(kind, posIn){ }
 };
 
 /**  \class TypeNode
@@ -106,13 +160,13 @@ public:
 **/
 class TypeNode : public ASTNode{
 protected:
-	TypeNode(size_t lineIn, size_t colIn, bool refIn)
-	: ASTNode(lineIn, colIn), myIsReference(refIn){
+	TypeNode(NodeKind kind, SourcePos posIn, bool refIn)
+	: ASTNode(kind, posIn), myIsReference(refIn){
 	}
 public:
-	virtual void unparse(std::ostream& out, int indent) = 0;
 	//TODO: consider adding an isRef to use in unparse to
 	// indicate if this is a reference type
+	bool isReference() const { return myIsReference; }
 private:
 	bool myIsReference;
 };
@@ -123,13 +177,22 @@ private:
 class IDNode : public LValNode{
 public:
 	IDNode(IDToken * token)
-	: LValNode(token->line(), token->col()), myStrVal(token->value()){
-		myStrVal = token->value();
+	: LValNode(NodeKind::ID, token->pos()),
+	  mySymbol(token->symbol()), myDecl(nullptr){
 	}
-	void unparse(std::ostream& out, int indent);
+	Symbol symbol() const { return mySymbol; }
+	StrRef name() const { return Interner::spelling(mySymbol); }
+	/**
+	* The declaration this name refers to (or, in a declaration, the
+	* one it declares); nullptr until name analysis has linked it, or
+	* if the name is undeclared
+	**/
+	DeclNode * decl() const { return myDecl; }
+	void link(DeclNode * decl){ myDecl = decl; }
 private:
-	/** The name of the identifier **/
-	std::string myStrVal;
+	/** The interned name of the identifier **/
+	Symbol mySymbol;
+	DeclNode * myDecl;
 };
 
 
@@ -147,10 +210,15 @@ private:
 **/
 class VarDeclNode : public DeclNode{
 public:
-	VarDeclNode(size_t l, size_t c, TypeNode * type, IDNode * id)
-	: DeclNode(type->line(), type->col()), myType(type), myId(id){
+	VarDeclNode(SourcePos pos, TypeNode * type, IDNode * id)
+	: VarDeclNode(NodeKind::VarDecl, type, id){
+	}
+	TypeNode * type(){ return myType; }
+	IDNode * id(){ return myId; }
+protected:
+	VarDeclNode(NodeKind kind, TypeNode * type, IDNode * id)
+	: DeclNode(kind, type->pos()), myType(type), myId(id){
 	}
-	void unparse(std::ostream& out, int indent);
 private:
 	TypeNode * myType;
 	IDNode * myId;
@@ -158,78 +226,73 @@ private:
 
 class IntTypeNode : public TypeNode{
 public:
-	IntTypeNode(size_t lineIn, size_t colIn, bool isRefIn)
-	: TypeNode(lineIn, colIn, isRefIn){
+	IntTypeNode(SourcePos posIn, bool isRefIn)
+	: TypeNode(NodeKind::IntType, posIn, isRefIn){
 	}
-	void unparse(std::ostream& out, int indent);
 };
 
 //start
 //TypeNode
 class CharTypeNode : public TypeNode{
 public:
-	CharTypeNode(size_t lineIn, size_t colIn, bool isRefIn)
-	: TypeNode(lineIn, colIn, isRefIn){
+	CharTypeNode(SourcePos posIn, bool isRefIn)
+	: TypeNode(NodeKind::CharType, posIn, isRefIn){
 	}
-	void unparse(std::ostream& out, int indent);
 };
 
 class BoolTypeNode : public TypeNode{
 public:
-	BoolTypeNode(size_t lineIn, size_t colIn, bool isRefIn)
-	: TypeNode(lineIn, colIn, isRefIn){
+	BoolTypeNode(SourcePos posIn, bool isRefIn)
+	: TypeNode(NodeKind::BoolType, posIn, isRefIn){
 	}
-	void unparse(std::ostream& out, int indent);
 };
 
 class VoidTypeNode : public TypeNode{
 public:
-	VoidTypeNode(size_t lineIn, size_t colIn, bool isRefIn)
-	: TypeNode(lineIn, colIn, isRefIn){
+	VoidTypeNode(SourcePos posIn, bool isRefIn)
+	: TypeNode(NodeKind::VoidType, posIn, isRefIn){
 	}
-	void unparse(std::ostream& out, int indent);
 };
 
 class IntPtrNode : public TypeNode{
 public:
-	IntPtrNode(size_t lineIn, size_t colIn, bool isRefIn)
-	: TypeNode(lineIn, colIn, isRefIn){
+	IntPtrNode(SourcePos posIn, bool isRefIn)
+	: TypeNode(NodeKind::IntPtr, posIn, isRefIn){
 	}
-	void unparse(std::ostream& out, int indent);
 };
 
 class CharPtrNode : public TypeNode{
 public:
-	CharPtrNode(size_t lineIn, size_t colIn, bool isRefIn)
-	: TypeNode(lineIn, colIn, isRefIn){
+	CharPtrNode(SourcePos posIn, bool isRefIn)
+	: TypeNode(NodeKind::CharPtr, posIn, isRefIn){
 	}
-	void unparse(std::ostream& out, int indent);
 };
 
 class BoolPtrNode : public TypeNode{
 public:
-	BoolPtrNode(size_t lineIn, size_t colIn, bool isRefIn)
-	: TypeNode(lineIn, colIn, isRefIn){
+	BoolPtrNode(SourcePos posIn, bool isRefIn)
+	: TypeNode(NodeKind::BoolPtr, posIn, isRefIn){
 	}
-	void unparse(std::ostream& out, int indent);
 };
 
 //ExpNode
 /*class AssignExpNode
 	- LValNode (destination lvalue)
 	- ExpNode (source expression)*/
-class AssignExpNode : public ExpNode{
-public:
-	AssignExpNode(size_t lineIn, size_t colIn, LValNode * tgt, ExpNode * src)
-	: ExpNode(lineIn, colIn){
-		myTgt = tgt;
-		mySrc = src;
-	}
-	void unparse(std::ostream& out, int indent) override;
-
-private:
-	LValNode * myTgt;
-	ExpNode * mySrc;
+class AssignExpNode : public ExpNode{
+public:
+	AssignExpNode(SourcePos posIn, LValNode * tgt, ExpNode * src)
+	: ExpNode(NodeKind::AssignExp, posIn){
+		myTgt = tgt;
+		mySrc = src;
+	}
+	LValNode * tgt(){ return myTgt; }
+	ExpNode * src(){ return mySrc; }
+	void setSrc(ExpNode * src){ mySrc = src; }
+
+private:
+	LValNode * myTgt;
+	ExpNode * mySrc;
 };
 
 /*class BinaryExpNode
@@ -237,15 +300,20 @@ private:
 	- ExpNode (the rhs operand of the operation)*/
 class BinaryExpNode : public ExpNode{
 public:
-	BinaryExpNode(
-		size_t lineIn, size_t colIn,
+	BinaryExpNode(NodeKind kind,
+		SourcePos posIn,
 		ExpNode * lhs, ExpNode * rhs)
-	: ExpNode(lineIn, colIn) {
+	: ExpNode(kind, posIn) {
 		this->myLHS = lhs;
 		this->myRHS = rhs;
 	}
-	virtual void unparse(std::ostream& out, int indent) override;
-	virtual std::string myOp() = 0;
+	ExpNode * lhs(){ return myLHS; }
+	ExpNode * rhs(){ return myRHS; }
+	/** Replace the operands, e.g. with their folded forms **/
+	void setOperands(ExpNode * lhs, ExpNode * rhs){
+		myLHS = lhs;
+		myRHS = rhs;
+	}
 protected:
 	ExpNode * myLHS;
 	ExpNode * myRHS;
@@ -253,113 +321,103 @@ protected:
 
 /*class PlusNode / MinusNode / etc
 	(no extra fields needed beyond superclass)*/
-class PlusNode : public BinaryExpNode{
-public:
-	PlusNode(size_t lineIn, size_t colIn,
-		ExpNode * lhs, ExpNode * rhs)
-	: BinaryExpNode(lineIn, colIn, lhs, rhs) { }
-	virtual std::string myOp() override { return " + "; }
-};
-
-class MinusNode : public BinaryExpNode{
-public:
-	MinusNode(size_t lineIn, size_t colIn,
-		ExpNode * lhs, ExpNode * rhs)
-	: BinaryExpNode(lineIn, colIn, lhs, rhs){ }
-	virtual std::string myOp() override { return " - "; }
-};
-
-class TimesNode : public BinaryExpNode{
-public:
-	TimesNode(size_t lineIn, size_t colIn,
-		ExpNode * lhs, ExpNode * rhs)
-	: BinaryExpNode(lineIn, colIn, lhs, rhs){ }
-	virtual std::string myOp() override { return " * "; }
-};
-
-class DivideNode : public BinaryExpNode{
-public:
-	DivideNode(size_t lineIn, size_t colIn,
-		ExpNode * lhs, ExpNode * rhs)
-	: BinaryExpNode(lineIn, colIn, lhs, rhs){ }
-	virtual std::string myOp() override { return " / "; }
-};
-
-class AndNode : public BinaryExpNode{
-public:
-	AndNode(size_t lineIn, size_t colIn,
-		ExpNode * lhs, ExpNode * rhs)
-	: BinaryExpNode(lineIn, colIn, lhs, rhs){ }
-	virtual std::string myOp() override { return " && "; }
-};
-
-class OrNode : public BinaryExpNode{
-public:
-	OrNode(size_t lineIn, size_t colIn,
-		ExpNode * lhs, ExpNode * rhs)
-	: BinaryExpNode(lineIn, colIn, lhs, rhs){ }
-	virtual std::string myOp() override { return " || "; }
-};
-
-class EqualsNode : public BinaryExpNode{
-public:
-	EqualsNode(size_t lineIn, size_t colIn,
-		ExpNode * lhs, ExpNode * rhs)
-	: BinaryExpNode(lineIn, colIn, lhs, rhs){ }
-	virtual std::string myOp() override { return " == "; }
-};
-
-class NotEqualsNode : public BinaryExpNode{
-public:
-	NotEqualsNode(size_t lineIn, size_t colIn,
-		ExpNode * lhs, ExpNode * rhs)
-	: BinaryExpNode(lineIn, colIn, lhs, rhs){ }
-	virtual std::string myOp() override { return " != "; }
-};
-
-class LessNode : public BinaryExpNode{
-public:
-	LessNode(size_t lineIn, size_t colIn,
-		ExpNode * lhs, ExpNode * rhs)
-	: BinaryExpNode(lineIn, colIn, lhs, rhs){ }
-	virtual std::string myOp() override { return " < "; }
-};
-
-class GreaterNode : public BinaryExpNode{
-public:
-	GreaterNode(size_t lineIn, size_t colIn,
-		ExpNode * lhs, ExpNode * rhs)
-	: BinaryExpNode(lineIn, colIn, lhs, rhs){ }
-	virtual std::string myOp() override { return " > "; }
-};
-
-class LessEqNode : public BinaryExpNode{
-public:
-	LessEqNode(size_t lineIn, size_t colIn,
-		ExpNode * lhs, ExpNode * rhs)
-	: BinaryExpNode(lineIn, colIn, lhs, rhs){ }
-	virtual std::string myOp() override { return " <= "; }
-};
-
-class GreaterEqNode : public BinaryExpNode{
-public:
-	GreaterEqNode(size_t lineIn, size_t colIn,
-		ExpNode * lhs, ExpNode * rhs)
-	: BinaryExpNode(lineIn, colIn, lhs, rhs){ }
-	virtual std::string myOp() override { return " >= "; }
+class PlusNode : public BinaryExpNode{
+public:
+	PlusNode(SourcePos posIn,
+		ExpNode * lhs, ExpNode * rhs)
+	: BinaryExpNode(NodeKind::Plus, posIn, lhs, rhs) { }
+};
+
+class MinusNode : public BinaryExpNode{
+public:
+	MinusNode(SourcePos posIn,
+		ExpNode * lhs, ExpNode * rhs)
+	: BinaryExpNode(NodeKind::Minus, posIn, lhs, rhs){ }
+};
+
+class TimesNode : public BinaryExpNode{
+public:
+	TimesNode(SourcePos posIn,
+		ExpNode * lhs, ExpNode * rhs)
+	: BinaryExpNode(NodeKind::Times, posIn, lhs, rhs){ }
+};
+
+class DivideNode : public BinaryExpNode{
+public:
+	DivideNode(SourcePos posIn,
+		ExpNode * lhs, ExpNode * rhs)
+	: BinaryExpNode(NodeKind::Divide, posIn, lhs, rhs){ }
+};
+
+class AndNode : public BinaryExpNode{
+public:
+	AndNode(SourcePos posIn,
+		ExpNode * lhs, ExpNode * rhs)
+	: BinaryExpNode(NodeKind::And, posIn, lhs, rhs){ }
+};
+
+class OrNode : public BinaryExpNode{
+public:
+	OrNode(SourcePos posIn,
+		ExpNode * lhs, ExpNode * rhs)
+	: BinaryExpNode(NodeKind::Or, posIn, lhs, rhs){ }
+};
+
+class EqualsNode : public BinaryExpNode{
+public:
+	EqualsNode(SourcePos posIn,
+		ExpNode * lhs, ExpNode * rhs)
+	: BinaryExpNode(NodeKind::Equals, posIn, lhs, rhs){ }
+};
+
+class NotEqualsNode : public BinaryExpNode{
+public:
+	NotEqualsNode(SourcePos posIn,
+		ExpNode * lhs, ExpNode * rhs)
+	: BinaryExpNode(NodeKind::NotEquals, posIn, lhs, rhs){ }
+};
+
+class LessNode : public BinaryExpNode{
+public:
+	LessNode(SourcePos posIn,
+		ExpNode * lhs, ExpNode * rhs)
+	: BinaryExpNode(NodeKind::Less, posIn, lhs, rhs){ }
+};
+
+class GreaterNode : public BinaryExpNode{
+public:
+	GreaterNode(SourcePos posIn,
+		ExpNode * lhs, ExpNode * rhs)
+	: BinaryExpNode(NodeKind::Greater, posIn, lhs, rhs){ }
+};
+
+class LessEqNode : public BinaryExpNode{
+public:
+	LessEqNode(SourcePos posIn,
+		ExpNode * lhs, ExpNode * rhs)
+	: BinaryExpNode(NodeKind::LessEq, posIn, lhs, rhs){ }
+};
+
+class GreaterEqNode : public BinaryExpNode{
+public:
+	GreaterEqNode(SourcePos posIn,
+		ExpNode * lhs, ExpNode * rhs)
+	: BinaryExpNode(NodeKind::GreaterEq, posIn, lhs, rhs){ }
 };
 
 class CallExpNode : public ExpNode{
 public:
-	CallExpNode(IDNode * id, std::list<ExpNode * > * expList)
-	: ExpNode(id->line(), id->col()){
+	CallExpNode(IDNode * id, NodeList<ExpNode * > * expList)
+	: ExpNode(NodeKind::CallExp, id->pos()){
 		myId = id;
 		myExpList = expList;
 	}
-	void unparse(std::ostream& out, int indent) override;
+	IDNode * id(){ return myId; }
+	/** The arguments; nullptr when there are none **/
+	NodeList<ExpNode *> * args(){ return myExpList; }
 private:
 	IDNode * myId;
-	std::list<ExpNode * > * myExpList;
+	NodeList<ExpNode * > * myExpList;
 };
 
 /*class CharLitNode
@@ -367,10 +425,10 @@ private:
 class CharLitNode : public ExpNode{
 public:
 	CharLitNode(CharLitToken * token)
-	: ExpNode(token->line(), token->col()){
+	: ExpNode(NodeKind::CharLit, token->pos()){
 		myChar = token->val();
 	}
-	void unparse(std::ostream& out, int indent) override;
+	char val() const { return myChar; }
 private:
 	char myChar;
 };
@@ -380,59 +438,60 @@ private:
 class IntLitNode : public ExpNode{
 public:
 	IntLitNode(IntLitToken * token)
-	: ExpNode(token->line(), token->col()){
+	: ExpNode(NodeKind::IntLit, token->pos()){
 		myInt = token->num();
 	}
-	void unparse(std::ostream& out, int indent) override;
+	/** A value computed by the compiler, e.g. by ConstantFold **/
+	IntLitNode(SourcePos posIn, int num)
+	: ExpNode(NodeKind::IntLit, posIn), myInt(num){
+	}
+	int num() const { return myInt; }
 private:
 	int myInt;
 };
 
 /*class StrLitNode
 - std::string (underlying string value)*/
-class StrLitNode : public ExpNode{
-public:
-	StrLitNode(StrToken * token)
-	: ExpNode(token->line(), token->col()){
-		myString = token->str();
-	}
-	void unparse(std::ostream& out, int indent) override;
-private:
-	 std::string myString;
-};
-
-class TrueNode : public ExpNode{
-public:
-	TrueNode(size_t lineIn, size_t colIn)
-	: ExpNode(lineIn, colIn){ }
-	void unparse(std::ostream& out, int indent) override;
-};
-
-class FalseNode : public ExpNode{
-public:
-	FalseNode(size_t lineIn, size_t colIn)
-	: ExpNode(lineIn, colIn){ }
-	void unparse(std::ostream& out, int indent) override;
+class StrLitNode : public ExpNode{
+public:
+	StrLitNode(StrToken * token)
+	: ExpNode(NodeKind::StrLit, token->pos()){
+		myString = token->str();
+	}
+	StrRef str() const { return myString; }
+private:
+	StrRef myString;
+};
+
+class TrueNode : public ExpNode{
+public:
+	TrueNode(SourcePos posIn)
+	: ExpNode(NodeKind::True, posIn){ }
+};
+
+class FalseNode : public ExpNode{
+public:
+	FalseNode(SourcePos posIn)
+	: ExpNode(NodeKind::False, posIn){ }
 };
 
 /*class NullPtrNode
 	(no extra fields needed beyond superclass)*/
 class NullPtrNode : public ExpNode{
 public:
-	NullPtrNode(size_t lineIn, size_t colIn)
-	: ExpNode(lineIn, colIn){ }
-	void unparse(std::ostream& out, int indent) override;
+	NullPtrNode(SourcePos posIn)
+	: ExpNode(NodeKind::NullPtr, posIn){ }
 };
 
 /*class DerefNode, for dereferencing an ID
 - IDNode (base ID being accessed)*/
 class DerefNode : public LValNode{
 public:
-	DerefNode(size_t line, size_t column, IDNode * Tgt)
-	: LValNode(line, column){
+	DerefNode(SourcePos pos, IDNode * Tgt)
+	: LValNode(NodeKind::Deref, pos){
 		myTgt = Tgt;
 	}
-	void unparse(std::ostream& out, int indent) override;
+	IDNode * tgt(){ return myTgt; }
 private:
 	IDNode * myTgt;
 };
@@ -442,12 +501,14 @@ private:
 - ExpNode (offset position from the ID start)*/
 class IndexNode : public LValNode{
 public:
-	IndexNode(size_t line, size_t column, IDNode * Tgt, ExpNode * Off)
-	: LValNode(line, column){
+	IndexNode(SourcePos pos, IDNode * Tgt, ExpNode * Off)
+	: LValNode(NodeKind::Index, pos){
 		myTgt = Tgt;
 		myOff = Off;
 	}
-	void unparse(std::ostream& out, int indent) override;
+	IDNode * tgt(){ return myTgt; }
+	ExpNode * off(){ return myOff; }
+	void setOff(ExpNode * off){ myOff = off; }
 private:
 	IDNode * myTgt;
 	ExpNode * myOff;
@@ -457,38 +518,38 @@ private:
 	- IDNode (base ID being accessed)*/
 class RefNode : public LValNode{
 public:
-	RefNode(size_t line, size_t column, IDNode * Tgt)
-	: LValNode(line, column){
+	RefNode(SourcePos pos, IDNode * Tgt)
+	: LValNode(NodeKind::Ref, pos){
 		myTgt = Tgt;
 	}
-	void unparse(std::ostream& out, int indent) override;
+	IDNode * tgt(){ return myTgt; }
 private:
 	IDNode * myTgt;
 };
 
 class UnaryExpNode : public ExpNode{
 public:
-	UnaryExpNode(size_t lineIn, size_t colIn, ExpNode * expIn)
-	: ExpNode(lineIn, colIn){
+	UnaryExpNode(NodeKind kind, SourcePos posIn,
+		ExpNode * expIn)
+	: ExpNode(kind, posIn){
 		this->myExp = expIn;
 	}
-	virtual void unparse(std::ostream& out, int indent) override = 0;
+	ExpNode * exp(){ return myExp; }
+	void setExp(ExpNode * exp){ myExp = exp; }
 protected:
 	ExpNode * myExp;
 };
 
 class NegNode : public UnaryExpNode{
 public:
-	NegNode(ExpNode * exp)
-	: UnaryExpNode(exp->line(), exp->col(), exp){ }
-	void unparse(std::ostream& out, int indent) override;
+	NegNode(SourcePos posIn, ExpNode * exp)
+	: UnaryExpNode(NodeKind::Neg, posIn, exp){ }
 };
 
 class NotNode : public UnaryExpNode{
 public:
-	NotNode(size_t lineIn, size_t colIn, ExpNode * exp)
-	: UnaryExpNode(lineIn, colIn, exp){ }
-	void unparse(std::ostream& out, int indent) override;
+	NotNode(SourcePos posIn, ExpNode * exp)
+	: UnaryExpNode(NodeKind::Not, posIn, exp){ }
 };
 
 //StmtNode
@@ -498,10 +559,10 @@ public:
 class AssignStmtNode : public StmtNode{
 public:
 	AssignStmtNode(AssignExpNode * assignment)
-	: StmtNode(assignment->line(), assignment->col()){
+	: StmtNode(NodeKind::AssignStmt, assignment->pos()){
 		myAssign = assignment;
 	}
-	void unparse(std::ostream& out, int indent) override;
+	AssignExpNode * assign(){ return myAssign; }
 private:
 	AssignExpNode * myAssign;
 };
@@ -511,10 +572,10 @@ private:
 class CallStmtNode : public StmtNode{
 public:
 	CallStmtNode(CallExpNode * callExp)
-	: StmtNode(callExp->line(), callExp->col()){
+	: StmtNode(NodeKind::CallStmt, callExp->pos()){
 		myCallExp = callExp;
 	}
-	void unparse(std::ostream& out, int indent) override;
+	CallExpNode * callExp(){ return myCallExp; }
 private:
 	CallExpNode * myCallExp;
 };
@@ -522,41 +583,53 @@ private:
 class FormalDeclNode : public VarDeclNode{
 public:
 	FormalDeclNode(TypeNode * type, IDNode * id)
-	: VarDeclNode(id->line(), id->col(), type, id), myType(type),myID(id){ }
-	void unparse(std::ostream& out, int indent) override;
-private:
-	TypeNode * myType;
-	IDNode * myID;
+	: VarDeclNode(NodeKind::FormalDecl, type, id){ }
 };
 
 class FormalsListNode : public ASTNode{
 public:
-	FormalsListNode(std::list<FormalDeclNode *>* formalsIn)
-	: ASTNode(0, 0), myFormals(formalsIn){ }
-	void unparse(std::ostream& out, int indent) override;
-	std::list<FormalDeclNode *> * GetFormals();
+	FormalsListNode(NodeList<FormalDeclNode *>* formalsIn)
+	: ASTNode(NodeKind::FormalsList, NO_POS), myFormals(formalsIn){ }
+	NodeList<FormalDeclNode *> * formals(){ return myFormals; }
 private:
-	std::list<FormalDeclNode *> * myFormals;
+	NodeList<FormalDeclNode *> * myFormals;
 };
 
 class StmtListNode : public ASTNode{
 public:
-	StmtListNode(std::list<StmtNode *> * stmtsIn)
-	: ASTNode(0,0), myStmts(stmtsIn){ }
-	void unparse(std::ostream& out, int indent) override;
+	StmtListNode(NodeList<StmtNode *> * stmtsIn)
+	: ASTNode(NodeKind::StmtList, NO_POS), myStmts(stmtsIn){ }
+	NodeList<StmtNode *> * stmts(){ return myStmts; }
 private:
-	std::list<StmtNode *> * myStmts;
+	NodeList<StmtNode *> * myStmts;
 };
 
 class FnBodyNode : public ASTNode{
 public:
-	FnBodyNode(size_t lineIn, size_t colIn, StmtListNode * stmts)
-	: ASTNode(lineIn, colIn){
-		myStmtList = stmts;
+	FnBodyNode(SourcePos posIn, StmtListNode * stmts)
+	: ASTNode(NodeKind::FnBody, posIn), myStmtList(stmts),
+	  myLazy(nullptr){
+	}
+	/** A body skipped in lazy mode, parsed on first use **/
+	FnBodyNode(LazyBodyToken * lazy)
+	: ASTNode(NodeKind::FnBody, lazy->pos()),
+	  myStmtList(nullptr),
+	  myLazy(lazy){
 	}
-	void unparse(std::ostream& out, int indent) override;
+
+	/** The statements; a lazy body is parsed into its token's arena first **/
+	StmtListNode * stmts();
+	bool isLazy() const { return myLazy != nullptr; }
+	/**
+	* Parse a lazy body now, into arena, with the parser's stack
+	* limited to depthLimit entries (0: no limit). Its diagnostics are
+	* reported as it is parsed. A body that fails to parse is left
+	* empty; the result says whether it parsed.
+	**/
+	bool parseBody(Arena& arena, size_t depthLimit = 0);
 private:
 	StmtListNode * myStmtList;
+	LazyBodyToken * myLazy; /// Until the body is parsed
 };
 
 /*class FnDeclNode
@@ -571,30 +644,38 @@ public:
 		IDNode * id,
 		FormalsListNode * formals,
 		FnBodyNode * fnBody)
-		: DeclNode(id->line(),id->col())
+		: DeclNode(NodeKind::FnDecl, id->pos())
 	{
 		myRe = re;
 		myID = id;
 		myFormals = formals;
 		myBody = fnBody;
-	}
-	void unparse(std::ostream& out, int indent) override;
+		mySignature = nullptr;
+	}
+	TypeNode * retType(){ return myRe; }
+	IDNode * id(){ return myID; }
+	FormalsListNode * formals(){ return myFormals; }
+	FnBodyNode * body(){ return myBody; }
+	/** The function's type, once the type checker has made it **/
+	const DataType * signature() const { return mySignature; }
+	void setSignature(const DataType * type){ mySignature = type; }
 private:
 	TypeNode * myRe;
 	IDNode * myID;
 	FormalsListNode * myFormals;
 	FnBodyNode * myBody;
+	const DataType * mySignature;
 };
 
 /*class FromConsoleStmtNode
 	- LValNode (the variable/field that will receive the input)*/
 class FromConsoleStmtNode : public StmtNode{
 public:
-	FromConsoleStmtNode(size_t lineIn, size_t colIn, LValNode * val)
-	: StmtNode(lineIn, colIn){
+	FromConsoleStmtNode(SourcePos posIn, LValNode * val)
+	: StmtNode(NodeKind::FromConsole, posIn){
 		myVal = val;
 	}
-	void unparse(std::ostream& out, int indent) override;
+	LValNode * val(){ return myVal; }
 private:
 	LValNode * myVal;
 };
@@ -603,11 +684,12 @@ private:
 	- ExpNode (the expression to output)*/
 class ToConsoleStmtNode : public StmtNode{
 public:
-	ToConsoleStmtNode(size_t lineIn, size_t colIn, ExpNode * exp)
-	: StmtNode(lineIn, colIn){
+	ToConsoleStmtNode(SourcePos posIn, ExpNode * exp)
+	: StmtNode(NodeKind::ToConsole, posIn){
 		myExp = exp;
 	}
-	void unparse(std::ostream& out, int indent) override;
+	ExpNode * exp(){ return myExp; }
+	void setExp(ExpNode * exp){ myExp = exp; }
 private:
 	ExpNode * myExp;
 };
@@ -617,15 +699,17 @@ private:
 	- list of StmtNode (body of the if stmt)*/
 class IfStmtNode : public StmtNode{
 public:
-	IfStmtNode(size_t lineIn, size_t colIn, ExpNode * exp, std::list<StmtNode * > * stmts)
-	: StmtNode(lineIn, colIn){
+	IfStmtNode(SourcePos posIn, ExpNode * exp, NodeList<StmtNode * > * stmts)
+	: StmtNode(NodeKind::If, posIn){
 		myExp = exp;
 		myStmts = stmts;
 	}
-	void unparse(std::ostream& out, int indent) override;
+	ExpNode * exp(){ return myExp; }
+	void setExp(ExpNode * exp){ myExp = exp; }
+	NodeList<StmtNode *> * stmts(){ return myStmts; }
 private:
 	ExpNode * myExp;
-	std::list<StmtNode * > * myStmts;
+	NodeList<StmtNode * > * myStmts;
 };
 
 /*class IfElseStmtNode
@@ -634,58 +718,61 @@ private:
 	- list of StmtNode (false branch of the if stmt)*/
 class IfElseStmtNode : public StmtNode{
 public:
-	IfElseStmtNode(ExpNode * exp, std::list<StmtNode * > * stmtsT, std::list<StmtNode * > * stmtsF)
-	: StmtNode(exp->line(), exp->col()){
+	IfElseStmtNode(SourcePos posIn, ExpNode * exp,
+		NodeList<StmtNode * > * stmtsT, NodeList<StmtNode * > * stmtsF)
+	: StmtNode(NodeKind::IfElse, posIn){
 		myExp = exp;
 		myStmtsT = stmtsT;
 		myStmtsF = stmtsF;
 	}
-	void unparse(std::ostream& out, int indent) override;
+	ExpNode * exp(){ return myExp; }
+	void setExp(ExpNode * exp){ myExp = exp; }
+	NodeList<StmtNode *> * stmtsT(){ return myStmtsT; }
+	NodeList<StmtNode *> * stmtsF(){ return myStmtsF; }
 private:
 	ExpNode * myExp;
-	std::list<StmtNode * > * myStmtsT;
-	std::list<StmtNode * > * myStmtsF;
+	NodeList<StmtNode * > * myStmtsT;
+	NodeList<StmtNode * > * myStmtsF;
 };
 
 /*class WhileStmtNode
 	- ExpNode (the condition being evaluated)
 	- list of StmtNode (body of the loop)*/
-class WhileStmtNode : public StmtNode{
-public:
-	WhileStmtNode(size_t lineIn, size_t colIn, ExpNode * exp, std::list<StmtNode * > * stmts)
-	: StmtNode(lineIn, colIn){
-		myExp = exp;
-		myStmts = stmts;
-	}
-	void unparse(std::ostream& out, int indent) override;
-private:
-	ExpNode * myExp;
-	std::list<StmtNode * > * myStmts;
+class WhileStmtNode : public StmtNode{
+public:
+	WhileStmtNode(SourcePos posIn, ExpNode * exp, NodeList<StmtNode * > * stmts)
+	: StmtNode(NodeKind::While, posIn){
+		myExp = exp;
+		myStmts = stmts;
+	}
+	ExpNode * exp(){ return myExp; }
+	void setExp(ExpNode * exp){ myExp = exp; }
+	NodeList<StmtNode *> * stmts(){ return myStmts; }
+private:
+	ExpNode * myExp;
+	NodeList<StmtNode * > * myStmts;
 };
 
 /*class PostDecStmtNode / PostIncStmtNode
 	- LocNode (the variable/field being decremented)*/
 class PostIncStmtNode : public StmtNode{
 public:
-	PostIncStmtNode(ExpNode * exp)
-	: StmtNode(exp->line(), exp->col()){
-		if (exp->line() == 0){
-			throw std::runtime_error("0 pos");
-		}
+	PostIncStmtNode(SourcePos posIn, ExpNode * exp)
+	: StmtNode(NodeKind::PostInc, posIn){
 		myExp = exp;
 	}
-	void unparse(std::ostream& out, int indent) override;
+	ExpNode * exp(){ return myExp; }
 private:
 	ExpNode * myExp;
 };
 
 class PostDecStmtNode : public StmtNode{
 public:
-	PostDecStmtNode(ExpNode * exp)
-	: StmtNode(exp->line(), exp->col()){
+	PostDecStmtNode(SourcePos posIn, ExpNode * exp)
+	: StmtNode(NodeKind::PostDec, posIn){
 		myExp = exp;
 	}
-	void unparse(std::ostream& out, int indent) override;
+	ExpNode * exp(){ return myExp; }
 private:
 	ExpNode * myExp;
 };
@@ -694,11 +781,13 @@ private:
 	- ExpNode (the expression being returned)*/
 class ReturnStmtNode : public StmtNode{
 public:
-	ReturnStmtNode(size_t lineIn, size_t colIn, ExpNode * exp)
-	: StmtNode(lineIn, colIn){
+	ReturnStmtNode(SourcePos posIn, ExpNode * exp)
+	: StmtNode(NodeKind::Return, posIn){
 		myExp = exp;
 	}
-	void unparse(std::ostream& out, int indent) override;
+	/** The returned value; nullptr for a bare return **/
+	ExpNode * exp(){ return myExp; }
+	void setExp(ExpNode * exp){ myExp = exp; }
 private:
 	ExpNode * myExp;
 };
@@ -0,0 +1,95 @@
+#include <sys/stat.h>
+#include <unistd.h>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include "astcache.hpp"
+
+namespace holeyc{
+
+/* Entry header: magic, version, source size, source hash, padded
+   to 32 bytes so the FlatAST image after it stays aligned */
+static const uint32_t ENTRY_MAGIC = 0x43414348; // "HCAC"
+static const uint32_t ENTRY_VERSION = 1;
+struct EntryHeader{
+	uint32_t magic;
+	uint32_t version;
+	uint64_t sourceSize;
+	uint64_t sourceHash;
+	uint64_t reserved;
+};
+
+uint64_t AstCache::hash(const char * data, size_t size){
+	uint64_t h = 14695981039346656037ull;
+	for (size_t i = 0; i < size; i++){
+		h ^= static_cast<unsigned char>(data[i]);
+		h *= 1099511628211ull;
+	}
+	return h;
+}
+
+std::string AstCache::pathFor(uint64_t key) const {
+	static const char hex[] = "0123456789abcdef";
+	std::string name(16, '0');
+	for (int i = 15; i >= 0; i--){
+		name[static_cast<size_t>(i)] = hex[key & 0xF];
+		key >>= 4;
+	}
+	return myDir + "/" + name + ".hcast";
+}
+
+std::unique_ptr<CachedAST> AstCache::load(const SourceFile& src) const {
+	uint64_t key = hash(src.data(), src.size());
+	std::string path = pathFor(key);
+	std::unique_ptr<CachedAST> entry(new CachedAST(path.c_str()));
+	const SourceFile& file = entry->myFile;
+	if (!file.good() || file.size() < sizeof(EntryHeader)){
+		return nullptr;
+	}
+
+	EntryHeader header;
+	memcpy(&header, file.data(), sizeof(header));
+	if (header.magic != ENTRY_MAGIC || header.version != ENTRY_VERSION
+		|| header.sourceSize != src.size() || header.sourceHash != key){
+		return nullptr;
+	}
+	if (!entry->myFlat.attach(file.data() + sizeof(header),
+		file.size() - sizeof(header))){
+		return nullptr;
+	}
+	return entry;
+}
+
+bool AstCache::store(const SourceFile& src, const FlatAST& flat) const {
+	static std::atomic<unsigned> serial(0);
+	if (mkdir(myDir.c_str(), 0777) != 0 && errno != EEXIST){
+		return false;
+	}
+
+	uint64_t key = hash(src.data(), src.size());
+	std::string path = pathFor(key);
+	std::string tmp = path + ".tmp." + std::to_string(getpid())
+		+ "." + std::to_string(serial++);
+	{
+		std::ofstream out(tmp, std::ios::binary);
+		if (!out.good()){ return false; }
+		EntryHeader header = { ENTRY_MAGIC, ENTRY_VERSION, src.size(),
+			key, 0 };
+		out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+		flat.serialize(out);
+		if (!out.good()){
+			out.close();
+			std::remove(tmp.c_str());
+			return false;
+		}
+	}
+	if (std::rename(tmp.c_str(), path.c_str()) != 0){
+		std::remove(tmp.c_str());
+		return false;
+	}
+	return true;
+}
+
+} //End namespace holeyc
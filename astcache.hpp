@@ -0,0 +1,61 @@
+#ifndef HOLEYC_ASTCACHE_HPP
+#define HOLEYC_ASTCACHE_HPP
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include "flat_ast.hpp"
+#include "source.hpp"
+
+namespace holeyc{
+
+/**
+* \class CachedAST
+* A cache entry mapped from disk, with its FlatAST read in place.
+**/
+class CachedAST{
+public:
+	explicit CachedAST(const char * path) : myFile(path){ }
+	const FlatAST& flat() const { return myFlat; }
+private:
+	friend class AstCache;
+	SourceFile myFile;
+	FlatAST myFlat;
+};
+
+/**
+* \class AstCache
+* A directory of serialized ASTs, one file per distinct source text,
+* named by a 64-bit hash of the source. Each entry also records the
+* source's size and hash, so a damaged, stale or colliding entry is
+* treated as a miss. Entries are written to a temporary file and
+* renamed into place, so concurrent compilers never see a partial
+* entry.
+**/
+class AstCache{
+public:
+	explicit AstCache(const char * dir) : myDir(dir){ }
+
+	/** The cached AST of this source text, or nullptr on a miss **/
+	std::unique_ptr<CachedAST> load(const SourceFile& src) const;
+
+	/** Save the AST of this source text; false if it could not be written **/
+	bool store(const SourceFile& src, const FlatAST& flat) const;
+
+	/** Where this source text's entry lives (or would live) **/
+	std::string entryPath(const SourceFile& src) const {
+		return pathFor(hash(src.data(), src.size()));
+	}
+
+	/** FNV-1a over the source bytes **/
+	static uint64_t hash(const char * data, size_t size);
+
+private:
+	std::string pathFor(uint64_t key) const;
+
+	std::string myDir;
+};
+
+} //End namespace holeyc
+
+#endif
@@ -0,0 +1,1003 @@
+/*
+Front end micro-benchmarks. Every case runs over the same generated
+HoleyC program so numbers are comparable between cases and runs:
+
+	./bench <case> [sizeMB]
+
+Run without arguments to list the cases.
+*/
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+#include <thread>
+#include <pthread.h>
+#include <unistd.h>
+#include "../astcache.hpp"
+#include "../chunks.hpp"
+#include "../diagnostics.hpp"
+#include "../driver.hpp"
+#include "../flat_ast.hpp"
+#include "../fold.hpp"
+#include "../lower.hpp"
+#include "../names.hpp"
+#include "../scanner.hpp"
+#include "../session.hpp"
+#include "../source.hpp"
+#include "../typecheck.hpp"
+#include "../visitor.hpp"
+
+using namespace holeyc;
+using Lexeme = holeyc::Parser::semantic_type;
+
+namespace{
+
+/* Deterministic xorshift so every run sees the same program */
+class Rng{
+public:
+	explicit Rng(unsigned long long seed) : myState(seed){ }
+	unsigned next(unsigned bound){
+		myState ^= myState << 13;
+		myState ^= myState >> 7;
+		myState ^= myState << 17;
+		return static_cast<unsigned>(myState % bound);
+	}
+private:
+	unsigned long long myState;
+};
+
+class ProgramGen{
+public:
+	explicit ProgramGen(unsigned long long seed) : myRng(seed){ }
+
+	std::string generate(size_t bytes){
+		std::string out;
+		int fn = 0;
+		while (out.size() < bytes){
+			if (myRng.next(3) == 0){
+				out += type() + " g" + std::to_string(fn) + ";\n";
+			}
+			out += type() + " f" + std::to_string(fn++) + "(";
+			unsigned formals = myRng.next(4);
+			for (unsigned i = 0; i < formals; i++){
+				if (i != 0){ out += ", "; }
+				out += type() + " " + name();
+			}
+			out += "){\n";
+			stmts(out, 1, 3);
+			out += "}\n";
+		}
+		return out;
+	}
+
+private:
+	std::string type(){
+		static const char * types[] = {
+			"int", "bool", "char", "intptr", "boolptr", "charptr"
+		};
+		return types[myRng.next(6)];
+	}
+	std::string name(){
+		static const char * names[] = {
+			"a", "b", "count", "x", "total", "ptr", "val", "i"
+		};
+		std::string n = names[myRng.next(8)];
+		if (myRng.next(3) == 0){ n += std::to_string(myRng.next(64)); }
+		return n;
+	}
+	std::string lval(){
+		switch (myRng.next(6)){
+		case 0: return name() + "[" + exp(1) + "]";
+		case 1: return "@" + name();
+		default: return name();
+		}
+	}
+	std::string term(int depth){
+		switch (myRng.next(depth > 0 ? 9 : 5)){
+		case 0: return std::to_string(myRng.next(100000));
+		case 1: return "\"str\\n\"";
+		case 2: return "'c";
+		case 3: return myRng.next(2) ? "true" : "false";
+		case 4: return lval();
+		case 5: return "(" + exp(depth - 1) + ")";
+		case 6: return name() + "(" + exp(depth - 1) + ")";
+		default: return lval();
+		}
+	}
+	std::string exp(int depth){
+		static const char * ops[] = { " + ", " - ", " * ", " / ",
+			" && ", " || " };
+		static const char * cmps[] = { " == ", " != ", " < ", " >= " };
+		if (depth <= 0){ return term(0); }
+		switch (myRng.next(5)){
+		case 0: return term(depth);
+		case 1: return "(" + exp(depth - 1) + cmps[myRng.next(4)]
+			+ exp(depth - 1) + ")";
+		case 2: return "!" + term(depth - 1);
+		default: return exp(depth - 1) + ops[myRng.next(6)]
+			+ exp(depth - 1);
+		}
+	}
+	void stmts(std::string& out, int indent, int depth){
+		unsigned count = 1 + myRng.next(6);
+		for (unsigned i = 0; i < count; i++){
+			stmt(out, indent, depth);
+		}
+	}
+	void stmt(std::string& out, int indent, int depth){
+		std::string pad(static_cast<size_t>(indent), '\t');
+		switch (myRng.next(depth > 0 ? 10 : 7)){
+		case 0: out += pad + type() + " " + name() + ";\n"; break;
+		case 1: out += pad + lval() + "++;\n"; break;
+		case 2: out += pad + "TOCONSOLE " + exp(2) + ";\n"; break;
+		case 3: out += pad + "return " + exp(2) + ";\n"; break;
+		case 4: out += pad + name() + "(" + exp(1) + ");\n"; break;
+		case 5: out += pad + "# a comment line\n"; break;
+		case 6: out += pad + lval() + " = " + exp(3) + ";\n"; break;
+		case 7:
+			out += pad + "while (" + exp(2) + "){\n";
+			stmts(out, indent + 1, depth - 1);
+			out += pad + "}\n";
+			break;
+		default:
+			out += pad + "if (" + exp(2) + "){\n";
+			stmts(out, indent + 1, depth - 1);
+			out += pad + "} else {\n";
+			stmts(out, indent + 1, depth - 1);
+			out += pad + "}\n";
+			break;
+		}
+	}
+
+	Rng myRng;
+};
+
+/* Run fn a few times and report the best time as MB/s of input */
+void measure(const std::string& label, size_t bytes,
+	const std::function<size_t()>& fn){
+	double best = 1e30;
+	size_t result = 0;
+	for (int rep = 0; rep < 5; rep++){
+		auto start = std::chrono::steady_clock::now();
+		result = fn();
+		std::chrono::duration<double> secs =
+			std::chrono::steady_clock::now() - start;
+		if (secs.count() < best){ best = secs.count(); }
+	}
+	double mb = static_cast<double>(bytes) / (1024.0 * 1024.0);
+	std::printf("%-28s %9.2f ms %9.1f MB/s  (%zu)\n", label.c_str(),
+		best * 1000.0, mb / best, result);
+}
+
+size_t lexAll(Scanner& scanner){
+	Lexeme lexeme;
+	size_t tokens = 0;
+	while (scanner.yylex(&lexeme) != TokenKind::END){ tokens++; }
+	return tokens;
+}
+
+void benchLex(const std::string& path, size_t bytes){
+	measure("lex read()", bytes, [&](){
+		Arena arena;
+		SourceFile src(path.c_str(), false);
+		Scanner scanner(src, arena);
+		return lexAll(scanner);
+	});
+	measure("lex mmap", bytes, [&](){
+		Arena arena;
+		SourceFile src(path.c_str(), true);
+		Scanner scanner(src, arena);
+		return lexAll(scanner);
+	});
+}
+
+/* Discards everything written to it, so unparse cost is just traversal */
+class NullBuf : public std::streambuf{
+protected:
+	int overflow(int c) override { return c; }
+	std::streamsize xsputn(const char *, std::streamsize n) override {
+		return n;
+	}
+};
+
+void benchFlat(const std::string& path, size_t bytes){
+	CompilationSession session(path.c_str());
+	ProgramNode * tree = session.ast();
+	if (tree == nullptr){
+		std::cerr << "generated program did not parse\n";
+		return;
+	}
+	FlatAST flat;
+	tree->flatten(flat, session.lines());
+	double nodes = static_cast<double>(flat.size());
+	std::printf("%zu nodes: arena %.1f B/node (tokens + tree), "
+		"flat %.1f B/node\n", flat.size(),
+		static_cast<double>(session.arena().bytesReserved()) / nodes,
+		static_cast<double>(flat.bytes()) / nodes);
+
+	NullBuf sink;
+	std::ostream out(&sink);
+	measure("flatten", bytes, [&](){
+		FlatAST copy;
+		tree->flatten(copy, session.lines());
+		return copy.size();
+	});
+	measure("unparse pointer tree", bytes, [&](){
+		Writer writer(out);
+		tree->unparse(writer, 0);
+		return flat.size();
+	});
+	measure("unparse flat", bytes, [&](){
+		Writer writer(out);
+		flat.unparse(writer);
+		return flat.size();
+	});
+	measure("scan flat kinds", bytes, [&](){
+		size_t literals = 0;
+		for (FlatAST::NodeID n = 0; n < flat.size(); n++){
+			literals += flat.kind(n) == FlatKind::IntLit;
+		}
+		return literals;
+	});
+}
+
+/* Every node of a tree, in pre-order */
+class Collect : public ASTVisitor<Collect>{
+public:
+	std::vector<ASTNode *> run(ASTNode * root){
+		std::vector<ASTNode *> nodes;
+		myStack.push_back(root);
+		while (!myStack.empty()){
+			ASTNode * node = myStack.back();
+			myStack.pop_back();
+			nodes.push_back(node);
+			visit(node);
+		}
+		return nodes;
+	}
+
+	void visitProgram(ProgramNode * node){ list(node->globals()); }
+	void visitVarDecl(VarDeclNode * node){ kids({node->type(), node->id()}); }
+	void visitFnDecl(FnDeclNode * node){
+		kids({node->retType(), node->id(), node->formals(), node->body()});
+	}
+	void visitFormalsList(FormalsListNode * node){ list(node->formals()); }
+	void visitFnBody(FnBodyNode * node){ kids({node->stmts()}); }
+	void visitStmtList(StmtListNode * node){ list(node->stmts()); }
+	void visitAssignStmt(AssignStmtNode * node){ kids({node->assign()}); }
+	void visitCallStmt(CallStmtNode * node){ kids({node->callExp()}); }
+	void visitFromConsole(FromConsoleStmtNode * node){ kids({node->val()}); }
+	void visitToConsole(ToConsoleStmtNode * node){ kids({node->exp()}); }
+	void visitPostInc(PostIncStmtNode * node){ kids({node->exp()}); }
+	void visitPostDec(PostDecStmtNode * node){ kids({node->exp()}); }
+	void visitIf(IfStmtNode * node){
+		list(node->stmts());
+		kids({node->exp()});
+	}
+	void visitIfElse(IfElseStmtNode * node){
+		list(node->stmtsF());
+		list(node->stmtsT());
+		kids({node->exp()});
+	}
+	void visitWhile(WhileStmtNode * node){
+		list(node->stmts());
+		kids({node->exp()});
+	}
+	void visitReturn(ReturnStmtNode * node){
+		if (node->exp() != nullptr){ kids({node->exp()}); }
+	}
+	void visitAssignExp(AssignExpNode * node){
+		kids({node->tgt(), node->src()});
+	}
+	void visitBinaryExp(BinaryExpNode * node){
+		kids({node->lhs(), node->rhs()});
+	}
+	void visitCallExp(CallExpNode * node){
+		if (node->args() != nullptr){ list(node->args()); }
+		kids({node->id()});
+	}
+	void visitUnaryExp(UnaryExpNode * node){ kids({node->exp()}); }
+	void visitDeref(DerefNode * node){ kids({node->tgt()}); }
+	void visitRef(RefNode * node){ kids({node->tgt()}); }
+	void visitIndex(IndexNode * node){ kids({node->tgt(), node->off()}); }
+
+private:
+	/* Pushed reversed, so the first child is visited first */
+	void kids(std::initializer_list<ASTNode *> nodes){
+		for (auto it = nodes.end(); it != nodes.begin(); ){
+			myStack.push_back(*--it);
+		}
+	}
+	template <typename T>
+	void list(NodeList<T> * nodes){
+		myStack.insert(myStack.end(), nodes->rbegin(), nodes->rend());
+	}
+
+	std::vector<ASTNode *> myStack;
+};
+
+/* A little work per node, depending on both its class and its data */
+class Weigh : public ASTVisitor<Weigh, size_t>{
+public:
+	size_t visitDecl(DeclNode * node){ return 4 + node->pos(); }
+	size_t visitStmt(StmtNode * node){ return 3 + node->pos(); }
+	size_t visitType(TypeNode * node){ return 2 + node->pos(); }
+	size_t visitExp(ExpNode * node){ return 1 + node->pos(); }
+	size_t visitNode(ASTNode * node){ return node->pos(); }
+};
+
+/* Weigh's weights, by where each kind sits in NodeKind */
+constexpr size_t weightOf(NodeKind kind){
+	return kind >= NodeKind::AssignExp ? 1
+		: kind >= NodeKind::AssignStmt ? 3
+		: kind >= NodeKind::IntType ? 2
+		: kind >= NodeKind::FormalsList ? 0
+		: kind >= NodeKind::VarDecl ? 4 : 0;
+}
+
+/* The same work behind a virtual call with one override per node
+   class, as if the pass were a virtual method on the nodes */
+class VirtualWeigh{
+public:
+	virtual ~VirtualWeigh(){ }
+	virtual size_t weigh(ASTNode * node) const = 0;
+};
+
+template <size_t Kind>
+class KindWeigh : public VirtualWeigh{
+public:
+	size_t weigh(ASTNode * node) const override {
+		return weightOf(static_cast<NodeKind>(Kind)) + node->pos();
+	}
+	static const KindWeigh instance;
+};
+template <size_t Kind>
+const KindWeigh<Kind> KindWeigh<Kind>::instance{};
+
+template <size_t... Kinds>
+const VirtualWeigh * virtualWeigh(NodeKind kind,
+	std::index_sequence<Kinds...>){
+	static const VirtualWeigh * const table[] = {
+		&KindWeigh<Kinds>::instance...
+	};
+	return table[static_cast<size_t>(kind)];
+}
+
+/* Per-node dispatch: ASTVisitor's switch against a virtual call */
+void benchDispatch(const std::string& path, size_t bytes){
+	CompilationSession session(path.c_str());
+	ProgramNode * tree = session.ast();
+	if (tree == nullptr){
+		std::cerr << "generated program did not parse\n";
+		return;
+	}
+	std::vector<ASTNode *> nodes = Collect().run(tree);
+	const size_t kinds = static_cast<size_t>(NodeKind::Index) + 1;
+	std::vector<std::pair<ASTNode *, const VirtualWeigh *>> objects;
+	for (ASTNode * node : nodes){
+		objects.emplace_back(node, virtualWeigh(node->kind(),
+			std::make_index_sequence<kinds>()));
+	}
+	std::printf("%zu nodes\n", nodes.size());
+	const int passes = 10;
+	measure("visitor switch x10", bytes * passes, [&](){
+		size_t sum = 0;
+		for (int pass = 0; pass < passes; pass++){
+			Weigh weigh;
+			for (ASTNode * node : nodes){ sum += weigh.visit(node); }
+		}
+		return sum;
+	});
+	measure("virtual call x10", bytes * passes, [&](){
+		size_t sum = 0;
+		for (int pass = 0; pass < passes; pass++){
+			for (auto& object : objects){
+				sum += object.second->weigh(object.first);
+			}
+		}
+		return sum;
+	});
+	measure("collect (visitor walk)", bytes, [&](){
+		return Collect().run(tree).size();
+	});
+}
+
+/* Parse from source (lex + parse) and from a binary token file */
+void benchReplay(const std::string& path, size_t bytes){
+	std::string tokPath = path + ".tok";
+	{
+		CompilationSession session(path.c_str());
+		session.recordTokens();
+		std::ofstream out(tokPath, std::ios::binary);
+		session.writeBinaryTokens(out);
+	}
+	std::printf("token file: %zu bytes\n", SourceFile(tokPath.c_str()).size());
+	auto parse = [](const std::string& file){
+		return [file](){
+			CompilationSession session(file.c_str());
+			return static_cast<size_t>(session.ast() != nullptr);
+		};
+	};
+	measure("parse source", bytes, parse(path));
+	measure("parse token file", bytes, parse(tokPath));
+	std::remove(tokPath.c_str());
+}
+
+/* -p without a cache, filling an empty cache, and from a warm one */
+void benchCache(const std::string& path, size_t bytes){
+	std::string dir = "bench_cache";
+	SourceFile src(path.c_str());
+	std::string entry = AstCache(dir.c_str()).entryPath(src);
+	auto clear = [&](){ std::remove(entry.c_str()); };
+	CompileOptions opts;
+	opts.checkParse = true;
+	measure("no cache", bytes, [&](){
+		return static_cast<size_t>(compileFile(path.c_str(), opts));
+	});
+	opts.cacheDir = dir.c_str();
+	measure("cold (parse + store)", bytes, [&](){
+		clear();
+		return static_cast<size_t>(compileFile(path.c_str(), opts));
+	});
+	measure("warm (mapped entry)", bytes, [&](){
+		return static_cast<size_t>(compileFile(path.c_str(), opts));
+	});
+	clear();
+	rmdir(dir.c_str());
+}
+
+/* Parse with the lexer inline and on its own thread (-l) */
+void benchPipeline(const std::string& path, size_t bytes){
+	auto parse = [&](bool lexOnThread){
+		return [&path, lexOnThread](){
+			CompilationSession session(path.c_str(), lexOnThread);
+			return static_cast<size_t>(session.ast() != nullptr);
+		};
+	};
+	measure("parse, inline lexer", bytes, parse(false));
+	measure("parse, lexer thread -l", bytes, parse(true));
+}
+
+/* The chunk prescan alone, then serial against chunked parses (-P) */
+void benchChunks(const std::string& path, size_t bytes){
+	SourceFile src(path.c_str());
+	measure("prescan (64 KB chunks)", bytes, [&](){
+		return findChunks(src.data(), src.size(), 64 * 1024).size();
+	});
+	unsigned cores = std::thread::hardware_concurrency();
+	for (unsigned threads = 1; threads <= 8; threads *= 2){
+		if (threads > 1 && threads > cores){ break; }
+		measure("parse -P " + std::to_string(threads), bytes, [&](){
+			CompilationSession session(path.c_str());
+			session.parseInParallel(threads);
+			return static_cast<size_t>(session.ast() != nullptr);
+		});
+	}
+}
+
+/* Interface extraction (-i) from a full parse and with lazy bodies,
+   then lazy parses whose bodies are all parsed afterwards */
+void benchLazy(const std::string& path, size_t bytes){
+	auto interface = [&](bool lazy){
+		return [&path, lazy](){
+			CompilationSession session(path.c_str());
+			if (lazy){ session.lazyBodies(); }
+			ProgramNode * tree = session.ast();
+			if (tree == nullptr){ return size_t(0); }
+			std::ostringstream out;
+			Writer writer(out);
+			tree->unparseInterface(writer);
+			return out.str().size();
+		};
+	};
+	measure("interface, eager bodies", bytes, interface(false));
+	measure("interface, lazy bodies", bytes, interface(true));
+	unsigned cores = std::thread::hardware_concurrency();
+	for (unsigned threads = 1; threads <= 8; threads *= 2){
+		if (threads > 1 && threads > cores){ break; }
+		measure("lazy, then bodies on " + std::to_string(threads), bytes,
+			[&](){
+			CompilationSession session(path.c_str());
+			session.lazyBodies();
+			session.parseBodies(threads);
+			return static_cast<size_t>(session.ast() != nullptr);
+		});
+	}
+}
+
+/* Parse with and without sharing expressions (-h) */
+void benchShare(const std::string& path, size_t bytes){
+	for (bool share : {false, true}){
+		CompilationSession session(path.c_str());
+		if (share){ session.hashCons(); }
+		if (session.ast() == nullptr){
+			std::cerr << "generated program did not parse\n";
+			return;
+		}
+		std::printf("%s: arena %zu bytes", share ? "-h" : "plain",
+			session.arena().bytesReserved());
+		if (share){
+			std::printf(", %zu shared nodes for %zu uses",
+				session.sharedNodes(),
+				session.sharedNodes() + session.sharedReuses());
+		}
+		std::printf("\n");
+	}
+	for (bool share : {false, true}){
+		measure(share ? "parse -h" : "parse", bytes, [&](){
+			CompilationSession session(path.c_str());
+			if (share){ session.hashCons(); }
+			return static_cast<size_t>(session.ast() != nullptr);
+		});
+	}
+}
+
+/* -u of the whole program against streaming it one declaration at
+   a time (-s) */
+void benchStream(const std::string& path, size_t bytes){
+	CompileOptions whole;
+	whole.unparseFile = "/dev/null";
+	CompileOptions streamed = whole;
+	streamed.stream = true;
+	measure("unparse -u", bytes, [&](){
+		return static_cast<size_t>(compileFile(path.c_str(), whole));
+	});
+	measure("unparse -s -u", bytes, [&](){
+		return static_cast<size_t>(compileFile(path.c_str(), streamed));
+	});
+}
+
+/* -p (full parse, tree discarded) against -v (no tokens or nodes) */
+void benchValidate(const std::string& path, size_t bytes){
+	CompileOptions parse;
+	parse.checkParse = true;
+	CompileOptions validate;
+	validate.validate = true;
+	measure("parse -p", bytes, [&](){
+		return static_cast<size_t>(compileFile(path.c_str(), parse));
+	});
+	measure("validate -v", bytes, [&](){
+		return static_cast<size_t>(compileFile(path.c_str(), validate));
+	});
+}
+
+/* -u and -t output rates, in MB/s of text written to /dev/null */
+void benchEmit(const std::string& path, size_t bytes){
+	CompilationSession session(path.c_str());
+	session.recordTokens();
+	ProgramNode * tree = session.ast();
+	if (tree == nullptr){
+		std::cerr << "generated program did not parse\n";
+		return;
+	}
+	std::ostringstream sized;
+	{
+		Writer writer(sized);
+		tree->unparse(writer, 0);
+	}
+	size_t unparseBytes = sized.str().size();
+	sized.str("");
+	session.writeTokens(sized);
+	size_t tokenBytes = sized.str().size();
+
+	std::ofstream devNull("/dev/null");
+	measure("unparse -u", unparseBytes, [&](){
+		Writer writer(devNull);
+		tree->unparse(writer, 0);
+		return unparseBytes;
+	});
+	measure("token dump -t", tokenBytes, [&](){
+		session.writeTokens(devNull);
+		return tokenBytes;
+	});
+}
+
+/* Lex a copy of the program with an illegal character on every line */
+void benchDiag(const std::string& path, size_t bytes){
+	std::string program;
+	{
+		SourceFile src(path.c_str());
+		for (size_t i = 0; i < src.size(); i++){
+			if (src.data()[i] == '\n'){ program += " $"; }
+			program += src.data()[i];
+		}
+	}
+	std::string errPath = path + ".err";
+	std::ofstream(errPath) << program;
+
+	/* Unit-buffered like std::cerr, so writes are not coalesced */
+	std::ofstream devNull("/dev/null");
+	devNull << std::unitbuf;
+	measure("report immediately", program.size(), [&](){
+		ReportCapture capture(std::cout, devNull);
+		Arena arena;
+		SourceFile src(errPath.c_str());
+		Scanner scanner(src, arena);
+		return lexAll(scanner);
+	});
+	measure("collect, sort, flush", program.size(), [&](){
+		ReportCapture capture(std::cout, devNull);
+		Diagnostics diags;
+		size_t tokens;
+		{
+			DiagnosticScope scope(diags);
+			Arena arena;
+			SourceFile src(errPath.c_str());
+			Scanner scanner(src, arena);
+			tokens = lexAll(scanner);
+		}
+		diags.flush(devNull, DiagFormat::Text);
+		return tokens;
+	});
+	std::remove(errPath.c_str());
+}
+
+/* Parse-check copies of the program on growing worker pools */
+void benchBatch(const std::string& path, size_t bytes){
+	const size_t copies = 8;
+	CompileOptions opts;
+	opts.checkParse = true;
+	unsigned cores = std::thread::hardware_concurrency();
+	for (unsigned workers = 1; workers <= copies; workers *= 2){
+		if (workers > 1 && workers > cores){ break; }
+		measure("batch -j " + std::to_string(workers), bytes * copies,
+			[&](){
+			BatchDriver driver(opts, workers);
+			for (size_t i = 0; i < copies; i++){ driver.addInput(path); }
+			return static_cast<size_t>(driver.run());
+		});
+	}
+}
+
+/* Run fn on a thread with only a small native stack, so a traversal
+   that recursed once per nesting level would overflow it */
+void onSmallStack(const std::function<void()>& fn){
+	pthread_attr_t attr;
+	pthread_attr_init(&attr);
+	pthread_attr_setstacksize(&attr, 256 * 1024);
+	pthread_t thread;
+	auto trampoline = [](void * arg) -> void * {
+		(*static_cast<const std::function<void()> *>(arg))();
+		return nullptr;
+	};
+	const void * arg = &fn;
+	if (pthread_create(&thread, &attr, trampoline,
+		const_cast<void *>(arg)) != 0){
+		std::cerr << "could not start a thread\n";
+	} else {
+		pthread_join(thread, nullptr);
+	}
+	pthread_attr_destroy(&attr);
+}
+
+/* Pathological nesting at growing depths: time per byte should stay
+   flat as depth doubles, and all of it runs on a 256 KB stack */
+void benchStress(const std::string&, size_t bytes){
+	struct Shape{
+		const char * name;
+		std::string (*make)(size_t depth);
+	};
+	const Shape shapes[] = {
+		{ "parens", [](size_t n){
+			return "int f(){ return " + std::string(n, '(') + "1"
+				+ std::string(n, ')') + "; }\n"; } },
+		{ "plus chain", [](size_t n){
+			std::string s = "int f(){ return 1";
+			for (size_t i = 0; i < n; i++){ s += " + 1"; }
+			return s + "; }\n"; } },
+		{ "not chain", [](size_t n){
+			return "bool f(){ return " + std::string(n, '!')
+				+ "true; }\n"; } },
+		{ "assign chain", [](size_t n){
+			std::string s = "void f(){ ";
+			for (size_t i = 0; i < n; i++){ s += "a = "; }
+			return s + "a; }\n"; } },
+		{ "nested ifs", [](size_t n){
+			std::string s = "void f(){\n";
+			for (size_t i = 0; i < n / 10; i++){ s += "if (a) {\n"; }
+			for (size_t i = 0; i < n / 10; i++){ s += "}\n"; }
+			return s + "}\n"; } },
+		{ "wide formals", [](size_t n){
+			std::string s = "void f(int a0";
+			for (size_t i = 1; i < n; i++){
+				s += ", int a" + std::to_string(i);
+			}
+			return s + "){ }\n"; } },
+	};
+	/* Scaled so the default 16 MB run goes 25k, 50k, 100k deep */
+	size_t base = bytes / 640;
+	NullBuf sink;
+	std::ostream out(&sink);
+	for (const Shape& shape : shapes){
+		for (size_t depth = base; depth <= 4 * base; depth *= 2){
+			std::string stressPath = "bench_stress.holeyc";
+			std::string program = shape.make(depth);
+			std::ofstream(stressPath) << program;
+			measure(std::string(shape.name) + " " + std::to_string(depth),
+				program.size(), [&](){
+				size_t nodes = 0;
+				onSmallStack([&](){
+					CompilationSession session(stressPath.c_str());
+					ProgramNode * tree = session.ast();
+					if (tree == nullptr){ return; }
+					Writer writer(out);
+					tree->unparse(writer, 0);
+					FlatAST flat;
+					tree->flatten(flat, session.lines());
+					nodes = flat.size();
+				});
+				return nodes;
+			});
+			std::remove(stressPath.c_str());
+		}
+	}
+}
+
+/* One semantic pass alone, over a tree parsed (and, for types, name
+   analyzed) beforehand; diagnostics are collected and dropped */
+void timeSemantics(const std::string& label, const std::string& path,
+	size_t bytes, bool types){
+	CompilationSession session(path.c_str());
+	ProgramNode * tree = session.ast();
+	if (tree == nullptr){
+		std::cerr << label << ": program did not parse\n";
+		return;
+	}
+	if (types){
+		Diagnostics diags;
+		DiagnosticScope scope(diags);
+		NameAnalysis(session.lines()).run(tree);
+	}
+	measure(label, bytes, [&](){
+		Diagnostics diags;
+		DiagnosticScope scope(diags);
+		if (types){ TypeCheck(session.lines()).run(tree); }
+		else { NameAnalysis(session.lines()).run(tree); }
+		return diags.errorCount();
+	});
+}
+
+/* The generated program, then well-typed programs with more and more
+   functions, more deeply nested blocks and longer expressions: time
+   per byte should stay flat */
+void scaleSemantics(const std::string& path, size_t bytes, bool types){
+	timeSemantics("generated", path, bytes, types);
+	struct Shape{
+		const char * name;
+		std::string (*make)(size_t n);
+	};
+	const Shape shapes[] = {
+		{ "functions", [](size_t n){
+			std::string s = "int g;\nint f0(int a){ return a; }\n";
+			for (size_t i = 1; i < n; i++){
+				s += "int f" + std::to_string(i) + "(int a){ int b; b = a + g;"
+					+ " return f" + std::to_string(i - 1) + "(b); }\n";
+			}
+			return s; } },
+		{ "nested blocks", [](size_t n){
+			std::string s = "void f(int x){\n";
+			for (size_t i = 0; i < n / 10; i++){
+				s += "if (x == 0) { int x; x = x + 1;\n";
+			}
+			for (size_t i = 0; i < n / 10; i++){ s += "}\n"; }
+			return s + "}\n"; } },
+		{ "long expression", [](size_t n){
+			std::string s = "bool f(int a, intptr p){ return (a";
+			for (size_t i = 0; i < n / 10; i++){
+				s += " + p[" + std::to_string(i % 10) + "] * @p";
+			}
+			return s + " < a) == !false; }\n"; } },
+	};
+	/* Scaled so the default 16 MB run goes 25k, 50k, 100k */
+	size_t base = bytes / 640;
+	for (const Shape& shape : shapes){
+		for (size_t n = base; n <= 4 * base; n *= 2){
+			std::string shapePath = "bench_semantics.holeyc";
+			std::string program = shape.make(n);
+			std::ofstream(shapePath) << program;
+			timeSemantics(std::string(shape.name) + " " + std::to_string(n),
+				shapePath, program.size(), types);
+			std::remove(shapePath.c_str());
+		}
+	}
+}
+
+void benchNames(const std::string& path, size_t bytes){
+	scaleSemantics(path, bytes, false);
+}
+
+void benchTypes(const std::string& path, size_t bytes){
+	scaleSemantics(path, bytes, true);
+}
+
+/* Name analysis and type checking of thousands of functions on 1, 2,
+   4 and 8 threads (-P), after a parse timed alone */
+void benchSemantics(const std::string&, size_t bytes){
+	std::string program = "int g;\nint f0(int a, intptr p){ return a; }\n";
+	for (size_t i = 1; i < bytes / 640; i++){
+		program += "int f" + std::to_string(i) + "(int a, intptr p){"
+			+ " int b; b = a + g; while (b > @p) { b = b - p[a]; }"
+			+ " return f" + std::to_string(i - 1) + "(b, p); }\n";
+	}
+	std::string path = "bench_semantics.holeyc";
+	std::ofstream(path) << program;
+	measure("parse", program.size(), [&](){
+		CompilationSession session(path.c_str());
+		return static_cast<size_t>(session.ast() != nullptr);
+	});
+	unsigned cores = std::thread::hardware_concurrency();
+	for (unsigned threads = 1; threads <= 8; threads *= 2){
+		if (threads > 1 && threads > cores){ break; }
+		measure("parse, names and types on " + std::to_string(threads),
+			program.size(), [&](){
+			CompilationSession session(path.c_str());
+			session.parseInParallel(threads);
+			return static_cast<size_t>(session.checkTypes());
+		});
+	}
+	std::remove(path.c_str());
+}
+
+/* Folding (-f) a type-checked program full of constant arithmetic and
+   branches, against checking it alone; the unparsed size before and
+   after shows how much less later passes get */
+void benchFold(const std::string&, size_t bytes){
+	std::string program = "int g;\n";
+	for (size_t i = 0; i < bytes / 512; i++){
+		std::string n = std::to_string(i % 100);
+		program += "int f" + std::to_string(i) + "(int a, bool b){"
+			+ " int x; x = (a * 1 + 0) + " + n + " * (2 + 3) - 4 / 2;"
+			+ " if (" + n + " < 50 && true) { x = x + " + n + " * 0; }"
+			+ " else { g = -(-a); }"
+			+ " while (!!b && 1 == 2) { x = x + 1; }"
+			+ " return x; }\n";
+	}
+	std::string path = "bench_fold.holeyc";
+	std::ofstream(path) << program;
+	auto unparsed = [&](bool fold){
+		CompilationSession session(path.c_str());
+		if (!session.checkTypes()){ return size_t(0); }
+		if (fold){ session.foldConstants(); }
+		std::ostringstream out;
+		Writer writer(out);
+		session.ast()->unparse(writer, 0);
+		return out.str().size();
+	};
+	measure("parse, check", program.size(), [&](){
+		CompilationSession session(path.c_str());
+		return static_cast<size_t>(session.checkTypes());
+	});
+	measure("parse, check, fold", program.size(), [&](){
+		CompilationSession session(path.c_str());
+		if (!session.checkTypes()){ return size_t(0); }
+		return ConstantFold(session.arena()).run(session.ast());
+	});
+	measure("unparse, unfolded", program.size(), [&](){
+		return unparsed(false);
+	});
+	measure("unparse, folded", program.size(), [&](){
+		return unparsed(true);
+	});
+	std::remove(path.c_str());
+}
+
+/* Lowering (-r) type-checked functions with more and more statements,
+   deeper nesting and longer && chains; time per byte, and quads per
+   byte, should stay flat */
+void benchLower(const std::string&, size_t bytes){
+	struct Shape{
+		const char * name;
+		std::string (*make)(size_t n);
+	};
+	const Shape shapes[] = {
+		{ "statements", [](size_t n){
+			std::string s = "int g;\nvoid f(int a, intptr p){ int x;\n";
+			for (size_t i = 0; i < n / 10; i++){
+				s += "x = a * " + std::to_string(i % 10) + " + p[x]; g++;\n";
+			}
+			return s + "}\n"; } },
+		{ "nested loops", [](size_t n){
+			std::string s = "void f(int x){\n";
+			for (size_t i = 0; i < n / 10; i++){
+				s += i % 2 == 0 ? "while (x > 0) { x--;\n"
+					: "if (x == 1) { x = 2; } else {\n";
+			}
+			for (size_t i = 0; i < n / 10; i++){ s += "}\n"; }
+			return s + "}\n"; } },
+		{ "short circuits", [](size_t n){
+			std::string s = "bool f(int a, bool b){ return b";
+			for (size_t i = 0; i < n / 10; i++){
+				s += i % 2 == 0 ? " && (a < " + std::to_string(i) + ")"
+					: " || b";
+			}
+			return s + "; }\n"; } },
+	};
+	size_t base = bytes / 640;
+	for (const Shape& shape : shapes){
+		for (size_t n = base; n <= 4 * base; n *= 2){
+			std::string path = "bench_lower.holeyc";
+			std::string program = shape.make(n);
+			std::ofstream(path) << program;
+			CompilationSession session(path.c_str());
+			if (!session.checkTypes()){
+				std::cerr << shape.name << ": program did not check\n";
+				std::remove(path.c_str());
+				continue;
+			}
+			measure(std::string(shape.name) + " " + std::to_string(n),
+				program.size(), [&](){
+				IRProgram ir;
+				Lowering(ir).run(session.ast());
+				return ir.functions().back().quads().size();
+			});
+			std::remove(path.c_str());
+		}
+	}
+}
+
+struct Case{
+	const char * name;
+	void (*run)(const std::string& path, size_t bytes);
+};
+
+const Case cases[] = {
+	{ "lex", benchLex },
+	{ "flat", benchFlat },
+	{ "dispatch", benchDispatch },
+	{ "batch", benchBatch },
+	{ "diag", benchDiag },
+	{ "emit", benchEmit },
+	{ "replay", benchReplay },
+	{ "cache", benchCache },
+	{ "validate", benchValidate },
+	{ "pipeline", benchPipeline },
+	{ "chunks", benchChunks },
+	{ "lazy", benchLazy },
+	{ "stream", benchStream },
+	{ "share", benchShare },
+	{ "names", benchNames },
+	{ "types", benchTypes },
+	{ "semantics", benchSemantics },
+	{ "fold", benchFold },
+	{ "lower", benchLower },
+	{ "stress", benchStress },
+};
+
+} //End anonymous namespace
+
+int main(int argc, char ** argv){
+	if (argc < 2){
+		std::cerr << "Usage: bench <case|all> [sizeMB]\ncases:";
+		for (const Case& c : cases){ std::cerr << " " << c.name; }
+		std::cerr << "\n";
+		return 1;
+	}
+	size_t mb = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 16;
+
+	std::string program = ProgramGen(0x5eed).generate(mb * 1024 * 1024);
+	std::string path = "bench_input.holeyc";
+	std::ofstream(path) << program;
+
+	bool ran = false;
+	for (const Case& c : cases){
+		if (std::strcmp(argv[1], "all") == 0
+			|| std::strcmp(argv[1], c.name) == 0){
+			std::printf("== %s (%zu bytes)\n", c.name, program.size());
+			c.run(path, program.size());
+			ran = true;
+		}
+	}
+	std::remove(path.c_str());
+	if (!ran){
+		std::cerr << "Unknown case " << argv[1] << "\n";
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,92 @@
+#include "chunks.hpp"
+
+namespace holeyc{
+
+/*
+If src[i] starts a comment or a string or char literal, return the
+offset just past it (never past a newline); otherwise return i.
+*/
+static size_t skipLiteral(const char * src, size_t size, size_t i){
+	char c = src[i];
+	if (c == '#'){
+		while (i < size && src[i] != '\n'){ i++; }
+	} else if (c == '"'){
+		/* Ends at the closing quote or, unterminated, the newline */
+		i++;
+		while (i < size && src[i] != '\n'){
+			if (src[i] == '"'){ return i + 1; }
+			bool escape = src[i] == '\\' && i + 1 < size
+				&& src[i + 1] != '\n';
+			i += escape ? 2 : 1;
+		}
+	} else if (c == '\''){
+		/* 'c or '\c; there is no closing quote */
+		i++;
+		if (i < size && src[i] != '\n'){
+			bool escape = src[i] == '\\' && i + 1 < size
+				&& src[i + 1] != '\n';
+			i += escape ? 2 : 1;
+		}
+	}
+	return i;
+}
+
+std::vector<SourceChunk> findChunks(const char * src, size_t size,
+	size_t minBytes){
+	std::vector<SourceChunk> chunks;
+	size_t depth = 0;
+	bool declEnd = false; /// Nothing but blanks since a declaration ended
+	size_t chunkStart = 0;
+	size_t i = 0;
+	while (i < size){
+		char c = src[i];
+		size_t skipped = skipLiteral(src, size, i);
+		if (skipped != i){
+			if (c != '#'){ declEnd = false; }
+			i = skipped;
+			continue;
+		}
+		i++;
+		if (c == '\n'){
+			if (depth == 0 && declEnd && i - chunkStart >= minBytes){
+				chunks.push_back(SourceChunk{chunkStart, i});
+				chunkStart = i;
+			}
+		} else if (c == '{'){
+			depth++;
+			declEnd = false;
+		} else if (c == '}'){
+			if (depth > 0){ depth--; }
+			declEnd = depth == 0;
+		} else if (c == ';'){
+			declEnd = depth == 0;
+		} else if (c != ' ' && c != '\t' && c != '\r'){
+			declEnd = false;
+		}
+	}
+	if (chunkStart < size || chunks.empty()){
+		chunks.push_back(SourceChunk{chunkStart, size});
+	}
+	return chunks;
+}
+
+size_t matchBrace(const char * src, size_t size, size_t open){
+	size_t depth = 0;
+	size_t i = open;
+	while (i < size){
+		size_t skipped = skipLiteral(src, size, i);
+		if (skipped != i){
+			i = skipped;
+			continue;
+		}
+		char c = src[i++];
+		if (c == '{'){
+			depth++;
+		} else if (c == '}'){
+			if (--depth == 0){ return i; }
+		}
+	}
+	return size;
+}
+
+} //End namespace holeyc
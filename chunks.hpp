@@ -0,0 +1,38 @@
+#ifndef HOLEYC_CHUNKS_HPP
+#define HOLEYC_CHUNKS_HPP
+
+#include <cstddef>
+#include <vector>
+
+namespace holeyc{
+
+/** A run of whole top-level declarations, starting at a line start **/
+struct SourceChunk{
+	size_t begin;
+	size_t end;
+};
+
+/**
+* Split a source into chunks of at least minBytes (the last may be
+* smaller) for parsing in parallel. A prescan tracks brace depth,
+* skipping # comments and string and char literals, and only cuts
+* after a newline that follows a complete top-level declaration (a
+* ';' at depth 0 or a '}' back to depth 0).
+*
+* Cutting at line starts means no token is ever split: none spans a
+* newline. So the chunks lex exactly as the whole file does, whether
+* or not the prescan read every literal as the scanner would; a
+* misjudged cut only makes a chunk fail to parse.
+**/
+std::vector<SourceChunk> findChunks(const char * src, size_t size,
+	size_t minBytes);
+
+/**
+* The offset just past the '}' matching the '{' at src[open], skipping
+* literals and comments the same way, or size if it is never closed.
+**/
+size_t matchBrace(const char * src, size_t size, size_t open);
+
+} //End namespace holeyc
+
+#endif
@@ -0,0 +1,240 @@
+#include <algorithm>
+#include <sstream>
+#include "diagnostics.hpp"
+#include "errors.hpp"
+
+namespace holeyc{
+
+static const char * codeText(DiagCode code){
+	switch (code){
+	case DiagCode::IllegalChar: return "Illegal character ";
+	case DiagCode::EmptyCharEscape:
+		return "Empty escape sequence in character literal";
+	case DiagCode::EmptyChar: return "Empty character literal";
+	case DiagCode::BadCharEscape: return "Bad escape sequence in char literal";
+	case DiagCode::BadStrEscape:
+		return "String literal with bad escape sequence ignored";
+	case DiagCode::UntermStr: return "Unterminated string literal ignored";
+	case DiagCode::UntermStrBadEscape:
+		return "Unterminated string literal  with bad escape sequence ignored";
+	case DiagCode::IntOverflow:
+		return "Integer literal too large;  using max value";
+	case DiagCode::SyntaxError: return "syntax error";
+	case DiagCode::UndeclaredID: return "Undeclared identifier";
+	case DiagCode::MultiDecl: return "Multiply declared identifier";
+	case DiagCode::BadDeclType: return "Invalid type in declaration";
+	case DiagCode::BadArithOperand:
+		return "Arithmetic operator applied to invalid operand";
+	case DiagCode::BadLogicOperand:
+		return "Logical operator applied to non-bool operand";
+	case DiagCode::BadRelOperand:
+		return "Relational operator applied to non-numeric operand";
+	case DiagCode::BadEqOperand: return "Invalid equality operand";
+	case DiagCode::BadAssignOperand: return "Invalid assignment operand";
+	case DiagCode::TypeMismatch: return "Type mismatch";
+	case DiagCode::DerefNonPtr: return "Dereference of a non-pointer";
+	case DiagCode::BadRefOperand: return "Invalid reference operand";
+	case DiagCode::IndexNonPtr: return "Attempt to index a non-pointer";
+	case DiagCode::BadIndex: return "Non-integer index";
+	case DiagCode::CallNonFn: return "Attempt to call a non-function";
+	case DiagCode::BadArgCount:
+		return "Function call with wrong number of args";
+	case DiagCode::BadArgType:
+		return "Type of actual does not match type of formal";
+	case DiagCode::BadIfCond:
+		return "Non-bool expression used as an if condition";
+	case DiagCode::BadWhileCond:
+		return "Non-bool expression used as a while condition";
+	case DiagCode::ReturnInVoid:
+		return "Return with a value in void function";
+	case DiagCode::MissingReturn: return "Missing return value";
+	case DiagCode::BadReturn: return "Bad return value";
+	case DiagCode::ReadFn: return "Attempt to assign user input to function";
+	case DiagCode::WriteFn: return "Attempt to output a function";
+	case DiagCode::WriteVoid: return "Attempt to output void";
+	case DiagCode::RefTarget: return "Attempt to assign to an address";
+	case DiagCode::ErrorLimit: return "";
+	case DiagCode::Message: return "";
+	}
+	return "";
+}
+
+static const char * codeName(DiagCode code){
+	switch (code){
+	case DiagCode::IllegalChar: return "illegal-char";
+	case DiagCode::EmptyCharEscape: return "empty-char-escape";
+	case DiagCode::EmptyChar: return "empty-char";
+	case DiagCode::BadCharEscape: return "bad-char-escape";
+	case DiagCode::BadStrEscape: return "bad-string-escape";
+	case DiagCode::UntermStr: return "unterminated-string";
+	case DiagCode::UntermStrBadEscape: return "unterminated-string-bad-escape";
+	case DiagCode::IntOverflow: return "int-overflow";
+	case DiagCode::SyntaxError: return "syntax-error";
+	case DiagCode::UndeclaredID: return "undeclared-id";
+	case DiagCode::MultiDecl: return "multiply-declared-id";
+	case DiagCode::BadDeclType: return "bad-decl-type";
+	case DiagCode::BadArithOperand: return "bad-arith-operand";
+	case DiagCode::BadLogicOperand: return "bad-logic-operand";
+	case DiagCode::BadRelOperand: return "bad-rel-operand";
+	case DiagCode::BadEqOperand: return "bad-eq-operand";
+	case DiagCode::BadAssignOperand: return "bad-assign-operand";
+	case DiagCode::TypeMismatch: return "type-mismatch";
+	case DiagCode::DerefNonPtr: return "deref-non-ptr";
+	case DiagCode::BadRefOperand: return "bad-ref-operand";
+	case DiagCode::IndexNonPtr: return "index-non-ptr";
+	case DiagCode::BadIndex: return "bad-index";
+	case DiagCode::CallNonFn: return "call-non-fn";
+	case DiagCode::BadArgCount: return "bad-arg-count";
+	case DiagCode::BadArgType: return "bad-arg-type";
+	case DiagCode::BadIfCond: return "bad-if-cond";
+	case DiagCode::BadWhileCond: return "bad-while-cond";
+	case DiagCode::ReturnInVoid: return "return-in-void";
+	case DiagCode::MissingReturn: return "missing-return";
+	case DiagCode::BadReturn: return "bad-return";
+	case DiagCode::ReadFn: return "read-fn";
+	case DiagCode::WriteFn: return "write-fn";
+	case DiagCode::WriteVoid: return "write-void";
+	case DiagCode::RefTarget: return "ref-target";
+	case DiagCode::ErrorLimit: return "error-limit";
+	case DiagCode::Message: return "message";
+	}
+	return "";
+}
+
+static const char * severityName(Severity severity){
+	switch (severity){
+	case Severity::Fatal: return "fatal";
+	case Severity::Error: return "error";
+	case Severity::Warning: return "warning";
+	case Severity::Note: return "note";
+	}
+	return "";
+}
+
+static void writeText(std::ostream& out, const Diagnostic& d){
+	/* Position-less text and syntax errors print as they always have */
+	if (d.code == DiagCode::SyntaxError){
+		out << codeText(d.code) << '\n';
+		return;
+	}
+	if (d.line == 0){
+		out << codeText(d.code) << d.detail << '\n';
+		return;
+	}
+	switch (d.severity){
+	case Severity::Fatal: out << "FATAL"; break;
+	case Severity::Error: out << "ERROR"; break;
+	case Severity::Warning: out << "*WARNING*"; break;
+	case Severity::Note: out << "*NOTE*"; break;
+	}
+	out << " [" << d.line << "," << d.col << "]: "
+		<< codeText(d.code) << d.detail << '\n';
+}
+
+static void writeJSONString(std::ostream& out, const std::string& text){
+	static const char hex[] = "0123456789abcdef";
+	out << '"';
+	for (char ch : text){
+		unsigned char u = static_cast<unsigned char>(ch);
+		if (ch == '"' || ch == '\\'){
+			out << '\\' << ch;
+		} else if (u < 0x20){
+			out << "\\u00" << hex[u >> 4] << hex[u & 0xF];
+		} else {
+			out << ch;
+		}
+	}
+	out << '"';
+}
+
+static void writeJSON(std::ostream& out, const Diagnostic& d,
+	const char * file){
+	out << "{";
+	if (file != nullptr){
+		out << "\"file\":";
+		writeJSONString(out, file);
+		out << ",";
+	}
+	out << "\"severity\":\"" << severityName(d.severity) << "\""
+		<< ",\"line\":" << d.line << ",\"col\":" << d.col
+		<< ",\"code\":\"" << codeName(d.code) << "\",\"message\":";
+	/* A syntax error's detail is the parser's full message */
+	if (d.code == DiagCode::SyntaxError && !d.detail.empty()){
+		writeJSONString(out, d.detail);
+	} else {
+		writeJSONString(out, codeText(d.code) + d.detail);
+	}
+	out << "}\n";
+}
+
+void Diagnostics::add(Severity severity, DiagCode code, size_t line,
+	size_t col, std::string detail){
+	bool isError = severity == Severity::Fatal
+		|| severity == Severity::Error;
+	/* Driver messages are never dropped; they explain the exit */
+	if (isError && code != DiagCode::Message){
+		if (myErrorLimit != 0 && myErrors >= myErrorLimit){
+			myDropped++;
+			return;
+		}
+		myErrors++;
+	}
+	uint32_t seq = static_cast<uint32_t>(myRecords.size());
+	myRecords.push_back(
+		Diagnostic{line, col, seq, severity, code, std::move(detail)});
+}
+
+std::vector<Diagnostic> Diagnostics::take(){
+	std::vector<Diagnostic> records;
+	records.swap(myRecords);
+	myErrors = 0;
+	myDropped = 0;
+	return records;
+}
+
+void Diagnostics::flush(std::ostream& out, DiagFormat format,
+	const char * file){
+	std::stable_sort(myRecords.begin(), myRecords.end(),
+		[](const Diagnostic& a, const Diagnostic& b){
+		if ((a.line == 0) != (b.line == 0)){ return b.line == 0; }
+		if (a.line != b.line){ return a.line < b.line; }
+		return a.col < b.col;
+	});
+	if (myDropped > 0){
+		myRecords.push_back(Diagnostic{0, 0,
+			static_cast<uint32_t>(myRecords.size()), Severity::Note,
+			DiagCode::ErrorLimit, std::to_string(myDropped)
+			+ " more errors not shown (limit "
+			+ std::to_string(myErrorLimit) + ")"});
+	}
+	/* std::cerr is unit-buffered, so build the text first and hand
+	   it over in one write rather than one per insertion */
+	std::ostringstream text;
+	for (const Diagnostic& d : myRecords){
+		if (format == DiagFormat::JSON){
+			writeJSON(text, d, file);
+		} else {
+			writeText(text, d);
+		}
+	}
+	const std::string& all = text.str();
+	out.write(all.data(), static_cast<std::streamsize>(all.size()));
+	out.flush();
+	myRecords.clear();
+	myErrors = 0;
+	myDropped = 0;
+}
+
+void Diagnostics::report(Severity severity, DiagCode code, size_t line,
+	size_t col, std::string detail){
+	Diagnostics * diags = active();
+	if (diags != nullptr){
+		diags->add(severity, code, line, col, std::move(detail));
+		return;
+	}
+	Diagnostic d{line, col, 0, severity, code, std::move(detail)};
+	writeText(Report::errs(), d);
+	Report::errs().flush();
+}
+
+} //End namespace holeyc
@@ -0,0 +1,111 @@
+#ifndef HOLEYC_DIAGNOSTICS_HPP
+#define HOLEYC_DIAGNOSTICS_HPP
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace holeyc{
+
+enum class Severity : uint8_t { Fatal, Error, Warning, Note };
+
+/**
+* What a diagnostic is about. Each code has fixed text that is only
+* looked up when the diagnostic is printed; Message is free-form and
+* keeps all of its text in the detail.
+**/
+enum class DiagCode : uint8_t{
+	IllegalChar, EmptyCharEscape, EmptyChar, BadCharEscape,
+	BadStrEscape, UntermStr, UntermStrBadEscape, IntOverflow,
+	SyntaxError, UndeclaredID, MultiDecl, BadDeclType,
+	BadArithOperand, BadLogicOperand, BadRelOperand, BadEqOperand,
+	BadAssignOperand, TypeMismatch, DerefNonPtr, BadRefOperand,
+	IndexNonPtr, BadIndex, CallNonFn, BadArgCount, BadArgType,
+	BadIfCond, BadWhileCond, ReturnInVoid, MissingReturn, BadReturn,
+	ReadFn, WriteFn, WriteVoid, RefTarget,
+	ErrorLimit, Message,
+};
+
+struct Diagnostic{
+	size_t line; /// 0 for diagnostics without a source position
+	size_t col;
+	uint32_t seq; /// Order of arrival, to keep sorting stable
+	Severity severity;
+	DiagCode code;
+	std::string detail;
+};
+
+enum class DiagFormat : uint8_t { Text, JSON };
+
+/**
+* \class Diagnostics
+* Collects one compilation's diagnostics as plain records and prints
+* them all at once, sorted by position, with a single flush. Positioned
+* records come first; records without a position (driver messages such
+* as "Parse failed") follow in the order they were reported.
+*
+* A collector is made active for the current thread with a
+* DiagnosticScope. While none is active, Report prints each diagnostic
+* immediately, as it always has.
+**/
+class Diagnostics{
+public:
+	/** errorLimit: errors kept before the rest are only counted; 0 is no limit **/
+	explicit Diagnostics(size_t errorLimit = 0)
+	: myErrorLimit(errorLimit), myErrors(0), myDropped(0){ }
+
+	void add(Severity severity, DiagCode code, size_t line, size_t col,
+		std::string detail = "");
+
+	size_t errorCount() const { return myErrors; }
+
+	/** Hand over the records in arrival order and start over empty **/
+	std::vector<Diagnostic> take();
+	bool empty() const { return myRecords.empty() && myDropped == 0; }
+
+	/**
+	* Print and forget everything collected. JSON output is one
+	* object per line; file (if given) is included in each object.
+	**/
+	void flush(std::ostream& out, DiagFormat format,
+		const char * file = nullptr);
+
+	/** Route one diagnostic to this thread's active collector, if any **/
+	static void report(Severity severity, DiagCode code, size_t line,
+		size_t col, std::string detail = "");
+
+private:
+	friend class DiagnosticScope;
+	static Diagnostics *& active(){
+		thread_local Diagnostics * current = nullptr;
+		return current;
+	}
+
+	size_t myErrorLimit;
+	size_t myErrors;
+	size_t myDropped;
+	std::vector<Diagnostic> myRecords;
+};
+
+/**
+* \class DiagnosticScope
+* Makes a collector the current thread's destination for Report
+* diagnostics while in scope.
+**/
+class DiagnosticScope{
+public:
+	explicit DiagnosticScope(Diagnostics& diags)
+	: mySaved(Diagnostics::active()){
+		Diagnostics::active() = &diags;
+	}
+	~DiagnosticScope(){ Diagnostics::active() = mySaved; }
+	DiagnosticScope(const DiagnosticScope&) = delete;
+	DiagnosticScope& operator=(const DiagnosticScope&) = delete;
+private:
+	Diagnostics * mySaved;
+};
+
+} //End namespace holeyc
+
+#endif
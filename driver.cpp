@@ -0,0 +1,482 @@
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include "driver.hpp"
+#include "errors.hpp"
+#include "astcache.hpp"
+#include "session.hpp"
+
+namespace holeyc{
+
+static void writeTokenStream(CompilationSession& session,
+	const char * outPath){
+	if (strcmp(outPath, "--") == 0){
+		session.writeTokens(Report::outs());
+	} else {
+		std::ofstream outStream(outPath);
+		if (!outStream.good()){
+			std::string msg = "Bad output file ";
+			msg += outPath;
+			throw new InternalError(msg.c_str());
+		}
+		session.writeTokens(outStream);
+		outStream.close();
+	}
+}
+
+static void writeBinaryTokenFile(CompilationSession& session,
+	const char * outPath){
+	if (strcmp(outPath, "--") == 0){
+		session.writeBinaryTokens(Report::outs());
+	} else {
+		std::ofstream outStream(outPath, std::ios::binary);
+		if (!outStream.good()){
+			std::string msg = "Bad output file ";
+			msg += outPath;
+			throw new InternalError(msg.c_str());
+		}
+		session.writeBinaryTokens(outStream);
+	}
+}
+
+/** unparse is called with the Writer to print to **/
+template <typename Unparse>
+static void doUnparsing(const char * outPath, Unparse unparse){
+	if (strcmp(outPath, "--") == 0){
+		Writer writer(Report::outs());
+		unparse(writer);
+	} else {
+		std::ofstream outStream(outPath);
+		if (!outStream.good()){
+			std::string msg = "Bad output file ";
+			msg += outPath;
+			throw new holeyc::InternalError(msg.c_str());
+		}
+		Writer writer(outStream);
+		unparse(writer);
+	}
+}
+
+static void writeMemStats(const CompilationSession& session,
+	const char * outPath){
+	if (strcmp(outPath, "--") == 0){
+		session.reportMemory(Report::outs());
+	} else {
+		std::ofstream outStream(outPath);
+		if (!outStream.good()){
+			std::string msg = "Bad output file ";
+			msg += outPath;
+			throw new InternalError(msg.c_str());
+		}
+		session.reportMemory(outStream);
+	}
+}
+
+/* The stream outPath names; a file is opened into file */
+static std::ostream& openOutput(const char * outPath, std::ofstream& file){
+	if (strcmp(outPath, "--") == 0){
+		return Report::outs();
+	}
+	file.open(outPath);
+	if (!file.good()){
+		std::string msg = "Bad output file ";
+		msg += outPath;
+		throw new InternalError(msg.c_str());
+	}
+	return file;
+}
+
+/** Writes the -u and -i text of each declaration as it is parsed **/
+class DeclWriter : public DeclSink{
+public:
+	DeclWriter(Writer * unparse, Writer * interface)
+	: myUnparse(unparse), myInterface(interface){ }
+	void declParsed(DeclNode * decl) override{
+		if (myUnparse != nullptr){ decl->unparse(*myUnparse, 0); }
+		if (myInterface != nullptr){ decl->unparseInterface(*myInterface); }
+	}
+private:
+	Writer * myUnparse;
+	Writer * myInterface;
+};
+
+/**
+* -s: -p, -u and -i one declaration at a time. Unlike the whole
+* program outputs, -u and -i keep what precedes a syntax error.
+**/
+static int runStreaming(CompilationSession& session,
+	const CompileOptions& opts){
+	std::ofstream unparseStream;
+	std::ofstream interfaceStream;
+	std::unique_ptr<Writer> unparse;
+	std::unique_ptr<Writer> interface;
+	try {
+		if (opts.unparseFile != nullptr){
+			unparse.reset(new Writer(
+				openOutput(opts.unparseFile, unparseStream)));
+		}
+		if (opts.interfaceFile != nullptr){
+			interface.reset(new Writer(
+				openOutput(opts.interfaceFile, interfaceStream)));
+		}
+	} catch (InternalError * e){
+		Report::message("Error: " + e->msg());
+		return 1;
+	}
+
+	bool parsed = false;
+	try {
+		DeclWriter writer(unparse.get(), interface.get());
+		parsed = session.stream(writer);
+	} catch (ToDoError * e){
+		Report::message(std::string("ToDo: ") + e->msg());
+		return 1;
+	}
+	unparse.reset();
+	interface.reset();
+	if (opts.checkParse && !parsed){
+		Report::message("Parse failed");
+	}
+
+	if (opts.statsFile != nullptr){
+		try {
+			writeMemStats(session, opts.statsFile);
+		} catch (InternalError * e){
+			Report::message("Error: " + e->msg());
+		}
+	}
+	return 0;
+}
+
+/** -p and -u straight from a cache entry **/
+static int runCached(const CachedAST& cached, CompilationSession& session,
+	const CompileOptions& opts){
+	if (opts.unparseFile != nullptr){
+		try {
+			doUnparsing(opts.unparseFile, [&](Writer& out){
+				cached.flat().unparse(out);
+			});
+		} catch (InternalError * e){
+			Report::message("Error: " + e->msg());
+			return 1;
+		}
+	}
+	if (opts.statsFile != nullptr){
+		try {
+			writeMemStats(session, opts.statsFile);
+		} catch (InternalError * e){
+			Report::message("Error: " + e->msg());
+		}
+	}
+	return 0;
+}
+
+static int runOutputs(const char * inPath, const CompileOptions& opts,
+	const Diagnostics& diags){
+	/* The input is read and lexed once; every requested
+	   output is served from the same tokens and AST. Token
+	   dumps need every token kept, so they do not stream. */
+	bool needsTokens = opts.tokensFile != nullptr
+		|| opts.binTokensFile != nullptr;
+	bool needsNames = opts.namesFile != nullptr || opts.checkTypes
+		|| opts.fold || opts.irFile != nullptr;
+	bool streaming = opts.stream && !needsTokens && !opts.validate
+		&& !needsNames;
+
+	std::unique_ptr<CompilationSession> session;
+	try {
+		/* A lexer thread's tokens would outlive streaming's recycling */
+		session.reset(new CompilationSession(inPath,
+			opts.lexThread && !streaming));
+	} catch (InternalError * e){
+		Report::message("Error: " + e->msg());
+		return 1;
+	}
+	if (needsTokens){
+		session->recordTokens();
+	}
+	session->parseInParallel(opts.parseThreads);
+	session->limitDepth(opts.depthLimit);
+	if (opts.hashCons){
+		session->hashCons();
+	}
+
+	/* An interface alone never looks inside a function body */
+	bool needsAST = opts.checkParse || opts.unparseFile != nullptr
+		|| needsNames;
+	if (opts.interfaceFile != nullptr && !needsAST && !needsTokens
+		&& !opts.validate){
+		session->lazyBodies();
+	}
+
+	/* -v on its own builds nothing; with other outputs the full
+	   parse they need answers it */
+	if (opts.validate && !needsAST && !needsTokens
+		&& opts.interfaceFile == nullptr){
+		bool valid = session->validate();
+		if (!valid){
+			Report::message("Parse failed");
+		}
+		if (opts.statsFile != nullptr){
+			try {
+				writeMemStats(*session, opts.statsFile);
+			} catch (InternalError * e){
+				Report::message("Error: " + e->msg());
+			}
+		}
+		return valid ? 0 : 1;
+	}
+
+	if (streaming){
+		return runStreaming(*session, opts);
+	}
+
+	/* A cached AST serves -p and -u without running the scanner or
+	   parser; the token outputs still need a real scan. The key is
+	   the source alone, so a parse that -D may reject, or that -h
+	   shapes, does not use the cache. */
+	bool cacheable = opts.cacheDir != nullptr && needsAST && !needsTokens
+		&& opts.interfaceFile == nullptr && !needsNames
+		&& opts.depthLimit == 0 && !opts.hashCons;
+	if (cacheable){
+		std::unique_ptr<CachedAST> cached =
+			AstCache(opts.cacheDir).load(session->source());
+		if (cached != nullptr){
+			return runCached(*cached, *session, opts);
+		}
+	}
+
+	ProgramNode * ast = nullptr;
+	if (needsAST || opts.validate || opts.interfaceFile != nullptr){
+		try {
+			ast = session->ast();
+		} catch (ToDoError * e){
+			Report::message(std::string("ToDo: ") + e->msg());
+			return 1;
+		}
+	}
+
+	/* Only clean compiles are cached: a hit replays no diagnostics */
+	if (cacheable && ast != nullptr && diags.empty()){
+		FlatAST flat;
+		ast->flatten(flat, session->lines());
+		AstCache(opts.cacheDir).store(session->source(), flat);
+	}
+
+	if (opts.tokensFile != nullptr){
+		try {
+			writeTokenStream(*session, opts.tokensFile);
+		} catch (InternalError * e){
+			Report::message("Error: " + e->msg());
+		}
+	}
+
+	if (opts.binTokensFile != nullptr){
+		try {
+			writeBinaryTokenFile(*session, opts.binTokensFile);
+		} catch (InternalError * e){
+			Report::message("Error: " + e->msg());
+		}
+	}
+
+	if ((opts.checkParse || opts.validate) && ast == nullptr){
+		Report::message("Parse failed");
+	}
+
+	/* Folding needs every expression typed; -u and -n then show the
+	   folded program */
+	if (opts.fold && ast != nullptr){
+		session->foldConstants();
+	}
+
+	if (opts.unparseFile != nullptr && ast != nullptr){
+		try {
+			doUnparsing(opts.unparseFile, [&](Writer& out){
+				ast->unparse(out, 0);
+			});
+		} catch (InternalError * e){
+			Report::message("Error: " + e->msg());
+			return 1;
+		} catch (ToDoError * e){
+			Report::message(std::string("ToDo: ") + e->msg());
+			return 1;
+		}
+	}
+
+	/* Names are only written, and types only checked, once every
+	   name is declared; a program that did not parse fails them */
+	bool semanticsFailed = needsNames && ast == nullptr;
+	if (needsNames && ast != nullptr){
+		if (!session->analyzeNames()){
+			Report::message("Name analysis failed");
+			semanticsFailed = true;
+		} else {
+			if (opts.namesFile != nullptr){
+				try {
+					doUnparsing(opts.namesFile, [&](Writer& out){
+						ast->unparseNames(out);
+					});
+				} catch (InternalError * e){
+					Report::message("Error: " + e->msg());
+					return 1;
+				}
+			}
+			if ((opts.checkTypes || opts.fold || opts.irFile != nullptr)
+				&& !session->checkTypes()){
+				Report::message("Type check failed");
+				semanticsFailed = true;
+			}
+		}
+	}
+
+	if (opts.irFile != nullptr && !semanticsFailed && ast != nullptr){
+		try {
+			const IRProgram * ir = session->lowerIR();
+			doUnparsing(opts.irFile, [&](Writer& out){ ir->dump(out); });
+		} catch (InternalError * e){
+			Report::message("Error: " + e->msg());
+			return 1;
+		}
+	}
+
+	if (opts.interfaceFile != nullptr && ast != nullptr){
+		try {
+			doUnparsing(opts.interfaceFile, [&](Writer& out){
+				ast->unparseInterface(out);
+			});
+		} catch (InternalError * e){
+			Report::message("Error: " + e->msg());
+			return 1;
+		}
+	}
+
+	if (opts.statsFile != nullptr){
+		try {
+			writeMemStats(*session, opts.statsFile);
+		} catch (InternalError * e){
+			Report::message("Error: " + e->msg());
+		}
+	}
+	return (opts.validate && ast == nullptr) || semanticsFailed ? 1 : 0;
+}
+
+int compileFile(const char * inPath, const CompileOptions& opts){
+	Diagnostics diags(opts.errorLimit);
+	int status;
+	{
+		DiagnosticScope scope(diags);
+		status = runOutputs(inPath, opts, diags);
+	}
+	const char * file = opts.diagFormat == DiagFormat::JSON ? inPath : nullptr;
+	diags.flush(Report::errs(), opts.diagFormat, file);
+	return status;
+}
+
+void BatchDriver::addManifest(const char * manifestPath){
+	std::ifstream manifest(manifestPath);
+	if (!manifest.good()){
+		std::string msg = "Bad manifest file ";
+		msg += manifestPath;
+		throw new InternalError(msg.c_str());
+	}
+	std::string line;
+	while (std::getline(manifest, line)){
+		size_t end = line.find_last_not_of(" \t\r");
+		if (end == std::string::npos){ continue; }
+		myInputs.push_back(line.substr(0, end + 1));
+	}
+}
+
+std::string BatchDriver::outputPath(const char * suffix, size_t index) const {
+	if (strcmp(suffix, "--") == 0){ return suffix; }
+	return myInputs[index] + suffix;
+}
+
+void BatchDriver::compileOne(size_t index, Result& result){
+	std::string tokens, binTokens, unparse, interface, names, ir, stats;
+	CompileOptions opts = myOpts;
+	if (opts.tokensFile != nullptr){
+		tokens = outputPath(opts.tokensFile, index);
+		opts.tokensFile = tokens.c_str();
+	}
+	if (opts.binTokensFile != nullptr){
+		binTokens = outputPath(opts.binTokensFile, index);
+		opts.binTokensFile = binTokens.c_str();
+	}
+	if (opts.unparseFile != nullptr){
+		unparse = outputPath(opts.unparseFile, index);
+		opts.unparseFile = unparse.c_str();
+	}
+	if (opts.interfaceFile != nullptr){
+		interface = outputPath(opts.interfaceFile, index);
+		opts.interfaceFile = interface.c_str();
+	}
+	if (opts.namesFile != nullptr){
+		names = outputPath(opts.namesFile, index);
+		opts.namesFile = names.c_str();
+	}
+	if (opts.irFile != nullptr){
+		ir = outputPath(opts.irFile, index);
+		opts.irFile = ir.c_str();
+	}
+	if (opts.statsFile != nullptr){
+		stats = outputPath(opts.statsFile, index);
+		opts.statsFile = stats.c_str();
+	}
+
+	std::ostringstream out;
+	std::ostringstream err;
+	{
+		ReportCapture capture(out, err);
+		result.status = compileFile(myInputs[index].c_str(), opts);
+	}
+	result.out = out.str();
+	result.err = err.str();
+}
+
+int BatchDriver::run(){
+	std::vector<Result> results(myInputs.size());
+	std::atomic<size_t> next(0);
+	std::mutex doneLock;
+	std::condition_variable doneSignal;
+
+	/* Workers claim files in input order; the calling thread
+	   prints each file's buffered output as soon as it and every
+	   file before it are finished. */
+	auto work = [&](){
+		for (size_t i = next++; i < results.size(); i = next++){
+			Result result;
+			compileOne(i, result);
+			std::lock_guard<std::mutex> guard(doneLock);
+			results[i] = std::move(result);
+			results[i].done = true;
+			doneSignal.notify_all();
+		}
+	};
+	size_t threads = std::min<size_t>(myWorkers, myInputs.size());
+	std::vector<std::thread> pool;
+	for (size_t t = 0; t < threads; t++){ pool.emplace_back(work); }
+
+	int status = 0;
+	for (size_t i = 0; i < results.size(); i++){
+		Result result;
+		{
+			std::unique_lock<std::mutex> guard(doneLock);
+			doneSignal.wait(guard, [&](){ return results[i].done; });
+			result = std::move(results[i]);
+		}
+		std::cout << result.out << std::flush;
+		std::cerr << result.err << std::flush;
+		if (result.status != 0){ status = 1; }
+	}
+	for (std::thread& t : pool){ t.join(); }
+	return status;
+}
+
+} //End namespace holeyc
@@ -0,0 +1,86 @@
+#ifndef HOLEYC_DRIVER_HPP
+#define HOLEYC_DRIVER_HPP
+
+#include <string>
+#include "diagnostics.hpp"
+#include <vector>
+
+namespace holeyc{
+
+/**
+* What to do with each input file. Output paths may be "--" for
+* the current thread's Report::outs(); nullptr skips that output.
+**/
+struct CompileOptions{
+	const char * tokensFile = nullptr;
+	const char * binTokensFile = nullptr;
+	bool checkParse = false;
+	bool checkTypes = false; /// Name analysis and type checking
+	bool fold = false; /// Fold constants once types check (implies -c)
+	bool validate = false; /// Syntax check only; exit status 1 if it fails
+	bool lexThread = false; /// Lex on a second thread, ahead of the parser
+	unsigned parseThreads = 1; /// Threads for one file's chunks and functions
+	bool stream = false; /// Write and free each declaration once parsed
+	size_t depthLimit = 0; /// Parser stack entries allowed; 0 is no limit
+	bool hashCons = false; /// Share identical side-effect-free expressions
+	const char * unparseFile = nullptr;
+	const char * interfaceFile = nullptr; /// Declarations only, no bodies
+	const char * namesFile = nullptr; /// Unparse with each name's type
+	const char * irFile = nullptr; /// Three-address code, once types check
+	const char * statsFile = nullptr;
+	const char * cacheDir = nullptr; /// AST cache directory, if any
+	size_t errorLimit = 0; /// Errors shown per file; 0 shows all
+	DiagFormat diagFormat = DiagFormat::Text;
+};
+
+/**
+* Run the requested front end outputs for one file; returns its exit
+* status. Its diagnostics are written to Report::errs() at the end,
+* sorted by position.
+**/
+int compileFile(const char * inPath, const CompileOptions& opts);
+
+/**
+* \class BatchDriver
+* Compiles many files in one process on a fixed pool of worker
+* threads. Each file gets its own session (source, arena, scanner and
+* parser). Its stdout and stderr text is buffered and written out
+* strictly in input order, so the output does not depend on thread
+* scheduling.
+*
+* In batch mode each output path in the options is a suffix added to
+* every input's name, e.g. "-u .unparse" writes a.holeyc.unparse.
+* "--" still means stdout.
+**/
+class BatchDriver{
+public:
+	BatchDriver(const CompileOptions& opts, unsigned workers)
+	: myOpts(opts), myWorkers(workers == 0 ? 1 : workers){ }
+
+	void addInput(const std::string& path){ myInputs.push_back(path); }
+	/** Add every non-blank line of the manifest file as an input **/
+	void addManifest(const char * manifestPath);
+	size_t inputCount() const { return myInputs.size(); }
+
+	/** Compile every input; returns nonzero if any file failed **/
+	int run();
+
+private:
+	struct Result{
+		std::string out;
+		std::string err;
+		int status = 0;
+		bool done = false;
+	};
+
+	void compileOne(size_t index, Result& result);
+	std::string outputPath(const char * suffix, size_t index) const;
+
+	CompileOptions myOpts;
+	unsigned myWorkers;
+	std::vector<std::string> myInputs;
+};
+
+} //End namespace holeyc
+
+#endif
@@ -7,6 +7,8 @@
 #define TODO(x) throw new ToDoError(CODELOC #x);
 
 #include <iostream>
+#include <string>
+#include "diagnostics.hpp"
 
 namespace holeyc{
 
@@ -28,13 +30,24 @@ private:
 
 class Report{
 public:
+	/**
+	* Streams this thread writes its diagnostics and parser chatter
+	* to. They are std::cerr and std::cout unless a ReportCapture
+	* has redirected them.
+	**/
+	static std::ostream& errs(){ return *errTarget(); }
+	static std::ostream& outs(){ return *outTarget(); }
+
+	/*
+	Diagnostics go to the current thread's Diagnostics collector
+	(see diagnostics.hpp), or straight to errs() if there is none.
+	*/
 	static void fatal(
 		size_t l, 
 		size_t c, 
 		const char * msg
 	){
-		std::cerr << "FATAL [" << l << "," << c << "]: " 
-		<< msg  << std::endl;
+		Diagnostics::report(Severity::Fatal, DiagCode::Message, l, c, msg);
 	}
 
 	static void fatal(
@@ -45,13 +58,31 @@ public:
 		fatal(l,c,msg.c_str());
 	}
 
+	static void fatal(
+		size_t l,
+		size_t c,
+		DiagCode code,
+		std::string detail = ""
+	){
+		Diagnostics::report(Severity::Fatal, code, l, c,
+			std::move(detail));
+	}
+
+	static void error(
+		size_t l,
+		size_t c,
+		const std::string msg
+	){
+		Diagnostics::report(Severity::Error, DiagCode::Message, l, c, msg);
+	}
+
 	static void warn(
 		size_t l,
 		size_t c,
 		const char * msg
 	){
-		std::cerr << "*WARNING* [" << l << "," << c << "]: " 
-		<< msg  << std::endl;
+		Diagnostics::report(Severity::Warning, DiagCode::Message, l, c,
+			msg);
 	}
 
 	static void warn(
@@ -61,6 +92,46 @@ public:
 	){
 		warn(l,c,msg.c_str());
 	}
+
+	/** A message with no source position, such as "Parse failed" **/
+	static void message(const std::string msg){
+		Diagnostics::report(Severity::Error, DiagCode::Message, 0, 0, msg);
+	}
+
+private:
+	friend class ReportCapture;
+	static std::ostream *& errTarget(){
+		thread_local std::ostream * target = &std::cerr;
+		return target;
+	}
+	static std::ostream *& outTarget(){
+		thread_local std::ostream * target = &std::cout;
+		return target;
+	}
+};
+
+/**
+* \class ReportCapture
+* Sends the current thread's Report output to other streams for as
+* long as it is in scope, so one file's diagnostics can be buffered
+* while other threads compile other files.
+**/
+class ReportCapture{
+public:
+	ReportCapture(std::ostream& out, std::ostream& err)
+	: mySavedOut(Report::outTarget()), mySavedErr(Report::errTarget()){
+		Report::outTarget() = &out;
+		Report::errTarget() = &err;
+	}
+	~ReportCapture(){
+		Report::outTarget() = mySavedOut;
+		Report::errTarget() = mySavedErr;
+	}
+	ReportCapture(const ReportCapture&) = delete;
+	ReportCapture& operator=(const ReportCapture&) = delete;
+private:
+	std::ostream * mySavedOut;
+	std::ostream * mySavedErr;
 };
 
 }
@@ -0,0 +1,495 @@
+#include <cstring>
+#include "flat_ast.hpp"
+
+namespace holeyc{
+
+FlatAST::FlatAST()
+: mySize(0), myKidTotal(0), myKindView(nullptr), myPositionView(nullptr),
+  myFirstKidView(nullptr), myKidCountView(nullptr), myPayloadView(nullptr),
+  myKidView(nullptr), myImageBytes(0), myAttached(false){
+}
+
+void FlatAST::syncViews(){
+	mySize = myKinds.size();
+	myKidTotal = myKids.size();
+	myKindView = myKinds.data();
+	myPositionView = myPositions.data();
+	myFirstKidView = myFirstKids.data();
+	myKidCountView = myKidCounts.data();
+	myPayloadView = myPayloads.data();
+	myKidView = myKids.data();
+}
+
+FlatAST::NodeID FlatAST::add(FlatKind kind, size_t line, size_t col,
+	uint32_t payload, const NodeID * kids, size_t kidCount){
+	NodeID id = static_cast<NodeID>(myKinds.size());
+	uint32_t pos = POS_OVERFLOW;
+	if (col < (1u << COL_BITS) && line < (POS_OVERFLOW >> COL_BITS)){
+		pos = static_cast<uint32_t>(line << COL_BITS | col);
+	} else {
+		myBigPositions[id] = std::make_pair(line, col);
+	}
+	myKinds.push_back(kind);
+	myPositions.push_back(pos);
+	myFirstKids.push_back(static_cast<uint32_t>(myKids.size()));
+	myKidCounts.push_back(static_cast<uint32_t>(kidCount));
+	myPayloads.push_back(payload);
+	myKids.insert(myKids.end(), kids, kids + kidCount);
+	syncViews();
+	return id;
+}
+
+size_t FlatAST::line(NodeID n) const {
+	uint32_t pos = myPositionView[n];
+	if (pos == POS_OVERFLOW){ return myBigPositions.at(n).first; }
+	return pos >> COL_BITS;
+}
+
+size_t FlatAST::col(NodeID n) const {
+	uint32_t pos = myPositionView[n];
+	if (pos == POS_OVERFLOW){ return myBigPositions.at(n).second; }
+	return pos & ((1u << COL_BITS) - 1);
+}
+
+size_t FlatAST::bytes() const {
+	if (myAttached){ return myImageBytes; }
+	return myKinds.capacity() * sizeof(FlatKind)
+		+ myPositions.capacity() * sizeof(uint32_t)
+		+ myFirstKids.capacity() * sizeof(uint32_t)
+		+ myKidCounts.capacity() * sizeof(uint32_t)
+		+ myPayloads.capacity() * sizeof(uint32_t)
+		+ myKids.capacity() * sizeof(NodeID)
+		+ myStrings.capacity() * sizeof(StrRef);
+}
+
+static void doIndent(UnparseStack<FlatAST::NodeID>& out, int indent){
+	out.indent(indent);
+}
+
+static const char * binaryOp(FlatKind kind){
+	switch (kind){
+	case FlatKind::Plus: return " + ";
+	case FlatKind::Minus: return " - ";
+	case FlatKind::Times: return " * ";
+	case FlatKind::Divide: return " / ";
+	case FlatKind::And: return " && ";
+	case FlatKind::Or: return " || ";
+	case FlatKind::Equals: return " == ";
+	case FlatKind::NotEquals: return " != ";
+	case FlatKind::Less: return " < ";
+	case FlatKind::Greater: return " > ";
+	case FlatKind::LessEq: return " <= ";
+	case FlatKind::GreaterEq: return " >= ";
+	default: return nullptr;
+	}
+}
+
+void FlatAST::unparse(Writer& out) const {
+	if (size() == 0){ return; }
+	UnparseStack<NodeID> unparser(out);
+	unparser.run(root(), 0,
+		[this](UnparseStack<NodeID>& u, NodeID n, int indent){
+		unparseStep(u, n, indent);
+	});
+}
+
+/*
+Mirrors the per-class methods in unparse.cpp case by case, including
+their indentation quirks, so that the two forms print the same text.
+*/
+void FlatAST::unparseStep(UnparseStack<NodeID>& out, NodeID n,
+	int indent) const {
+	uint32_t count = kidCount(n);
+	switch (kind(n)){
+	case FlatKind::Program:
+		for (uint32_t i = 0; i < count; i++){
+			out.child(kid(n, i), indent);
+		}
+		return;
+	case FlatKind::VarDecl:
+		doIndent(out, indent);
+		out.child(kid(n, 0), 0);
+		out << " ";
+		out.child(kid(n, 1), 0);
+		out << ";\n";
+		return;
+	case FlatKind::FormalDecl:
+		doIndent(out, indent);
+		out.child(kid(n, 0), 0);
+		out << " ";
+		out.child(kid(n, 1), 0);
+		return;
+	case FlatKind::FnDecl:
+		doIndent(out, indent);
+		out.child(kid(n, 0), 0);
+		out << " ";
+		out.child(kid(n, 1), 0);
+		out << "(";
+		out.child(kid(n, 2), 0);
+		out << ")";
+		out.child(kid(n, 3), 0);
+		return;
+	case FlatKind::FormalsList:
+		doIndent(out, indent);
+		for (uint32_t i = 0; i < count; i++){
+			if (i != 0){ out << ","; }
+			out.child(kid(n, i), indent+1);
+		}
+		return;
+	case FlatKind::FnBody:
+		doIndent(out, indent);
+		out << "{\n";
+		out.child(kid(n, 0), indent+4);
+		out << "}\n";
+		return;
+	case FlatKind::StmtList:
+		doIndent(out, indent);
+		for (uint32_t i = 0; i < count; i++){
+			out.child(kid(n, i), indent+1);
+		}
+		return;
+	case FlatKind::IntType: out << "int"; return;
+	case FlatKind::BoolType: out << "bool"; return;
+	case FlatKind::CharType: out << "char"; return;
+	case FlatKind::VoidType: out << "void"; return;
+	case FlatKind::IntPtrType: out << "intptr"; return;
+	case FlatKind::BoolPtrType: out << "boolptr"; return;
+	case FlatKind::CharPtrType: out << "charptr"; return;
+	case FlatKind::AssignStmt:
+	case FlatKind::CallStmt:
+		doIndent(out, indent);
+		out.child(kid(n, 0), 0);
+		out << ";\n";
+		return;
+	case FlatKind::FromConsole:
+		doIndent(out, indent);
+		out << "FROMCONSOLE ";
+		out.child(kid(n, 0), 0);
+		out << ";\n";
+		return;
+	case FlatKind::ToConsole:
+		doIndent(out, indent);
+		out << "TOCONSOLE ";
+		out.child(kid(n, 0), 0);
+		out << ";\n";
+		return;
+	case FlatKind::PostInc:
+	case FlatKind::PostDec:
+		doIndent(out, indent);
+		out.child(kid(n, 0), 0);
+		out << (kind(n) == FlatKind::PostInc ? "++;\n" : "--;\n");
+		return;
+	case FlatKind::If:
+	case FlatKind::IfElse:
+	case FlatKind::While:
+		doIndent(out, indent);
+		out << (kind(n) == FlatKind::While ? "while (" : "if (");
+		out.child(kid(n, 0), 0);
+		out << ") {\n";
+		for (uint32_t b = 1; b < count; b++){
+			NodeID body = kid(n, b);
+			if (b > 1){
+				doIndent(out, indent);
+				out << "} else {\n";
+			}
+			for (uint32_t i = 0; i < kidCount(body); i++){
+				out.child(kid(body, i), indent+1);
+			}
+		}
+		doIndent(out, indent);
+		out << "}\n";
+		return;
+	case FlatKind::Return:
+		doIndent(out, indent);
+		out << "return ";
+		if (count > 0){ out.child(kid(n, 0), 0); }
+		out << ";\n";
+		return;
+	case FlatKind::Assign:
+		doIndent(out, indent);
+		out.child(kid(n, 0), 0);
+		out << " = ";
+		out.child(kid(n, 1), 0);
+		return;
+	case FlatKind::Call:
+		doIndent(out, indent);
+		out.child(kid(n, 0), 0);
+		out << "(";
+		for (uint32_t i = 1; i < count; i++){
+			if (i != 1){ out << ","; }
+			out.child(kid(n, i), indent+1);
+		}
+		out << ")";
+		return;
+	case FlatKind::Neg:
+	case FlatKind::Not:
+		doIndent(out, indent);
+		out << "(";
+		out << (kind(n) == FlatKind::Neg ? "-" : "!");
+		out.child(kid(n, 0), 0);
+		out << ")";
+		return;
+	case FlatKind::ID:
+		out << Interner::spelling(symbol(n));
+		return;
+	case FlatKind::IntLit:
+		doIndent(out, indent);
+		out << static_cast<int>(payload(n));
+		return;
+	case FlatKind::CharLit:
+		doIndent(out, indent);
+		out << static_cast<char>(payload(n));
+		return;
+	case FlatKind::StrLit:
+		doIndent(out, indent);
+		out << string(payload(n));
+		return;
+	case FlatKind::True:
+		doIndent(out, indent);
+		out << "true";
+		return;
+	case FlatKind::False:
+		doIndent(out, indent);
+		out << "false";
+		return;
+	case FlatKind::NullPtr:
+		out << "NULLPTR";
+		return;
+	case FlatKind::Deref:
+	case FlatKind::Ref:
+		doIndent(out, indent);
+		out << (kind(n) == FlatKind::Deref ? "@" : "^");
+		out.child(kid(n, 0), 0);
+		return;
+	case FlatKind::Index:
+		doIndent(out, indent);
+		out.child(kid(n, 0), 0);
+		out << "[";
+		out.child(kid(n, 1), 0);
+		out << "]";
+		return;
+	default:
+		doIndent(out, indent);
+		out << "(";
+		out.child(kid(n, 0), 0);
+		out << binaryOp(kind(n));
+		out.child(kid(n, 1), 0);
+		out << ")";
+		return;
+	}
+}
+
+/*
+Image layout, all 32-bit words unless noted:
+
+	header      magic, version, nodes, kids, strings, names,
+	            big positions, text bytes
+	positions   [nodes]
+	first kids  [nodes]
+	kid counts  [nodes]
+	payloads    [nodes]   (an ID's payload is its index in names)
+	kids        [kids]
+	strings     [strings] x (offset, length) into text
+	names       [names]   x (offset, length) into text
+	big         [big positions] x (node, line, column)
+	kinds       [nodes] bytes
+	text        [text bytes]
+*/
+static const uint32_t IMAGE_MAGIC = 0x54414C46; // "FLAT"
+static const uint32_t IMAGE_VERSION = 1;
+static const size_t HEADER_WORDS = 8;
+
+static void putWords(std::ostream& out, const uint32_t * words, size_t count){
+	out.write(reinterpret_cast<const char *>(words),
+		static_cast<std::streamsize>(count * sizeof(uint32_t)));
+}
+
+void FlatAST::serialize(std::ostream& out) const {
+	std::string text;
+	std::vector<uint32_t> stringRefs;
+	for (const StrRef& str : myStrings){
+		stringRefs.push_back(static_cast<uint32_t>(text.size()));
+		stringRefs.push_back(static_cast<uint32_t>(str.size()));
+		text.append(str.data(), str.size());
+	}
+
+	std::unordered_map<Symbol, uint32_t> nameIndex;
+	std::vector<uint32_t> nameRefs;
+	std::vector<uint32_t> payloads(myPayloadView, myPayloadView + mySize);
+	for (size_t n = 0; n < mySize; n++){
+		if (myKindView[n] != FlatKind::ID){ continue; }
+		Symbol sym = symbol(static_cast<NodeID>(n));
+		auto found = nameIndex.emplace(sym,
+			static_cast<uint32_t>(nameRefs.size() / 2));
+		if (found.second){
+			StrRef name = Interner::spelling(sym);
+			nameRefs.push_back(static_cast<uint32_t>(text.size()));
+			nameRefs.push_back(static_cast<uint32_t>(name.size()));
+			text.append(name.data(), name.size());
+		}
+		payloads[n] = found.first->second;
+	}
+
+	std::vector<uint32_t> big;
+	for (const auto& entry : myBigPositions){
+		big.push_back(entry.first);
+		big.push_back(static_cast<uint32_t>(entry.second.first));
+		big.push_back(static_cast<uint32_t>(entry.second.second));
+	}
+
+	uint32_t header[HEADER_WORDS] = {
+		IMAGE_MAGIC, IMAGE_VERSION,
+		static_cast<uint32_t>(mySize), static_cast<uint32_t>(myKidTotal),
+		static_cast<uint32_t>(myStrings.size()),
+		static_cast<uint32_t>(nameRefs.size() / 2),
+		static_cast<uint32_t>(big.size() / 3),
+		static_cast<uint32_t>(text.size()),
+	};
+	putWords(out, header, HEADER_WORDS);
+	putWords(out, myPositionView, mySize);
+	putWords(out, myFirstKidView, mySize);
+	putWords(out, myKidCountView, mySize);
+	putWords(out, payloads.data(), mySize);
+	putWords(out, myKidView, myKidTotal);
+	putWords(out, stringRefs.data(), stringRefs.size());
+	putWords(out, nameRefs.data(), nameRefs.size());
+	putWords(out, big.data(), big.size());
+	out.write(reinterpret_cast<const char *>(myKindView),
+		static_cast<std::streamsize>(mySize));
+	out.write(text.data(), static_cast<std::streamsize>(text.size()));
+}
+
+bool FlatAST::attach(const char * data, size_t size){
+	*this = FlatAST();
+	if (reinterpret_cast<uintptr_t>(data) % sizeof(uint32_t) != 0
+		|| size < HEADER_WORDS * sizeof(uint32_t)){
+		return false;
+	}
+	const uint32_t * words = reinterpret_cast<const uint32_t *>(data);
+	if (words[0] != IMAGE_MAGIC || words[1] != IMAGE_VERSION){
+		return false;
+	}
+	size_t nodes = words[2], kids = words[3], strings = words[4];
+	size_t names = words[5], big = words[6], textBytes = words[7];
+	size_t wordCount = HEADER_WORDS + 4 * nodes + kids
+		+ 2 * strings + 2 * names + 3 * big;
+	if (size != wordCount * sizeof(uint32_t) + nodes + textBytes){
+		return false;
+	}
+
+	const uint32_t * at = words + HEADER_WORDS;
+	myPositionView = at; at += nodes;
+	myFirstKidView = at; at += nodes;
+	myKidCountView = at; at += nodes;
+	myPayloadView = at; at += nodes;
+	myKidView = at; at += kids;
+	const uint32_t * stringRefs = at; at += 2 * strings;
+	const uint32_t * nameRefs = at; at += 2 * names;
+	const uint32_t * bigRefs = at; at += 3 * big;
+	myKindView = reinterpret_cast<const FlatKind *>(at);
+	const char * text = reinterpret_cast<const char *>(at) + nodes;
+	mySize = nodes;
+	myKidTotal = kids;
+	myImageBytes = size;
+	myAttached = true;
+
+	for (size_t i = 0; i < strings + names; i++){
+		const uint32_t * ref = i < strings
+			? stringRefs + 2 * i : nameRefs + 2 * (i - strings);
+		if (ref[0] > textBytes || ref[1] > textBytes - ref[0]){
+			*this = FlatAST();
+			return false;
+		}
+		StrRef str(text + ref[0], ref[1]);
+		if (i < strings){
+			myStrings.push_back(str);
+		} else {
+			mySymbols.push_back(Interner::intern(str));
+		}
+	}
+	for (size_t i = 0; i < big; i++){
+		myBigPositions[bigRefs[3 * i]] =
+			std::make_pair(bigRefs[3 * i + 1], bigRefs[3 * i + 2]);
+	}
+	if (!validate()){
+		*this = FlatAST();
+		return false;
+	}
+	return true;
+}
+
+/*
+An attached image is trusted by every reader, so check that it is a
+well-formed tree: known kinds, children in range and earlier than
+their parent (which also rules out cycles), the child counts each
+kind's readers rely on, and payloads that index real tables.
+*/
+bool FlatAST::validate() const {
+	if (mySize == 0 || kind(root()) != FlatKind::Program){ return false; }
+	for (NodeID n = 0; n < mySize; n++){
+		if (static_cast<uint8_t>(myKindView[n])
+			> static_cast<uint8_t>(FlatKind::Index)){
+			return false;
+		}
+		uint32_t first = myFirstKidView[n];
+		uint32_t count = myKidCountView[n];
+		if (first > myKidTotal || count > myKidTotal - first){ return false; }
+		for (uint32_t i = 0; i < count; i++){
+			if (kid(n, i) >= n){ return false; }
+		}
+		if (myPositionView[n] == POS_OVERFLOW
+			&& myBigPositions.count(n) == 0){
+			return false;
+		}
+		uint32_t want = 0;
+		switch (kind(n)){
+		case FlatKind::Program:
+			if (n != root()){ return false; }
+			continue;
+		case FlatKind::FormalsList:
+		case FlatKind::StmtList:
+			continue;
+		case FlatKind::Call:
+			if (count < 1){ return false; }
+			continue;
+		case FlatKind::Return:
+			if (count > 1){ return false; }
+			continue;
+		case FlatKind::ID:
+			if (payload(n) >= mySymbols.size()){ return false; }
+			break;
+		case FlatKind::StrLit:
+			if (payload(n) >= myStrings.size()){ return false; }
+			break;
+		case FlatKind::FnDecl: want = 4; break;
+		case FlatKind::IfElse: want = 3; break;
+		case FlatKind::VarDecl: case FlatKind::FormalDecl:
+		case FlatKind::If: case FlatKind::While: case FlatKind::Assign:
+		case FlatKind::Index:
+			want = 2;
+			break;
+		case FlatKind::FnBody: case FlatKind::AssignStmt:
+		case FlatKind::CallStmt: case FlatKind::FromConsole:
+		case FlatKind::ToConsole: case FlatKind::PostInc:
+		case FlatKind::PostDec: case FlatKind::Neg: case FlatKind::Not:
+		case FlatKind::Deref: case FlatKind::Ref:
+			want = 1;
+			break;
+		case FlatKind::IntType: case FlatKind::BoolType:
+		case FlatKind::CharType: case FlatKind::VoidType:
+		case FlatKind::IntPtrType: case FlatKind::BoolPtrType:
+		case FlatKind::CharPtrType: case FlatKind::IntLit:
+		case FlatKind::CharLit: case FlatKind::True: case FlatKind::False:
+		case FlatKind::NullPtr:
+			want = 0;
+			break;
+		default:
+			want = 2;
+			break;
+		}
+		if (count != want){ return false; }
+	}
+	return true;
+}
+
+} //End namespace holeyc
@@ -0,0 +1,159 @@
+#ifndef HOLEYC_FLAT_AST_HPP
+#define HOLEYC_FLAT_AST_HPP
+
+#include <cstdint>
+#include <initializer_list>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+#include "strref.hpp"
+#include "symbols.hpp"
+#include "unparser.hpp"
+#include "writer.hpp"
+
+namespace holeyc{
+
+/**
+* Node kinds of the flat AST. Children are listed in the order they
+* are stored:
+*
+*   Program       decls...
+*   VarDecl       type id            FormalDecl  type id
+*   FnDecl        type id FormalsList FnBody
+*   FormalsList   formals...         FnBody      StmtList
+*   StmtList      stmts...
+*   AssignStmt    Assign             CallStmt    Call
+*   FromConsole   lval               ToConsole   exp
+*   PostInc       lval               PostDec     lval
+*   If            cond StmtList      IfElse      cond StmtList StmtList
+*   While         cond StmtList      Return      [exp]
+*   Assign        lval exp           Call        id [args...]
+*   binary ops    lhs rhs            Neg, Not    exp
+*   Deref, Ref    id                 Index       id exp
+*
+* A Call with a single child was written without an argument list.
+* Leaves keep their value in the payload: the Symbol of an ID, the
+* value of an IntLit or CharLit, the string-table index of a StrLit,
+* and 1/0 for the (unused) reference flag of a type.
+**/
+enum class FlatKind : uint8_t{
+	Program, VarDecl, FnDecl, FormalDecl, FormalsList, FnBody, StmtList,
+	IntType, BoolType, CharType, VoidType, IntPtrType, BoolPtrType,
+	CharPtrType,
+	AssignStmt, CallStmt, FromConsole, ToConsole, PostInc, PostDec,
+	If, IfElse, While, Return,
+	Assign, Call, Plus, Minus, Times, Divide, And, Or, Equals, NotEquals,
+	Less, Greater, LessEq, GreaterEq, Neg, Not,
+	ID, IntLit, CharLit, StrLit, True, False, NullPtr, Deref, Ref, Index,
+};
+
+/**
+* \class FlatAST
+* Compact, pointer-free form of a ProgramNode tree. Nodes are 32-bit
+* indices into parallel arrays (kind, packed position, child range,
+* payload); each node's children sit contiguously in one shared array.
+* Nodes are stored in post-order, so the program is the last node.
+*
+* A FlatAST is either built with add() or attached to a serialized
+* image (see serialize()), whose arrays it then reads in place.
+**/
+class FlatAST{
+public:
+	using NodeID = uint32_t;
+
+	FlatAST();
+	FlatAST(const FlatAST&) = delete;
+	FlatAST& operator=(const FlatAST&) = delete;
+	FlatAST(FlatAST&&) = default;
+	FlatAST& operator=(FlatAST&&) = default;
+
+	NodeID add(FlatKind kind, size_t line, size_t col, uint32_t payload,
+		const NodeID * kids, size_t kidCount);
+	NodeID add(FlatKind kind, size_t line, size_t col, uint32_t payload,
+		std::initializer_list<NodeID> kids){
+		return add(kind, line, col, payload, kids.begin(), kids.size());
+	}
+	uint32_t addString(StrRef text){
+		myStrings.push_back(text);
+		return static_cast<uint32_t>(myStrings.size() - 1);
+	}
+
+	size_t size() const { return mySize; }
+	NodeID root() const { return static_cast<NodeID>(size() - 1); }
+
+	FlatKind kind(NodeID n) const { return myKindView[n]; }
+	size_t line(NodeID n) const;
+	size_t col(NodeID n) const;
+	uint32_t payload(NodeID n) const { return myPayloadView[n]; }
+	uint32_t kidCount(NodeID n) const { return myKidCountView[n]; }
+	NodeID kid(NodeID n, uint32_t i) const {
+		return myKidView[myFirstKidView[n] + i];
+	}
+	StrRef string(uint32_t index) const { return myStrings[index]; }
+	/** The identifier an ID node names **/
+	Symbol symbol(NodeID n) const {
+		return myAttached ? mySymbols[payload(n)] : payload(n);
+	}
+
+	/** Bytes held by the arrays (capacity, not just size) **/
+	size_t bytes() const;
+
+	/** Same output as ProgramNode::unparse on the source tree **/
+	void unparse(Writer& out) const;
+
+	/**
+	* Write a position-independent image of this AST. Every array
+	* starts on a 4-byte boundary relative to the image's start, and
+	* identifiers are stored as spellings, not process-local Symbols.
+	**/
+	void serialize(std::ostream& out) const;
+
+	/**
+	* Read an image written by serialize() in place. The bytes must
+	* be 4-byte aligned and outlive this FlatAST. Returns false,
+	* leaving this FlatAST empty, if the image is damaged.
+	**/
+	bool attach(const char * data, size_t size);
+
+private:
+	void unparseStep(UnparseStack<NodeID>& out, NodeID n, int indent) const;
+	void syncViews();
+	bool validate() const;
+
+	/*
+	Positions are packed as line << COL_BITS | col. The rare
+	position that does not fit is kept in a side table under the
+	POS_OVERFLOW marker, so conversion stays lossless.
+	*/
+	static const unsigned COL_BITS = 10;
+	static const uint32_t POS_OVERFLOW = 0xFFFFFFFF;
+
+	/* Storage while building; unused when attached */
+	std::vector<FlatKind> myKinds;
+	std::vector<uint32_t> myPositions;
+	std::vector<uint32_t> myFirstKids;
+	std::vector<uint32_t> myKidCounts;
+	std::vector<uint32_t> myPayloads;
+	std::vector<NodeID> myKids;
+
+	/* What the accessors read: the vectors above, or an image */
+	size_t mySize;
+	size_t myKidTotal;
+	const FlatKind * myKindView;
+	const uint32_t * myPositionView;
+	const uint32_t * myFirstKidView;
+	const uint32_t * myKidCountView;
+	const uint32_t * myPayloadView;
+	const NodeID * myKidView;
+	size_t myImageBytes;
+	bool myAttached;
+
+	std::vector<StrRef> myStrings;
+	/** For an attached image, the Symbol of each stored spelling **/
+	std::vector<Symbol> mySymbols;
+	std::unordered_map<NodeID, std::pair<size_t, size_t>> myBigPositions;
+};
+
+} //End namespace holeyc
+
+#endif
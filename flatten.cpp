@@ -0,0 +1,283 @@
+#include <vector>
+#include "errors.hpp"
+#include "visitor.hpp"
+
+namespace holeyc{
+
+using NodeID = FlatAST::NodeID;
+
+/**
+* \class Flattener
+* Explicit work stack for ASTNode::flatten, so that a tree of any
+* depth flattens without deep native recursion. ScheduleKids
+* schedules a node's children in order; once each child's subtree is
+* in the FlatAST, AddNode adds the node itself, given the children's
+* indices. Nodes are thus added in the same post-order as a recursive
+* walk would add them.
+**/
+class Flattener{
+public:
+	Flattener(FlatAST& flat, const LineTable& lines)
+	: myFlat(flat), myLines(lines), myLine(0){ }
+
+	NodeID run(ASTNode * root){
+		myStack.push_back(Frame{root, nullptr, false, 0});
+		while (!myStack.empty()){
+			Frame& top = myStack.back();
+			if (!top.expanded){
+				top.expanded = true;
+				top.base = myResults.size();
+				if (top.node != nullptr){
+					scheduleKids(top.node);
+				} else {
+					for (auto stmt : *top.stmts){ child(stmt); }
+				}
+				/* Reversed, so the first child is on top */
+				myStack.insert(myStack.end(),
+					myPending.rbegin(), myPending.rend());
+				myPending.clear();
+				continue;
+			}
+			Frame done = top;
+			myStack.pop_back();
+			const NodeID * kids = myResults.data() + done.base;
+			size_t count = myResults.size() - done.base;
+			NodeID id = done.node != nullptr
+				? addNode(done.node, kids, count)
+				: myFlat.add(FlatKind::StmtList, 0, 0, 0, kids, count);
+			myResults.resize(done.base);
+			myResults.push_back(id);
+		}
+		return myResults.back();
+	}
+
+	void child(ASTNode * node){
+		myPending.push_back(Frame{node, nullptr, false, 0});
+	}
+	/** A bare statement list (an if or while body), as a StmtList **/
+	void child(NodeList<StmtNode *> * stmts){
+		myPending.push_back(Frame{nullptr, stmts, false, 0});
+	}
+
+private:
+	void scheduleKids(ASTNode * node);
+	NodeID addNode(ASTNode * node, const NodeID * kids, size_t count);
+
+	struct Frame{
+		ASTNode * node;
+		NodeList<StmtNode *> * stmts; /// When node is nullptr
+		bool expanded; /// Its children have been scheduled
+		size_t base;   /// Where its children's indices start in myResults
+	};
+
+	FlatAST& myFlat;
+	const LineTable& myLines;
+	/** Line of the last node added; the next is usually near it **/
+	size_t myLine;
+	std::vector<Frame> myStack;
+	std::vector<Frame> myPending;
+	/** Indices of finished subtrees not yet claimed by their parent **/
+	std::vector<NodeID> myResults;
+};
+
+NodeID ASTNode::flatten(FlatAST& flat, const LineTable& lines){
+	return Flattener(flat, lines).run(this);
+}
+
+/*
+Like unparse.cpp, the code is grouped here by purpose rather than
+by class: one visitor finds each kind of node's children, another
+adds each kind of node to the FlatAST.
+*/
+
+/** Schedules a node's children on the Flattener; leaves have none **/
+class ScheduleKids : public ASTVisitor<ScheduleKids>{
+public:
+	explicit ScheduleKids(Flattener& f) : myF(f){ }
+
+	void visitProgram(ProgramNode * node){
+		for (auto global : *node->globals()){ myF.child(global); }
+	}
+	//DeclNode (and FormalDeclNode, by way of visitVarDecl)
+	void visitVarDecl(VarDeclNode * node){
+		myF.child(node->type());
+		myF.child(node->id());
+	}
+	void visitFnDecl(FnDeclNode * node){
+		myF.child(node->retType());
+		myF.child(node->id());
+		myF.child(node->formals());
+		myF.child(node->body());
+	}
+	void visitFormalsList(FormalsListNode * node){
+		for (auto formal : *node->formals()){ myF.child(formal); }
+	}
+	void visitFnBody(FnBodyNode * node){
+		myF.child(node->stmts());
+	}
+	void visitStmtList(StmtListNode * node){
+		for (auto stmt : *node->stmts()){ myF.child(stmt); }
+	}
+
+	//StmtNode
+	void visitAssignStmt(AssignStmtNode * node){ myF.child(node->assign()); }
+	void visitCallStmt(CallStmtNode * node){ myF.child(node->callExp()); }
+	void visitFromConsole(FromConsoleStmtNode * node){
+		myF.child(node->val());
+	}
+	void visitToConsole(ToConsoleStmtNode * node){ myF.child(node->exp()); }
+	void visitPostInc(PostIncStmtNode * node){ myF.child(node->exp()); }
+	void visitPostDec(PostDecStmtNode * node){ myF.child(node->exp()); }
+	void visitIf(IfStmtNode * node){
+		myF.child(node->exp());
+		myF.child(node->stmts());
+	}
+	void visitIfElse(IfElseStmtNode * node){
+		myF.child(node->exp());
+		myF.child(node->stmtsT());
+		myF.child(node->stmtsF());
+	}
+	void visitWhile(WhileStmtNode * node){
+		myF.child(node->exp());
+		myF.child(node->stmts());
+	}
+	void visitReturn(ReturnStmtNode * node){
+		if (node->exp() != nullptr){ myF.child(node->exp()); }
+	}
+
+	//ExpNode
+	void visitAssignExp(AssignExpNode * node){
+		myF.child(node->tgt());
+		myF.child(node->src());
+	}
+	void visitBinaryExp(BinaryExpNode * node){
+		myF.child(node->lhs());
+		myF.child(node->rhs());
+	}
+	void visitCallExp(CallExpNode * node){
+		myF.child(node->id());
+		if (node->args() != nullptr){
+			for (auto arg : *node->args()){ myF.child(arg); }
+		}
+	}
+	void visitUnaryExp(UnaryExpNode * node){ myF.child(node->exp()); }
+	void visitDeref(DerefNode * node){ myF.child(node->tgt()); }
+	void visitRef(RefNode * node){ myF.child(node->tgt()); }
+	void visitIndex(IndexNode * node){
+		myF.child(node->tgt());
+		myF.child(node->off());
+	}
+
+private:
+	Flattener& myF;
+};
+
+void Flattener::scheduleKids(ASTNode * node){
+	ScheduleKids(*this).visit(node);
+}
+
+/* The flat kind of every node; the payload is added separately */
+static FlatKind flatKind(NodeKind kind){
+	switch (kind){
+	case NodeKind::Program: return FlatKind::Program;
+	case NodeKind::VarDecl: return FlatKind::VarDecl;
+	case NodeKind::FormalDecl: return FlatKind::FormalDecl;
+	case NodeKind::FnDecl: return FlatKind::FnDecl;
+	case NodeKind::FormalsList: return FlatKind::FormalsList;
+	case NodeKind::StmtList: return FlatKind::StmtList;
+	case NodeKind::FnBody: return FlatKind::FnBody;
+	case NodeKind::IntType: return FlatKind::IntType;
+	case NodeKind::BoolType: return FlatKind::BoolType;
+	case NodeKind::CharType: return FlatKind::CharType;
+	case NodeKind::VoidType: return FlatKind::VoidType;
+	case NodeKind::IntPtr: return FlatKind::IntPtrType;
+	case NodeKind::BoolPtr: return FlatKind::BoolPtrType;
+	case NodeKind::CharPtr: return FlatKind::CharPtrType;
+	case NodeKind::AssignStmt: return FlatKind::AssignStmt;
+	case NodeKind::CallStmt: return FlatKind::CallStmt;
+	case NodeKind::FromConsole: return FlatKind::FromConsole;
+	case NodeKind::ToConsole: return FlatKind::ToConsole;
+	case NodeKind::PostInc: return FlatKind::PostInc;
+	case NodeKind::PostDec: return FlatKind::PostDec;
+	case NodeKind::If: return FlatKind::If;
+	case NodeKind::IfElse: return FlatKind::IfElse;
+	case NodeKind::While: return FlatKind::While;
+	case NodeKind::Return: return FlatKind::Return;
+	case NodeKind::AssignExp: return FlatKind::Assign;
+	case NodeKind::CallExp: return FlatKind::Call;
+	case NodeKind::Plus: return FlatKind::Plus;
+	case NodeKind::Minus: return FlatKind::Minus;
+	case NodeKind::Times: return FlatKind::Times;
+	case NodeKind::Divide: return FlatKind::Divide;
+	case NodeKind::And: return FlatKind::And;
+	case NodeKind::Or: return FlatKind::Or;
+	case NodeKind::Equals: return FlatKind::Equals;
+	case NodeKind::NotEquals: return FlatKind::NotEquals;
+	case NodeKind::Less: return FlatKind::Less;
+	case NodeKind::Greater: return FlatKind::Greater;
+	case NodeKind::LessEq: return FlatKind::LessEq;
+	case NodeKind::GreaterEq: return FlatKind::GreaterEq;
+	case NodeKind::Neg: return FlatKind::Neg;
+	case NodeKind::Not: return FlatKind::Not;
+	case NodeKind::ID: return FlatKind::ID;
+	case NodeKind::IntLit: return FlatKind::IntLit;
+	case NodeKind::CharLit: return FlatKind::CharLit;
+	case NodeKind::StrLit: return FlatKind::StrLit;
+	case NodeKind::True: return FlatKind::True;
+	case NodeKind::False: return FlatKind::False;
+	case NodeKind::NullPtr: return FlatKind::NullPtr;
+	case NodeKind::Deref: return FlatKind::Deref;
+	case NodeKind::Ref: return FlatKind::Ref;
+	case NodeKind::Index: return FlatKind::Index;
+	}
+	throw new InternalError("unknown node kind");
+}
+
+/** Adds one node, its children being at kids; returns its index **/
+class AddNode : public ASTVisitor<AddNode, NodeID>{
+public:
+	AddNode(FlatAST& flat, const LineTable& lines, size_t& line,
+		const NodeID * kids, size_t count)
+	: myFlat(flat), myLines(lines), myLine(line), myKids(kids),
+	  myCount(count){ }
+
+	/* Only leaves carry a payload */
+	NodeID visitID(IDNode * node){ return add(node, node->symbol()); }
+	NodeID visitIntLit(IntLitNode * node){
+		return add(node, static_cast<uint32_t>(node->num()));
+	}
+	NodeID visitCharLit(CharLitNode * node){
+		return add(node, static_cast<unsigned char>(node->val()));
+	}
+	NodeID visitStrLit(StrLitNode * node){
+		return add(node, myFlat.addString(node->str()));
+	}
+	NodeID visitType(TypeNode * node){
+		return add(node, node->isReference());
+	}
+	NodeID visitNode(ASTNode * node){ return add(node, 0); }
+
+private:
+	NodeID add(ASTNode * node, uint32_t payload){
+		size_t line = myLine;
+		size_t col;
+		myLines.locateNear(node->pos(), line, col);
+		/* Lists have no position; keep the hint for their neighbours */
+		if (line != 0){ myLine = line; }
+		return myFlat.add(flatKind(node->kind()), line, col, payload,
+			myKids, myCount);
+	}
+
+	FlatAST& myFlat;
+	const LineTable& myLines;
+	size_t& myLine;
+	const NodeID * myKids;
+	size_t myCount;
+};
+
+NodeID Flattener::addNode(ASTNode * node, const NodeID * kids,
+	size_t count){
+	return AddNode(myFlat, myLines, myLine, kids, count).visit(node);
+}
+
+} // End namespace holeyc
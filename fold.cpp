@@ -0,0 +1,447 @@
+#include <climits>
+#include "fold.hpp"
+#include "visitor.hpp"
+
+namespace holeyc{
+
+static const DataType * const INT = DataType::of(TypeCode::Int);
+static const DataType * const BOOL = DataType::of(TypeCode::Bool);
+
+static bool intValue(ExpNode * exp, int& val){
+	if (exp->kind() != NodeKind::IntLit){ return false; }
+	val = static_cast<IntLitNode *>(exp)->num();
+	return true;
+}
+
+static bool boolValue(ExpNode * exp, bool& val){
+	if (exp->kind() != NodeKind::True && exp->kind() != NodeKind::False){
+		return false;
+	}
+	val = exp->kind() == NodeKind::True;
+	return true;
+}
+
+/* int arithmetic is done on the bits, where it wraps around, and
+   the result read back as two's complement */
+static uint32_t bits(int val){ return static_cast<uint32_t>(val); }
+static int wrap(uint32_t val){
+	return val <= INT_MAX ? static_cast<int>(val)
+		: -static_cast<int>(~val) - 1;
+}
+
+/* Whether a and b are both literals, and if so whether they are equal */
+static bool compareLiterals(ExpNode * a, ExpNode * b, bool& equal){
+	int x, y;
+	bool p, q;
+	if (intValue(a, x) && intValue(b, y)){
+		equal = x == y;
+	} else if (boolValue(a, p) && boolValue(b, q)){
+		equal = p == q;
+	} else if (a->kind() == NodeKind::CharLit
+		&& b->kind() == NodeKind::CharLit){
+		equal = static_cast<CharLitNode *>(a)->val()
+			== static_cast<CharLitNode *>(b)->val();
+	} else if (a->kind() == NodeKind::NullPtr
+		&& b->kind() == NodeKind::NullPtr){
+		equal = true;
+	} else {
+		return false;
+	}
+	return true;
+}
+
+/* Whether a block declares anything in its own scope */
+static bool declares(NodeList<StmtNode *> * stmts){
+	for (StmtNode * stmt : *stmts){
+		if (stmt->kind() == NodeKind::VarDecl){ return true; }
+	}
+	return false;
+}
+
+/* The expressions below an expression whose folded forms it needs */
+class ConstantFold::Children : public ASTVisitor<Children>{
+public:
+	explicit Children(std::vector<ExpNode *>& out) : myOut(out){ }
+
+	void visitAssignExp(AssignExpNode * node){
+		myOut.push_back(node->tgt());
+		myOut.push_back(node->src());
+	}
+	void visitCallExp(CallExpNode * node){
+		if (node->args() == nullptr){ return; }
+		for (auto arg : *node->args()){ myOut.push_back(arg); }
+	}
+	void visitBinaryExp(BinaryExpNode * node){
+		myOut.push_back(node->lhs());
+		myOut.push_back(node->rhs());
+	}
+	void visitUnaryExp(UnaryExpNode * node){ myOut.push_back(node->exp()); }
+	void visitIndex(IndexNode * node){ myOut.push_back(node->off()); }
+
+private:
+	std::vector<ExpNode *>& myOut;
+};
+
+/*
+Each visit takes the folded children of its node off the results
+stack, puts them in the node and returns what the node folds to.
+*/
+class ConstantFold::Rules : public ASTVisitor<Rules, Folded>{
+public:
+	explicit Rules(ConstantFold& pass) : myPass(pass){ }
+
+	Folded visitAssignExp(AssignExpNode * node){
+		node->setSrc(pop().exp);
+		pop(); /* The target, which folds to itself */
+		return Folded{node, false};
+	}
+	Folded visitCallExp(CallExpNode * node){
+		if (node->args() != nullptr){
+			for (auto arg = node->args()->rbegin();
+				arg != node->args()->rend(); ++arg){
+				*arg = pop().exp;
+			}
+		}
+		return Folded{node, false};
+	}
+	/* Loads may trap on a null pointer, so they must still run */
+	Folded visitIndex(IndexNode * node){
+		node->setOff(pop().exp);
+		return Folded{node, false};
+	}
+	Folded visitDeref(DerefNode * node){ return Folded{node, false}; }
+
+	Folded visitPlus(PlusNode * node){
+		Folded lhs, rhs;
+		operands(node, lhs, rhs);
+		int a, b;
+		bool litA = intValue(lhs.exp, a), litB = intValue(rhs.exp, b);
+		if (litA && litB){ return num(node, wrap(bits(a) + bits(b))); }
+		if (litA && a == 0){ return rhs; }
+		if (litB && b == 0){ return lhs; }
+		return Folded{node, lhs.pure && rhs.pure};
+	}
+	Folded visitMinus(MinusNode * node){
+		Folded lhs, rhs;
+		operands(node, lhs, rhs);
+		int a, b;
+		bool litA = intValue(lhs.exp, a), litB = intValue(rhs.exp, b);
+		if (litA && litB){ return num(node, wrap(bits(a) - bits(b))); }
+		if (litB && b == 0){ return lhs; }
+		return Folded{node, lhs.pure && rhs.pure};
+	}
+	Folded visitTimes(TimesNode * node){
+		Folded lhs, rhs;
+		operands(node, lhs, rhs);
+		int a, b;
+		bool litA = intValue(lhs.exp, a), litB = intValue(rhs.exp, b);
+		if (litA && litB){ return num(node, wrap(bits(a) * bits(b))); }
+		if (litA && a == 1){ return rhs; }
+		if (litB && b == 1){ return lhs; }
+		if (litA && a == 0 && rhs.pure){ return lhs; }
+		if (litB && b == 0 && lhs.pure){ return rhs; }
+		return Folded{node, lhs.pure && rhs.pure};
+	}
+	Folded visitDivide(DivideNode * node){
+		Folded lhs, rhs;
+		operands(node, lhs, rhs);
+		int a, b;
+		bool litA = intValue(lhs.exp, a), litB = intValue(rhs.exp, b);
+		if (litA && litB && b != 0){
+			return num(node, a == INT_MIN && b == -1 ? INT_MIN : a / b);
+		}
+		if (litB && b == 1){ return lhs; }
+		/* Any other divisor may be 0, so the division must still run */
+		return Folded{node, lhs.pure && litB && b != 0};
+	}
+
+	/* The rhs of && and || only runs when the lhs does not decide */
+	Folded visitAnd(AndNode * node){
+		Folded lhs, rhs;
+		operands(node, lhs, rhs);
+		bool a, b;
+		if (boolValue(lhs.exp, a)){ return a ? rhs : lhs; }
+		if (boolValue(rhs.exp, b)){
+			if (b){ return lhs; }
+			if (lhs.pure){ return rhs; }
+		}
+		return Folded{node, lhs.pure && rhs.pure};
+	}
+	Folded visitOr(OrNode * node){
+		Folded lhs, rhs;
+		operands(node, lhs, rhs);
+		bool a, b;
+		if (boolValue(lhs.exp, a)){ return a ? lhs : rhs; }
+		if (boolValue(rhs.exp, b)){
+			if (!b){ return lhs; }
+			if (lhs.pure){ return rhs; }
+		}
+		return Folded{node, lhs.pure && rhs.pure};
+	}
+
+	Folded visitEquals(EqualsNode * node){ return equality(node, true); }
+	Folded visitNotEquals(NotEqualsNode * node){
+		return equality(node, false);
+	}
+	Folded visitLess(LessNode * node){
+		return relation(node, [](int a, int b){ return a < b; });
+	}
+	Folded visitGreater(GreaterNode * node){
+		return relation(node, [](int a, int b){ return a > b; });
+	}
+	Folded visitLessEq(LessEqNode * node){
+		return relation(node, [](int a, int b){ return a <= b; });
+	}
+	Folded visitGreaterEq(GreaterEqNode * node){
+		return relation(node, [](int a, int b){ return a >= b; });
+	}
+
+	Folded visitNeg(NegNode * node){
+		Folded exp = pop();
+		node->setExp(exp.exp);
+		int a;
+		if (intValue(exp.exp, a)){ return num(node, wrap(0u - bits(a))); }
+		if (exp.exp->kind() == NodeKind::Neg){
+			return Folded{static_cast<NegNode *>(exp.exp)->exp(), exp.pure};
+		}
+		return Folded{node, exp.pure};
+	}
+	Folded visitNot(NotNode * node){
+		Folded exp = pop();
+		node->setExp(exp.exp);
+		bool a;
+		if (boolValue(exp.exp, a)){ return truth(node, !a); }
+		if (exp.exp->kind() == NodeKind::Not){
+			return Folded{static_cast<NotNode *>(exp.exp)->exp(), exp.pure};
+		}
+		return Folded{node, exp.pure};
+	}
+
+	/* Names, literals and ^x */
+	Folded visitExp(ExpNode * node){ return Folded{node, true}; }
+
+private:
+	Folded pop(){
+		Folded folded = myPass.myResults.back();
+		myPass.myResults.pop_back();
+		return folded;
+	}
+	void operands(BinaryExpNode * node, Folded& lhs, Folded& rhs){
+		rhs = pop();
+		lhs = pop();
+		node->setOperands(lhs.exp, rhs.exp);
+	}
+	Folded num(ExpNode * node, int val){
+		return Folded{myPass.makeInt(node->pos(), val), true};
+	}
+	Folded truth(ExpNode * node, bool val){
+		return Folded{myPass.makeBool(node->pos(), val), true};
+	}
+	Folded equality(BinaryExpNode * node, bool equals){
+		Folded lhs, rhs;
+		operands(node, lhs, rhs);
+		bool equal;
+		if (compareLiterals(lhs.exp, rhs.exp, equal)){
+			return truth(node, equal == equals);
+		}
+		return Folded{node, lhs.pure && rhs.pure};
+	}
+	template <typename Compare>
+	Folded relation(BinaryExpNode * node, Compare compare){
+		Folded lhs, rhs;
+		operands(node, lhs, rhs);
+		int a, b;
+		if (intValue(lhs.exp, a) && intValue(rhs.exp, b)){
+			return truth(node, compare(a, b));
+		}
+		return Folded{node, lhs.pure && rhs.pure};
+	}
+
+	ConstantFold& myPass;
+};
+
+size_t ConstantFold::run(ProgramNode * program){
+	for (auto global : *program->globals()){
+		if (global->kind() == NodeKind::FnDecl){
+			foldBody(static_cast<FnDeclNode *>(global));
+		}
+	}
+	return myRewrites;
+}
+
+void ConstantFold::foldBody(FnDeclNode * fn){
+	Stmts * stmts = fn->body()->stmts()->stmts();
+	myBlocks.push_back(Block{stmts, stmts->begin()});
+	while (!myBlocks.empty()){
+		Block& block = myBlocks.back();
+		if (block.at == block.stmts->end()){
+			myBlocks.pop_back();
+		} else {
+			foldStmt(block);
+		}
+	}
+	/* Expressions are shared only within a function */
+	myShared.clear();
+}
+
+void ConstantFold::foldStmt(Block& block){
+	StmtNode * stmt = *block.at;
+	/* The blocks under the statement, folded once it is done */
+	Stmts * inner[2] = { nullptr, nullptr };
+	/* The block that always runs in place of the statement */
+	Stmts * taken = nullptr;
+	bool cond;
+	switch (stmt->kind()){
+	case NodeKind::AssignStmt:
+		fold(static_cast<AssignStmtNode *>(stmt)->assign());
+		break;
+	case NodeKind::CallStmt:
+		fold(static_cast<CallStmtNode *>(stmt)->callExp());
+		break;
+	case NodeKind::FromConsole:
+		fold(static_cast<FromConsoleStmtNode *>(stmt)->val());
+		break;
+	case NodeKind::ToConsole: {
+		ToConsoleStmtNode * out = static_cast<ToConsoleStmtNode *>(stmt);
+		out->setExp(fold(out->exp()));
+		break;
+	}
+	case NodeKind::PostInc:
+		fold(static_cast<PostIncStmtNode *>(stmt)->exp());
+		break;
+	case NodeKind::PostDec:
+		fold(static_cast<PostDecStmtNode *>(stmt)->exp());
+		break;
+	case NodeKind::Return: {
+		ReturnStmtNode * ret = static_cast<ReturnStmtNode *>(stmt);
+		if (ret->exp() != nullptr){ ret->setExp(fold(ret->exp())); }
+		break;
+	}
+	case NodeKind::If: {
+		IfStmtNode * ifStmt = static_cast<IfStmtNode *>(stmt);
+		ifStmt->setExp(fold(ifStmt->exp()));
+		if (!boolValue(ifStmt->exp(), cond)){
+			inner[0] = ifStmt->stmts();
+		} else if (!cond){
+			block.at = block.stmts->erase(block.at);
+			myRewrites++;
+			return;
+		} else if (!declares(ifStmt->stmts())){
+			taken = ifStmt->stmts();
+		} else {
+			inner[0] = ifStmt->stmts();
+		}
+		break;
+	}
+	case NodeKind::IfElse: {
+		IfElseStmtNode * ifElse = static_cast<IfElseStmtNode *>(stmt);
+		ifElse->setExp(fold(ifElse->exp()));
+		if (!boolValue(ifElse->exp(), cond)){
+			inner[0] = ifElse->stmtsT();
+			inner[1] = ifElse->stmtsF();
+		} else if (!declares(cond ? ifElse->stmtsT() : ifElse->stmtsF())){
+			taken = cond ? ifElse->stmtsT() : ifElse->stmtsF();
+		} else {
+			/* Keep the branch's scope */
+			inner[0] = cond ? ifElse->stmtsT() : ifElse->stmtsF();
+			*block.at = myArena.make<IfStmtNode>(ifElse->pos(),
+				makeBool(ifElse->exp()->pos(), true), inner[0]);
+			myRewrites++;
+		}
+		break;
+	}
+	case NodeKind::While: {
+		WhileStmtNode * loop = static_cast<WhileStmtNode *>(stmt);
+		loop->setExp(fold(loop->exp()));
+		if (boolValue(loop->exp(), cond) && !cond){
+			block.at = block.stmts->erase(block.at);
+			myRewrites++;
+			return;
+		}
+		inner[0] = loop->stmts();
+		break;
+	}
+	default: /* Declarations */
+		break;
+	}
+	if (taken != nullptr){
+		/* Its statements are folded next, as part of this block */
+		block.at = splice(block.stmts, block.at, taken);
+		myRewrites++;
+		return;
+	}
+	++block.at;
+	/* Last: pushing may move block */
+	for (Stmts * stmts : inner){
+		if (stmts != nullptr){
+			myBlocks.push_back(Block{stmts, stmts->begin()});
+		}
+	}
+}
+
+ConstantFold::Stmts::iterator ConstantFold::splice(Stmts * stmts,
+	Stmts::iterator at, Stmts * body){
+	Stmts::iterator next = stmts->erase(at);
+	if (body->empty()){ return next; }
+	/* Lists from one parse share its arena, so the nodes can just move */
+	if (stmts->get_allocator() == body->get_allocator()){
+		Stmts::iterator first = body->begin();
+		stmts->splice(next, *body);
+		return first;
+	}
+	return stmts->insert(next, body->begin(), body->end());
+}
+
+ExpNode * ConstantFold::fold(ExpNode * exp){
+	Children children(myFrame);
+	Rules rules(*this);
+	myStack.push_back(Item{exp, false});
+	while (!myStack.empty()){
+		Item item = myStack.back();
+		myStack.pop_back();
+		if (item.post){
+			Folded folded = rules.visit(item.node);
+			if (folded.exp != item.node){ myRewrites++; }
+			if (item.node->shared()){ myShared.emplace(item.node, folded); }
+			myResults.push_back(folded);
+			continue;
+		}
+		/* A shared node folds the same wherever it occurs */
+		if (item.node->shared()){
+			auto found = myShared.find(item.node);
+			if (found != myShared.end()){
+				myResults.push_back(found->second);
+				continue;
+			}
+		}
+		myStack.push_back(Item{item.node, true});
+		children.visit(item.node);
+		/* Reversed, so the first child is folded first */
+		for (auto child = myFrame.rbegin(); child != myFrame.rend(); ++child){
+			myStack.push_back(Item{*child, false});
+		}
+		myFrame.clear();
+	}
+	ExpNode * folded = myResults.back().exp;
+	myResults.pop_back();
+	return folded;
+}
+
+ExpNode * ConstantFold::makeInt(SourcePos pos, int num){
+	ExpNode * lit = myArena.make<IntLitNode>(pos, num);
+	lit->setType(INT);
+	return lit;
+}
+
+ExpNode * ConstantFold::makeBool(SourcePos pos, bool val){
+	ExpNode * lit;
+	if (val){
+		lit = myArena.make<TrueNode>(pos);
+	} else {
+		lit = myArena.make<FalseNode>(pos);
+	}
+	lit->setType(BOOL);
+	return lit;
+}
+
+} //End namespace holeyc
@@ -0,0 +1,84 @@
+#ifndef HOLEYC_FOLD_HPP
+#define HOLEYC_FOLD_HPP
+
+#include <unordered_map>
+#include <vector>
+#include "ast.hpp"
+
+namespace holeyc{
+
+/**
+* \class ConstantFold
+* Rewrites a type-checked program in place (-f): operators over
+* literals become literals, identities such as x * 1, x + 0, !!b and
+* true && e become their operand, and if, if-else and while
+* statements whose condition is constant lose the code that can never
+* run. A branch that always runs replaces its statement unless it
+* declares something, which would then leak into the enclosing scope;
+* it stays in an if (true) instead.
+*
+* int arithmetic wraps around in 32-bit two's complement, so
+* -2147483648 / -1 is -2147483648. A division by a literal 0 is left
+* for the program to perform. Operands with side effects (assignments,
+* calls, and what may trap: loads through @p and p[i], and divisions
+* by anything but a nonzero literal) are never dropped, so x * 0
+* folds only when x has none.
+*
+* New nodes are typed like the ones they replace. A node shared
+* under -h is folded once, and every parent gets its folded form.
+* Expressions and nested blocks are walked with explicit stacks, so
+* any depth of nesting is fine.
+**/
+class ConstantFold{
+public:
+	/** arena holds the literals folding makes **/
+	explicit ConstantFold(Arena& arena) : myArena(arena), myRewrites(0){ }
+
+	/** Fold every function body; returns how many nodes were rewritten **/
+	size_t run(ProgramNode * program);
+
+private:
+	class Children;
+	class Rules;
+	/** An expression whose children are to be scheduled, or folded **/
+	struct Item{
+		ExpNode * node;
+		bool post;
+	};
+	/** What an expression folded to, and whether it has no effects **/
+	struct Folded{
+		ExpNode * exp;
+		bool pure;
+	};
+	using Stmts = NodeList<StmtNode *>;
+	/** A statement list being folded, and the next statement in it **/
+	struct Block{
+		Stmts * stmts;
+		Stmts::iterator at;
+	};
+
+	void foldBody(FnDeclNode * fn);
+	/** Fold the statement at block's cursor and move the cursor on **/
+	void foldStmt(Block& block);
+	/** Fold exp's subtree; returns what replaces exp **/
+	ExpNode * fold(ExpNode * exp);
+	/** Put body's statements where at is; returns the first of them **/
+	Stmts::iterator splice(Stmts * stmts, Stmts::iterator at, Stmts * body);
+	ExpNode * makeInt(SourcePos pos, int num);
+	ExpNode * makeBool(SourcePos pos, bool val);
+
+	Arena& myArena;
+	std::vector<Item> myStack;
+	/** What the node being scheduled has for children, in order **/
+	std::vector<ExpNode *> myFrame;
+	/** The folded children of the nodes not yet folded themselves **/
+	std::vector<Folded> myResults;
+	/** Shared nodes folded so far in this function **/
+	std::unordered_map<ExpNode *, Folded> myShared;
+	std::vector<Block> myBlocks;
+	size_t myRewrites;
+};
+
+} //End namespace holeyc
+
+#endif
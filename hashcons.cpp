@@ -0,0 +1,102 @@
+#include "hashcons.hpp"
+#include "visitor.hpp"
+
+namespace holeyc{
+
+/** Fills in a node's Key; nodes left to visitNode cannot be shared **/
+class ExpTable::KeyOf : public ASTVisitor<KeyOf, bool>{
+public:
+	KeyOf(ExpTable& table, Key& key) : myTable(table), myKey(key){ }
+
+	bool visitBinaryExp(BinaryExpNode * node){
+		return set(node, node->lhs(), node->rhs());
+	}
+	bool visitUnaryExp(UnaryExpNode * node){
+		return set(node, node->exp(), nullptr);
+	}
+	bool visitIndex(IndexNode * node){
+		return set(node, node->tgt(), node->off());
+	}
+	bool visitDeref(DerefNode * node){ return set(node, node->tgt(), nullptr); }
+	bool visitRef(RefNode * node){ return set(node, node->tgt(), nullptr); }
+
+	bool visitID(IDNode * node){
+		return value(node, node->symbol(), myTable.generation(node->symbol()));
+	}
+	bool visitIntLit(IntLitNode * node){
+		return value(node, static_cast<uint32_t>(node->num()), 0);
+	}
+	bool visitCharLit(CharLitNode * node){
+		return value(node, static_cast<unsigned char>(node->val()), 0);
+	}
+	bool visitStrLit(StrLitNode * node){
+		auto& strings = myTable.myStrings;
+		auto found = strings.emplace(node->str().str(), strings.size());
+		return value(node, found.first->second, 0);
+	}
+	bool visitTrue(TrueNode * node){ return value(node, 0, 0); }
+	bool visitFalse(FalseNode * node){ return value(node, 0, 0); }
+	bool visitNullPtr(NullPtrNode * node){ return value(node, 0, 0); }
+
+	bool visitNode(ASTNode *){ return false; }
+
+private:
+	/* Only children that are themselves shared tell nodes apart */
+	bool set(ASTNode * node, ASTNode * a, ASTNode * b){
+		if (!a->shared() || (b != nullptr && !b->shared())){ return false; }
+		myKey = Key{node->kind(), reinterpret_cast<uintptr_t>(a),
+			reinterpret_cast<uintptr_t>(b)};
+		return true;
+	}
+	bool value(ASTNode * node, uintptr_t a, uintptr_t b){
+		myKey = Key{node->kind(), a, b};
+		return true;
+	}
+
+	ExpTable& myTable;
+	Key& myKey;
+};
+
+bool ExpTable::keyOf(ExpNode * node, Key& key){
+	return KeyOf(*this, key).visit(node);
+}
+
+ExpNode * ExpTable::find(const Key& key){
+	auto found = myNodes.find(key);
+	if (found == myNodes.end()){ return nullptr; }
+	myReused++;
+	return found->second;
+}
+
+uintptr_t ExpTable::generation(Symbol name){
+	auto found = myGens.find(name);
+	return found == myGens.end() ? 0 : found->second;
+}
+
+void ExpTable::declared(Symbol name){
+	myGens[name] = ++myNextGen;
+	if (!myBlocks.empty()){ myBlocks.back().push_back(name); }
+}
+
+/* Every expression is reduced before the parser asks for the token
+   after it, so scopes change here in step with the nodes built */
+int ExpTable::yylex(holeyc::Parser::semantic_type * const lval){
+	int kind = myInner.next(lval);
+	if (kind == TokenKind::LCURLY){
+		myBlocks.emplace_back();
+	} else if (kind == TokenKind::RCURLY && !myBlocks.empty()){
+		/* Uses after the block mean whatever was declared before it;
+		   a new generation keeps them off the block's nodes */
+		for (Symbol name : myBlocks.back()){ myGens[name] = ++myNextGen; }
+		myBlocks.pop_back();
+		if (myBlocks.empty()){
+			/* The function is over; so are its formals */
+			myNodes.clear();
+			myGens.clear();
+			myStrings.clear();
+		}
+	}
+	return kind;
+}
+
+} //End namespace holeyc
@@ -0,0 +1,109 @@
+#ifndef HOLEYC_HASHCONS_HPP
+#define HOLEYC_HASHCONS_HPP
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "ast.hpp"
+#include "scanner.hpp"
+
+namespace holeyc{
+
+/**
+* \class ExpTable
+* Hash-consing for expressions without side effects (-h): literals,
+* names, arithmetic, logic and comparisons, indexing, @ and ^. The
+* parser asks it for each such node and gets back the node built for
+* an identical expression earlier, if there was one, so a repeated
+* subexpression such as a[i + 1] exists once, shared by every place
+* it occurs (see ASTNode::shared). Calls and assignments are always
+* built fresh, and so is anything above them.
+*
+* It sits between the token source and the parser so it can follow
+* the braces: a name's node is only reused while the same declaration
+* of that name is in scope, and the table is emptied at the end of
+* each function, so it never hands out a node of a declaration that
+* streaming has freed. A shared node keeps the position of its first
+* occurrence.
+**/
+class ExpTable : public TokenSource{
+public:
+	ExpTable(TokenSource& inner, Arena& arena)
+	: TokenSource(inner.lines()), myInner(inner), myArena(arena),
+	  myNextGen(0), myBuilt(0), myReused(0){ }
+
+	int yylex(holeyc::Parser::semantic_type * const lval) override;
+
+	/** name is declared in the innermost block (or at the top level) **/
+	void declared(Symbol name);
+
+	/**
+	* The node T(args...) would be: the shared node of an identical
+	* expression if there is one, else a new node, which is shared in
+	* turn if it is free of side effects and so are its children
+	**/
+	template <typename T, typename... Args>
+	T * make(Args... args){
+		T probe(args...);
+		Key key;
+		if (!keyOf(&probe, key)){ return myArena.make<T>(probe); }
+		ExpNode * found = find(key);
+		if (found != nullptr){ return static_cast<T *>(found); }
+		return add(key, myArena.make<T>(probe));
+	}
+
+	/** Shared nodes made, and the times one was handed out again **/
+	size_t built() const { return myBuilt; }
+	size_t reused() const { return myReused; }
+
+private:
+	/* A node's kind and what tells it apart from others of that kind:
+	   its children, which are shared, or its value */
+	struct Key{
+		NodeKind kind;
+		uintptr_t a;
+		uintptr_t b;
+		bool operator==(const Key& other) const {
+			return kind == other.kind && a == other.a && b == other.b;
+		}
+	};
+	struct KeyHash{
+		size_t operator()(const Key& key) const {
+			size_t h = static_cast<size_t>(key.kind);
+			h = h * 0x9E3779B97F4A7C15ULL + key.a;
+			return h * 0x9E3779B97F4A7C15ULL + key.b;
+		}
+	};
+	class KeyOf;
+
+	/** False if node cannot be shared **/
+	bool keyOf(ExpNode * node, Key& key);
+	/** The shared node for key, counted as a reuse, or nullptr **/
+	ExpNode * find(const Key& key);
+	/** Share node under key **/
+	template <typename T>
+	T * add(const Key& key, T * node){
+		node->markShared();
+		myNodes.emplace(key, node);
+		myBuilt++;
+		return node;
+	}
+	/** Which declaration of name is in scope, as a number **/
+	uintptr_t generation(Symbol name);
+
+	TokenSource& myInner;
+	Arena& myArena;
+	std::unordered_map<Key, ExpNode *, KeyHash> myNodes;
+	std::unordered_map<Symbol, uintptr_t> myGens;
+	/** Names declared in each open block, innermost last **/
+	std::vector<std::vector<Symbol>> myBlocks;
+	/** Each string literal's text, numbered for its Key **/
+	std::unordered_map<std::string, uintptr_t> myStrings;
+	uintptr_t myNextGen;
+	size_t myBuilt;
+	size_t myReused;
+};
+
+} //End namespace holeyc
+
+#endif
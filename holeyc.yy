@@ -9,11 +9,12 @@
 %token-table
 
 %code requires{
-	#include <list>
+	#include "arena.hpp"
 	#include "tokens.hpp"
 	#include "ast.hpp"
 	namespace holeyc {
-		class Scanner;
+		class TokenSource;
+		class ExpTable;
 	}
 
 //The following definition is required when
@@ -29,8 +30,12 @@
 //End "requires" code
 }
 
-%parse-param { holeyc::Scanner &scanner }
+%parse-param { holeyc::TokenSource &scanner }
+%parse-param { holeyc::Arena &arena }
 %parse-param { holeyc::ProgramNode** root }
+%parse-param { holeyc::FnBodyNode** body }
+%parse-param { holeyc::DeclSink * sink }
+%parse-param { holeyc::ExpTable * exps }
 
 %code{
    // C std code for utility functions
@@ -42,11 +47,24 @@
    #include "scanner.hpp"
    #include "ast.hpp"
    #include "tokens.hpp"
+   #include "hashcons.hpp"
+
+  /* An expression node free of side effects; with an ExpTable (-h)
+     it may be the shared node of an identical earlier expression */
+  template <typename T, typename... Args>
+  T * makeExp(holeyc::Arena& arena, holeyc::ExpTable * exps, Args... args){
+	return exps == nullptr ? arena.make<T>(args...)
+		: exps->make<T>(args...);
+  }
 
   //Request tokens from our scanner member, not
   // from a global function
   #undef yylex
-  #define yylex scanner.yylex
+  /* Past the source's depth limit, stop with a syntax error rather
+     than let the stack grow without bound */
+  #define yylex(lval) (scanner.tooDeep(yystack_.size()) \
+	? throw syntax_error("syntax error, nesting too deep") \
+	: scanner.next(lval))
 }
 
 
@@ -65,18 +83,19 @@ create new translation value types
    holeyc::CharLitToken *                   transCharToken;
    holeyc::StrToken *                   transStrToken;
    holeyc::IntLitToken *                   transIntToken;
+   holeyc::LazyBodyToken *             transLazyBody;
    holeyc::ProgramNode *               transProgram;
-   std::list<holeyc::DeclNode *> *     transDeclList;
-   std::list<VarDeclNode *> *          transvarDeclList;
+   holeyc::NodeList<holeyc::DeclNode *> *     transDeclList;
+   NodeList<VarDeclNode *> *          transvarDeclList;
    holeyc::DeclNode *                  transDecl;
    holeyc::VarDeclNode *               transVarDecl;
    holeyc::FnDeclNode *                transfnDecl;
    holeyc::FormalDeclNode *            formalDecl;
-   std::list<FormalDeclNode *> *       formalsList;
+   NodeList<FormalDeclNode *> *       formalsList;
    holeyc::FormalsListNode *           formalsType;
    holeyc::FnBodyNode *                fnBody;
-   std::list<StmtNode *> *             stmtList;
-   std::list<ExpNode *> *              expList;
+   NodeList<StmtNode *> *             stmtList;
+   NodeList<ExpNode *> *              expList;
    holeyc::StmtNode *                  stmt;
    holeyc::ExpNode *                   exp;
 	 holeyc::LValNode *                   lval;
@@ -135,6 +154,8 @@ create new translation value types
 %token	<transToken>     TRUE
 %token	<transToken>     VOID
 %token	<transToken>     WHILE
+%token	<transLazyBody>  LAZYBODY
+%token	<transToken>     BODYSTART
 
 
 /* Nonterminals
@@ -166,6 +187,8 @@ create new translation value types
 %type <assignExp>      assignExp
 %type <expList>         actualsList
 
+%start start
+
 %right ASSIGN
 %left OR
 %left AND
@@ -177,9 +200,18 @@ create new translation value types
 
 %%
 
+/* A whole program, or (after BODYSTART) one function body that was
+   skipped in lazy mode; see FnBodyNode::stmts */
+start		: program
+		  { }
+		| BODYSTART fnBody
+		  {
+		  *body = $2;
+		  }
+
 program 	: globals
 		  {
-		  $$ = new ProgramNode($1);
+		  $$ = arena.make<ProgramNode>($1);
 		  *root = $$;
 		  }
 
@@ -187,12 +219,19 @@ globals 	: globals decl
 		  {
 		  $$ = $1;
 		  DeclNode * aGlobalDecl = $2;
-		  $1->push_back(aGlobalDecl);
+		  if (sink != nullptr){
+		    sink->declParsed(aGlobalDecl);
+		  } else {
+		    $1->push_back(aGlobalDecl);
+		  }
 		  }
 		| /* epsilon */
 		  {
-		  std::list<DeclNode *> * startingGlobals;
-		  startingGlobals = new std::list<DeclNode *>();
+		  // Streaming keeps no list (see DeclSink)
+		  NodeList<DeclNode *> * startingGlobals = nullptr;
+		  if (sink == nullptr){
+		    startingGlobals = arena.make<NodeList<DeclNode *>>(arena);
+		  }
 	 	  $$ = startingGlobals;
 		  }
 		;
@@ -208,78 +247,84 @@ decl 		: varDecl SEMICOLON
 
 varDecl 	: type id
 		  {
-		  size_t typeLine = $1->line();
-		  size_t typeCol = $1->col();
-		  $$ = new VarDeclNode(typeLine, typeCol, $1, $2);
+		  $$ = arena.make<VarDeclNode>($1->pos(), $1, $2);
+		  if (exps != nullptr){ exps->declared($2->symbol()); }
 		  }
 
 type 		: INT
 		  {
 		  bool isPtr = false;
-		  $$ = new IntTypeNode($1->line(), $1->col(), isPtr);
+		  $$ = arena.make<IntTypeNode>($1->pos(), isPtr);
 		  }
 		| INTPTR
 		  {
 			bool isPtr = true;
-		  $$ = new IntPtrNode($1->line(), $1->col(), isPtr);
+		  $$ = arena.make<IntPtrNode>($1->pos(), isPtr);
 			}
 		| BOOL
 		  {
 		  bool isPtr = false;
-		  $$ = new BoolTypeNode($1->line(), $1->col(), isPtr);
+		  $$ = arena.make<BoolTypeNode>($1->pos(), isPtr);
 		   }
 		| BOOLPTR
 		  {
 			bool isPtr = true;
-		  $$ = new BoolPtrNode($1->line(), $1->col(), isPtr);
+		  $$ = arena.make<BoolPtrNode>($1->pos(), isPtr);
 			 }
 		| CHAR
 		  {
 		  bool isPtr = false;
-		  $$ = new CharTypeNode($1->line(), $1->col(), isPtr);
+		  $$ = arena.make<CharTypeNode>($1->pos(), isPtr);
 		   }
 		| CHARPTR
 		  {
 			bool isPtr = true;
-		  $$ = new CharPtrNode($1->line(), $1->col(), isPtr);
+		  $$ = arena.make<CharPtrNode>($1->pos(), isPtr);
 			 }
 		| VOID
 		  {
 		  bool isPtr = false;
-		  $$ = new VoidTypeNode($1->line(), $1->col(), isPtr);
+		  $$ = arena.make<VoidTypeNode>($1->pos(), isPtr);
 		   }
 
 fnDecl 		: type id formals fnBody
-		  {$$ = new FnDeclNode($1, $2, $3, $4); }
+		  {$$ = arena.make<FnDeclNode>($1, $2, $3, $4); }
 
 formals 	: LPAREN RPAREN
-		  {$$ = new FormalsListNode(new std::list<FormalDeclNode *>()); }
+		  {$$ = arena.make<FormalsListNode>(arena.make<NodeList<FormalDeclNode *>>(arena)); }
 		| LPAREN formalsList RPAREN
-		  {$$ = new FormalsListNode($2); }
+		  {$$ = arena.make<FormalsListNode>($2); }
 
 
 formalsList	: formalDecl
 		  {
-		  std::list<FormalDeclNode *> * list = new std::list<FormalDeclNode *>();
+		  NodeList<FormalDeclNode *> * list = arena.make<NodeList<FormalDeclNode *>>(arena);
 			list->push_back($1);
 			$$ = list;
 		  }
-		| formalDecl COMMA formalsList
+		| formalsList COMMA formalDecl
 		  {
-		  $3->push_front($1);
-			$$ = $3;
+		  $1->push_back($3);
+			$$ = $1;
 		  }
 
 formalDecl 	: type id
-		  {$$ = new FormalDeclNode($1, $2); }
+		  {
+		  $$ = arena.make<FormalDeclNode>($1, $2);
+		  if (exps != nullptr){ exps->declared($2->symbol()); }
+		  }
 
 fnBody		: LCURLY stmtList RCURLY
 		  {
-		  $$ = new FnBodyNode($1->line(), $1->col(), new StmtListNode($2));
+		  $$ = arena.make<FnBodyNode>($1->pos(), arena.make<StmtListNode>($2));
+		  }
+		| LAZYBODY
+		  {
+		  $$ = arena.make<FnBodyNode>($1);
 		  }
 
 stmtList 	: /* epsilon */
-		  {$$ = new std::list<StmtNode *>(); }
+		  {$$ = arena.make<NodeList<StmtNode *>>(arena); }
 		| stmtList stmt
 		  {
 		  $1->push_back($2);
@@ -289,78 +334,78 @@ stmtList 	: /* epsilon */
 stmt		: varDecl SEMICOLON
 		  {$$ = $1; }
 		| assignExp SEMICOLON
-		  {$$ = new AssignStmtNode($1); }
+		  {$$ = arena.make<AssignStmtNode>($1); }
 		| lval DASHDASH SEMICOLON
-		  {$$ = new PostDecStmtNode($1); }
+		  {$$ = arena.make<PostDecStmtNode>($2->pos(), $1); }
 		| lval CROSSCROSS SEMICOLON
-		  {$$ = new PostIncStmtNode($1); }
+		  {$$ = arena.make<PostIncStmtNode>($2->pos(), $1); }
 		| FROMCONSOLE lval SEMICOLON
-		  {$$ = new FromConsoleStmtNode($2->line(), $2->col(), $2); }
+		  {$$ = arena.make<FromConsoleStmtNode>($1->pos(), $2); }
 		| TOCONSOLE exp SEMICOLON
-		  {$$ = new ToConsoleStmtNode($2->line(), $2->col(), $2); }
+		  {$$ = arena.make<ToConsoleStmtNode>($1->pos(), $2); }
 		| IF LPAREN exp RPAREN LCURLY stmtList RCURLY
 		  {
-		  $$ = new IfStmtNode($1->line(), $1->col(), $3, $6);
+		  $$ = arena.make<IfStmtNode>($1->pos(), $3, $6);
 		  }
 		| IF LPAREN exp RPAREN LCURLY stmtList RCURLY ELSE LCURLY stmtList RCURLY
 		  {
-		  $$ = new IfElseStmtNode($3, $6, $10);
+		  $$ = arena.make<IfElseStmtNode>($1->pos(), $3, $6, $10);
 		  }
 		| WHILE LPAREN exp RPAREN LCURLY stmtList RCURLY
 		  {
-		  $$ = new WhileStmtNode($1->line(), $1->col(), $3, $6);
+		  $$ = arena.make<WhileStmtNode>($1->pos(), $3, $6);
 		  }
 		| RETURN exp SEMICOLON
-		  {$$ = new ReturnStmtNode($1->line(), $1->col(), $2); }
+		  {$$ = arena.make<ReturnStmtNode>($1->pos(), $2); }
 		| RETURN SEMICOLON
-		  {$$ = new ReturnStmtNode($1->line(), $1->col(), nullptr); }
+		  {$$ = arena.make<ReturnStmtNode>($1->pos(), nullptr); }
 		| callExp SEMICOLON
-		  {$$ = new CallStmtNode($1); }
+		  {$$ = arena.make<CallStmtNode>($1); }
 
 exp		: assignExp
 		  {$$ = $1; }
 		| exp DASH exp
-		  {$$ = new MinusNode($2->line(), $2->col(), $1, $3); }
+		  {$$ = makeExp<MinusNode>(arena, exps, $2->pos(), $1, $3); }
 		| exp CROSS exp
-		  {$$ = new PlusNode($2->line(), $2->col(), $1, $3); }
+		  {$$ = makeExp<PlusNode>(arena, exps, $2->pos(), $1, $3); }
 		| exp STAR exp
-		  {$$ = new TimesNode($2->line(), $2->col(), $1, $3); }
+		  {$$ = makeExp<TimesNode>(arena, exps, $2->pos(), $1, $3); }
 		| exp SLASH exp
-		  {$$ = new DivideNode($2->line(), $2->col(), $1, $3); }
+		  {$$ = makeExp<DivideNode>(arena, exps, $2->pos(), $1, $3); }
 		| exp AND exp
-		  {$$ = new AndNode($2->line(), $2->col(), $1, $3); }
+		  {$$ = makeExp<AndNode>(arena, exps, $2->pos(), $1, $3); }
 		| exp OR exp
-		  {$$ = new OrNode($2->line(), $2->col(), $1, $3); }
+		  {$$ = makeExp<OrNode>(arena, exps, $2->pos(), $1, $3); }
 		| exp EQUALS exp
-		  {$$ = new EqualsNode($2->line(), $2->col(), $1, $3); }
+		  {$$ = makeExp<EqualsNode>(arena, exps, $2->pos(), $1, $3); }
 		| exp NOTEQUALS exp
-		  {$$ = new NotEqualsNode($2->line(), $2->col(), $1, $3); }
+		  {$$ = makeExp<NotEqualsNode>(arena, exps, $2->pos(), $1, $3); }
 		| exp GREATER exp
-		  {$$ = new GreaterNode($2->line(), $2->col(), $1, $3); }
+		  {$$ = makeExp<GreaterNode>(arena, exps, $2->pos(), $1, $3); }
 		| exp GREATEREQ exp
-		  {$$ = new GreaterEqNode($2->line(), $2->col(), $1, $3); }
+		  {$$ = makeExp<GreaterEqNode>(arena, exps, $2->pos(), $1, $3); }
 		| exp LESS exp
-		  {$$ = new LessNode($2->line(), $2->col(), $1, $3); }
+		  {$$ = makeExp<LessNode>(arena, exps, $2->pos(), $1, $3); }
 		| exp LESSEQ exp
-		  {$$ = new LessEqNode($2->line(), $2->col(), $1, $3); }
+		  {$$ = makeExp<LessEqNode>(arena, exps, $2->pos(), $1, $3); }
 		| NOT exp
-		  {$$ = new NotNode($2->line(), $2->col(), $2); }
+		  {$$ = makeExp<NotNode>(arena, exps, $1->pos(), $2); }
 		| DASH term
-		  {$$ = new NegNode($2); }
+		  {$$ = makeExp<NegNode>(arena, exps, $1->pos(), $2); }
 		| term
 		  {$$ = $1; }
 
 assignExp	: lval ASSIGN exp
-		  {$$ = new AssignExpNode($2->line(), $2->col(), $1, $3); }
+		  {$$ = arena.make<AssignExpNode>($2->pos(), $1, $3); }
 
 callExp		: id LPAREN RPAREN
-		  {$$ = new CallExpNode($1, nullptr); }
+		  {$$ = arena.make<CallExpNode>($1, nullptr); }
 		| id LPAREN actualsList RPAREN
-		  {$$ = new CallExpNode($1, $3); }
+		  {$$ = arena.make<CallExpNode>($1, $3); }
 
 actualsList	: exp
 		  {
-		  std::list<ExpNode *> * list = new std::list<ExpNode *>();
+		  NodeList<ExpNode *> * list = arena.make<NodeList<ExpNode *>>(arena);
           list->push_back($1);
           $$ = list;
 		  }
@@ -376,46 +421,53 @@ term 		: lval
 		  {$$ = $1; }
 		| NULLPTR
 		  {
-		  $$ = new NullPtrNode($1->line(), $1->col());
+		  $$ = makeExp<NullPtrNode>(arena, exps, $1->pos());
 		  }
 		| INTLITERAL
-		  {$$ = new IntLitNode($1); }
+		  {$$ = makeExp<IntLitNode>(arena, exps, $1); }
 		| STRLITERAL
-		  {$$ = new StrLitNode($1); }
+		  {$$ = makeExp<StrLitNode>(arena, exps, $1); }
 		| CHARLIT
-		  {$$ = new CharLitNode($1); }
+		  {$$ = makeExp<CharLitNode>(arena, exps, $1); }
 		| TRUE
-		  {$$ = new TrueNode($1->line(), $1->col()); }
+		  {$$ = makeExp<TrueNode>(arena, exps, $1->pos()); }
 		| FALSE
-		  {$$ = new FalseNode($1->line(), $1->col()); }
+		  {$$ = makeExp<FalseNode>(arena, exps, $1->pos()); }
 		| LPAREN exp RPAREN
 		  {$$ = $2; }
 
-lval		: id
+lval		: ID
 		  {
-		  $$ = $1;
+		  $$ = makeExp<IDNode>(arena, exps, $1);
 		  }
-		| id LBRACE exp RBRACE
+		| ID LBRACE exp RBRACE
 		  {
-		  $$ = new IndexNode($1->line(), $1->col(), $1, $3);
+		  $$ = makeExp<IndexNode>(arena, exps, $1->pos(),
+			makeExp<IDNode>(arena, exps, $1), $3);
 		  }
-		| AT id
+		| AT ID
 		  {
-		  $$ = new DerefNode($2->line(), $2->col(), $2);
+		  $$ = makeExp<DerefNode>(arena, exps, $2->pos(),
+			makeExp<IDNode>(arena, exps, $2));
 		  }
-		| CARAT id
+		| CARAT ID
 		  {
-		  $$ = new RefNode($2->line(), $2->col(), $2);
+		  $$ = makeExp<RefNode>(arena, exps, $2->pos(),
+			makeExp<IDNode>(arena, exps, $2));
 		  }
 
 id		: ID
 		  {
-		  $$ = new IDNode($1);
+		  $$ = arena.make<IDNode>($1);
 		  }
 
 %%
 
 void holeyc::Parser::error(const std::string& msg){
-	std::cout << msg << std::endl;
-	std::cerr << "syntax error" << std::endl;
+	Report::outs() << msg << std::endl;
+	/* Filed at the lookahead token, so it sorts in among the
+	   lexical errors around it */
+	size_t line, col;
+	scanner.lines().locate(scanner.lastPos(), line, col);
+	Report::fatal(line, col, DiagCode::SyntaxError, msg);
 }
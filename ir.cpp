@@ -0,0 +1,267 @@
+#include <string>
+#include <unordered_map>
+#include "ir.hpp"
+#include "errors.hpp"
+
+namespace holeyc{
+
+/* An index into the table of a kind, which an Operand can hold */
+static Operand operand(Operand::Kind kind, size_t index){
+	if (index >= Operand::LIMIT){
+		throw new InternalError("too many operands in one table");
+	}
+	return Operand(kind, static_cast<uint32_t>(index));
+}
+
+static bool isTerminator(Op op){
+	return op == Op::Jump || op == Op::Branch || op == Op::Ret;
+}
+
+Operand IRFunction::addLocal(StrRef name, TypeCode type){
+	myLocals.push_back(IRVar{name, type});
+	return operand(Operand::Local, myLocals.size() - 1);
+}
+
+Operand IRFunction::newTemp(){
+	return operand(Operand::Temp, myTemps++);
+}
+
+Operand IRFunction::intConst(int val){
+	myConsts.push_back(val);
+	return operand(Operand::Int, myConsts.size() - 1);
+}
+
+Operand IRFunction::newBlock(){
+	myBlocks.push_back(BasicBlock{0, 0});
+	return operand(Operand::Block, myBlocks.size() - 1);
+}
+
+bool IRFunction::terminated() const{
+	return !myLayout.empty() && myQuads.size() > myBlocks[myCurrent].begin
+		&& isTerminator(myQuads.back().op);
+}
+
+void IRFunction::place(Operand block){
+	if (!myLayout.empty()){
+		if (!terminated()){
+			throw new InternalError("placed a block after an open one");
+		}
+		myBlocks[myCurrent].end = static_cast<uint32_t>(myQuads.size());
+	}
+	myCurrent = block.index();
+	myBlocks[myCurrent].begin = static_cast<uint32_t>(myQuads.size());
+	myLayout.push_back(myCurrent);
+}
+
+void IRFunction::finish(){
+	myBlocks[myCurrent].end = static_cast<uint32_t>(myQuads.size());
+	if (myLayout.size() != myBlocks.size()){
+		throw new InternalError("a block was never placed");
+	}
+	/* Number the blocks in layout order, which is quad order */
+	std::vector<uint32_t> number(myBlocks.size());
+	std::vector<BasicBlock> blocks(myBlocks.size());
+	for (uint32_t i = 0; i < myLayout.size(); i++){
+		number[myLayout[i]] = i;
+		blocks[i] = myBlocks[myLayout[i]];
+	}
+	myBlocks.swap(blocks);
+	std::vector<uint32_t>().swap(myLayout);
+	for (Quad& quad : myQuads){
+		if (quad.op == Op::Jump){
+			quad.a = Operand(Operand::Block, number[quad.a.index()]);
+		} else if (quad.op == Op::Branch){
+			quad.b = Operand(Operand::Block, number[quad.b.index()]);
+			quad.dst = Operand(Operand::Block, number[quad.dst.index()]);
+		}
+	}
+
+	/* Count each block's predecessors, then place them */
+	myPredStart.assign(myBlocks.size() + 1, 0);
+	uint32_t succ[2];
+	for (uint32_t b = 0; b < myBlocks.size(); b++){
+		for (size_t s = 0, n = succs(b, succ); s < n; s++){
+			myPredStart[succ[s] + 1]++;
+		}
+	}
+	for (size_t b = 0; b < myBlocks.size(); b++){
+		myPredStart[b + 1] += myPredStart[b];
+	}
+	myPreds.resize(myPredStart.back());
+	std::vector<uint32_t> fill(myPredStart.begin(), myPredStart.end() - 1);
+	for (uint32_t b = 0; b < myBlocks.size(); b++){
+		for (size_t s = 0, n = succs(b, succ); s < n; s++){
+			myPreds[fill[succ[s]]++] = b;
+		}
+	}
+}
+
+size_t IRFunction::succs(uint32_t b, uint32_t succs[2]) const{
+	const Quad& last = myQuads[myBlocks[b].end - 1];
+	switch (last.op){
+	case Op::Jump:
+		succs[0] = last.a.index();
+		return 1;
+	case Op::Branch:
+		succs[0] = last.b.index();
+		succs[1] = last.dst.index();
+		/* Both arms may go to the same block */
+		return succs[0] == succs[1] ? 1 : 2;
+	default:
+		return 0;
+	}
+}
+
+Operand IRProgram::addGlobal(StrRef name, TypeCode type){
+	myGlobals.push_back(IRVar{name, type});
+	return operand(Operand::Global, myGlobals.size() - 1);
+}
+
+Operand IRProgram::addString(StrRef text){
+	myStrings.push_back(text);
+	return operand(Operand::Str, myStrings.size() - 1);
+}
+
+Operand IRProgram::addFunction(StrRef name, TypeCode ret, uint32_t formals){
+	myFunctions.emplace_back(name, ret, formals);
+	return operand(Operand::Fn, myFunctions.size() - 1);
+}
+
+/* Writes the operands and quads of one function */
+class QuadWriter{
+public:
+	QuadWriter(Writer& out, const IRProgram& program, const IRFunction& fn)
+	: myOut(out), myProgram(program), myFn(fn){
+		/* A local that shadows one of the same name gets a suffix */
+		std::unordered_map<std::string, size_t> seen;
+		for (const IRVar& local : fn.locals()){
+			size_t count = seen[local.name.str()]++;
+			myLocals.push_back(count == 0 ? local.name.str()
+				: local.name.str() + "." + std::to_string(count));
+		}
+	}
+
+	void local(size_t i){
+		const IRVar& var = myFn.locals()[i];
+		myOut << DataType::of(var.type)->str() << " " << myLocals[i];
+	}
+
+	void quad(const Quad& quad){
+		myOut << "\t";
+		switch (quad.op){
+		case Op::Copy: assign(quad.dst) << opd(quad.a); break;
+		case Op::Add: binary(quad, " + "); break;
+		case Op::Sub: binary(quad, " - "); break;
+		case Op::Mul: binary(quad, " * "); break;
+		case Op::Div: binary(quad, " / "); break;
+		case Op::Eq: binary(quad, " == "); break;
+		case Op::Ne: binary(quad, " != "); break;
+		case Op::Lt: binary(quad, " < "); break;
+		case Op::Gt: binary(quad, " > "); break;
+		case Op::Le: binary(quad, " <= "); break;
+		case Op::Ge: binary(quad, " >= "); break;
+		case Op::Neg: assign(quad.dst) << "-" << opd(quad.a); break;
+		case Op::Not: assign(quad.dst) << "!" << opd(quad.a); break;
+		case Op::Addr: assign(quad.dst) << "&" << opd(quad.a); break;
+		case Op::Load:
+			assign(quad.dst) << "load." << type(quad) << " " << opd(quad.a);
+			break;
+		case Op::Store:
+			myOut << "store." << type(quad) << " " << opd(quad.dst) << ", "
+				<< opd(quad.a);
+			break;
+		case Op::Arg: myOut << "arg " << opd(quad.a); break;
+		case Op::Call:
+			if (!quad.dst.none()){ assign(quad.dst); }
+			myOut << "call " << opd(quad.a);
+			break;
+		case Op::Read: assign(quad.dst) << "read." << type(quad); break;
+		case Op::Write:
+			myOut << "write." << type(quad) << " " << opd(quad.a);
+			break;
+		case Op::Jump: myOut << "jmp " << opd(quad.a); break;
+		case Op::Branch:
+			myOut << "br " << opd(quad.a) << ", " << opd(quad.b) << ", "
+				<< opd(quad.dst);
+			break;
+		case Op::Ret:
+			myOut << "ret";
+			if (!quad.a.none()){ myOut << " " << opd(quad.a); }
+			break;
+		}
+		myOut << "\n";
+	}
+
+private:
+	std::string opd(Operand opd){
+		switch (opd.kind()){
+		case Operand::None: return "_";
+		case Operand::Temp: return "%" + std::to_string(opd.index());
+		case Operand::Local: return myLocals[opd.index()];
+		case Operand::Global:
+			return "$" + myProgram.globals()[opd.index()].name.str();
+		case Operand::Int: return std::to_string(myFn.constant(opd));
+		case Operand::Str: return myProgram.strings()[opd.index()].str();
+		case Operand::Fn:
+			return myProgram.functions()[opd.index()].name().str();
+		case Operand::Block: return "B" + std::to_string(opd.index());
+		}
+		return "?";
+	}
+	std::string type(const Quad& quad){
+		return DataType::of(quad.type)->str();
+	}
+	Writer& assign(Operand dst){
+		return myOut << opd(dst) << " = ";
+	}
+	void binary(const Quad& quad, const char * op){
+		assign(quad.dst) << opd(quad.a) << op << opd(quad.b);
+	}
+
+	Writer& myOut;
+	const IRProgram& myProgram;
+	const IRFunction& myFn;
+	std::vector<std::string> myLocals;
+};
+
+void IRProgram::dump(Writer& out) const{
+	for (const IRVar& global : myGlobals){
+		out << "global " << DataType::of(global.type)->str() << " $"
+			<< global.name << "\n";
+	}
+	/* A blank line between globals and each function */
+	bool first = myGlobals.empty();
+	for (const IRFunction& fn : myFunctions){
+		QuadWriter quads(out, *this, fn);
+		if (!first){ out << "\n"; }
+		first = false;
+		out << "fn " << DataType::of(fn.ret())->str() << " " << fn.name()
+			<< "(";
+		for (size_t i = 0; i < fn.formals(); i++){
+			if (i != 0){ out << ", "; }
+			quads.local(i);
+		}
+		out << ")\n";
+		for (size_t i = fn.formals(); i < fn.locals().size(); i++){
+			out << "\tlocal ";
+			quads.local(i);
+			out << "\n";
+		}
+		for (uint32_t b = 0; b < fn.blocks().size(); b++){
+			out << "B" << static_cast<size_t>(b) << ":";
+			const char * sep = " <- ";
+			for (const uint32_t * p = fn.predsBegin(b); p != fn.predsEnd(b);
+				++p){
+				out << sep << "B" << static_cast<size_t>(*p);
+				sep = ", ";
+			}
+			out << "\n";
+			const BasicBlock& block = fn.blocks()[b];
+			for (uint32_t q = block.begin; q < block.end; q++){
+				quads.quad(fn.quads()[q]);
+			}
+		}
+	}
+}
+
+} //End namespace holeyc
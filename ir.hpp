@@ -0,0 +1,177 @@
+#ifndef HOLEYC_IR_HPP
+#define HOLEYC_IR_HPP
+
+#include <cstdint>
+#include <vector>
+#include "strref.hpp"
+#include "types.hpp"
+#include "writer.hpp"
+
+namespace holeyc{
+
+/**
+* \class Operand
+* What a quad reads or writes, in 32 bits: a kind and an index into
+* the table for that kind (the function's temporaries, locals or
+* constants, the program's globals, strings or functions, or the
+* function's blocks).
+**/
+class Operand{
+public:
+	enum Kind : uint8_t{ None, Temp, Local, Global, Int, Str, Fn, Block };
+
+	Operand() : myBits(0){ }
+	Operand(Kind kind, uint32_t index) : myBits(index << 3 | kind){ }
+
+	Kind kind() const { return static_cast<Kind>(myBits & 7); }
+	uint32_t index() const { return myBits >> 3; }
+	bool none() const { return myBits == 0; }
+
+	/** Indices must stay below this **/
+	static const uint32_t LIMIT = 1u << 29;
+private:
+	uint32_t myBits;
+};
+
+/**
+* What a quad does. dst is written; a and b are read, except where
+* noted.
+**/
+enum class Op : uint8_t{
+	Copy,               /// dst = a
+	Add, Sub, Mul, Div, /// dst = a op b, on ints
+	Eq, Ne, Lt, Gt, Le, Ge, /// dst = a op b, a bool
+	Neg, Not,           /// dst = op a
+	Addr,   /// dst = the address of local or global a
+	Load,   /// dst = the value of type at address a
+	Store,  /// the value of type at address dst = a
+	Arg,    /// a is the next argument of the next Call
+	Call,   /// dst (none for a void call) = function a(the Args)
+	Read,   /// dst = a value of type read from the console
+	Write,  /// write a, of type, to the console
+	Jump,   /// go to block a
+	Branch, /// go to block b if a, else to block dst
+	Ret,    /// return a (none in a void function)
+};
+
+/** One three-address instruction **/
+struct Quad{
+	Op op;
+	TypeCode type; /// What Load, Store, Read and Write move
+	Operand dst;
+	Operand a;
+	Operand b;
+};
+
+/**
+* A maximal run of quads entered only at the top and left only at the
+* bottom, by the terminator (Jump, Branch or Ret) that is its last quad
+**/
+struct BasicBlock{
+	uint32_t begin;
+	uint32_t end;
+};
+
+/** A local (or formal) or global variable **/
+struct IRVar{
+	StrRef name;
+	TypeCode type;
+};
+
+/**
+* \class IRFunction
+* One function's three-address code: its quads in one array, in block
+* order, and its blocks as ranges of that array. A block's successors
+* are read off its terminator; its predecessors are kept in one array
+* too, each block's as a range of it. Formals are the first locals.
+*
+* Built by Lowering: quads are emitted into the current block, and
+* blocks may be made before they are placed, to be jumped to. finish()
+* then numbers the blocks in the order they were placed and collects
+* the predecessors.
+**/
+class IRFunction{
+public:
+	IRFunction(StrRef name, TypeCode ret, uint32_t formals)
+	: myName(name), myRet(ret), myFormals(formals), myTemps(0),
+	  myCurrent(0){
+	}
+
+	StrRef name() const { return myName; }
+	TypeCode ret() const { return myRet; }
+	uint32_t formals() const { return myFormals; }
+	const std::vector<IRVar>& locals() const { return myLocals; }
+	uint32_t temps() const { return myTemps; }
+	int constant(Operand opd) const { return myConsts[opd.index()]; }
+	const std::vector<Quad>& quads() const { return myQuads; }
+	const std::vector<BasicBlock>& blocks() const { return myBlocks; }
+	/** Writes block b's successors to succs; returns how many (0-2) **/
+	size_t succs(uint32_t b, uint32_t succs[2]) const;
+	const uint32_t * predsBegin(uint32_t b) const {
+		return myPreds.data() + myPredStart[b];
+	}
+	const uint32_t * predsEnd(uint32_t b) const {
+		return myPreds.data() + myPredStart[b + 1];
+	}
+
+	/* Building */
+	Operand addLocal(StrRef name, TypeCode type);
+	Operand newTemp();
+	Operand intConst(int val);
+	/** A block to place later **/
+	Operand newBlock();
+	/** Start emitting into block, once the current one is terminated **/
+	void place(Operand block);
+	void emit(Op op, Operand dst, Operand a = Operand(),
+		Operand b = Operand(), TypeCode type = TypeCode::Unchecked){
+		myQuads.push_back(Quad{op, type, dst, a, b});
+	}
+	/** Whether the current block ends in a terminator **/
+	bool terminated() const;
+	void finish();
+
+private:
+	StrRef myName;
+	TypeCode myRet;
+	uint32_t myFormals;
+	std::vector<IRVar> myLocals;
+	uint32_t myTemps;
+	std::vector<int> myConsts;
+	std::vector<Quad> myQuads;
+	std::vector<BasicBlock> myBlocks;
+	/** The blocks in the order they were placed, while building **/
+	std::vector<uint32_t> myLayout;
+	uint32_t myCurrent;
+	std::vector<uint32_t> myPredStart;
+	std::vector<uint32_t> myPreds;
+};
+
+/**
+* \class IRProgram
+* A whole program in three-address code: its globals, the string
+* literals its code writes, and its functions, in declaration order.
+**/
+class IRProgram{
+public:
+	const std::vector<IRVar>& globals() const { return myGlobals; }
+	const std::vector<StrRef>& strings() const { return myStrings; }
+	const std::vector<IRFunction>& functions() const { return myFunctions; }
+	IRFunction& function(Operand fn){ return myFunctions[fn.index()]; }
+
+	/** The -r dump: every function's blocks, quads and edges **/
+	void dump(Writer& out) const;
+
+	/* Building */
+	Operand addGlobal(StrRef name, TypeCode type);
+	Operand addString(StrRef text);
+	Operand addFunction(StrRef name, TypeCode ret, uint32_t formals);
+
+private:
+	std::vector<IRVar> myGlobals;
+	std::vector<StrRef> myStrings;
+	std::vector<IRFunction> myFunctions;
+};
+
+} //End namespace holeyc
+
+#endif
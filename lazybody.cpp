@@ -0,0 +1,52 @@
+#include "ast.hpp"
+#include "scanner.hpp"
+
+namespace holeyc{
+
+/* Puts BODYSTART before a lazy body's tokens, which steers the parser
+   to its one-function-body start rule */
+class BodySource : public TokenSource{
+public:
+	BodySource(TokenSource& inner, const LazyBodyToken& lazy)
+	: TokenSource(inner.lines()), myInner(inner), myLazy(lazy),
+	  myStarted(false){ }
+
+	int yylex(holeyc::Parser::semantic_type * const lval) override{
+		if (myStarted){ return myInner.next(lval); }
+		myStarted = true;
+		lval->transToken = nullptr;
+		mark(myLazy.pos());
+		return TokenKind::BODYSTART;
+	}
+private:
+	TokenSource& myInner;
+	const LazyBodyToken& myLazy;
+	bool myStarted;
+};
+
+StmtListNode * FnBodyNode::stmts(){
+	if (myLazy != nullptr){ parseBody(myLazy->arena()); }
+	return myStmtList;
+}
+
+bool FnBodyNode::parseBody(Arena& arena, size_t depthLimit){
+	if (myLazy == nullptr){ return true; }
+	LazyBodyToken * lazy = myLazy;
+	myLazy = nullptr;
+
+	Scanner scanner(lazy->base(), lazy->lines(), arena, lazy->begin(),
+		lazy->end());
+	BodySource source(scanner, *lazy);
+	source.limitDepth(depthLimit);
+	FnBodyNode * parsed = nullptr;
+	Parser parser(source, arena, nullptr, &parsed, nullptr, nullptr);
+	if (parser.parse() == 0){
+		myStmtList = parsed->myStmtList;
+		return true;
+	}
+	myStmtList = arena.make<StmtListNode>(
+		arena.make<NodeList<StmtNode *>>(arena));
+	return false;
+}
+
+} //End namespace holeyc
@@ -0,0 +1,83 @@
+#include "lexthread.hpp"
+
+namespace holeyc{
+
+/* Spin briefly, then give the core away: the other side may need it */
+static void backOff(unsigned& spins){
+	if (++spins > 64){ std::this_thread::yield(); }
+}
+
+LexerThread::LexerThread(std::unique_ptr<TokenSource> inner)
+: TokenSource(inner->lines()), myInner(std::move(inner)), myStop(false),
+  myStarted(false), myDone(false), myEnd{TokenKind::END, nullptr, 0, nullptr}{
+}
+
+LexerThread::~LexerThread(){
+	myStop.store(true, std::memory_order_relaxed);
+	if (myThread.joinable()){ myThread.join(); }
+	Slot slot;
+	while (myRing.pop(slot)){ delete slot.diags; }
+}
+
+void LexerThread::produce(){
+	Diagnostics pending;
+	DiagnosticScope scope(pending);
+	holeyc::Parser::semantic_type lval;
+	Slot slot;
+	do {
+		try {
+			slot.kind = myInner->next(&lval);
+			slot.token = lval.transToken;
+		} catch (...){
+			/* Published with the END below, rethrown by the parser */
+			myFailure = std::current_exception();
+			slot.kind = TokenKind::END;
+			slot.token = nullptr;
+		}
+		slot.pos = myInner->lastPos();
+		slot.diags = nullptr;
+		if (!pending.empty()){
+			slot.diags = new std::vector<Diagnostic>(pending.take());
+		}
+		unsigned spins = 0;
+		while (!myRing.push(slot)){
+			/* The parser stopped early (a syntax error) and is gone */
+			if (myStop.load(std::memory_order_relaxed)){
+				delete slot.diags;
+				return;
+			}
+			backOff(spins);
+		}
+	} while (slot.kind != TokenKind::END);
+}
+
+int LexerThread::yylex(holeyc::Parser::semantic_type * const lval){
+	if (!myStarted){
+		myStarted = true;
+		myThread = std::thread(&LexerThread::produce, this);
+	}
+	/* Past the end, keep answering END like a scanner at EOF */
+	Slot slot = myEnd;
+	if (!myDone){
+		unsigned spins = 0;
+		while (!myRing.pop(slot)){ backOff(spins); }
+		if (slot.diags != nullptr){
+			for (Diagnostic& d : *slot.diags){
+				Diagnostics::report(d.severity, d.code, d.line, d.col,
+					std::move(d.detail));
+			}
+			delete slot.diags;
+			slot.diags = nullptr;
+		}
+		if (slot.kind == TokenKind::END){
+			myDone = true;
+			myEnd = slot;
+			if (myFailure != nullptr){ std::rethrow_exception(myFailure); }
+		}
+	}
+	lval->transToken = slot.token;
+	if (slot.token == nullptr){ mark(slot.pos); }
+	return slot.kind;
+}
+
+} //End namespace holeyc
@@ -0,0 +1,114 @@
+#ifndef HOLEYC_LEXTHREAD_HPP
+#define HOLEYC_LEXTHREAD_HPP
+
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "diagnostics.hpp"
+#include "scanner.hpp"
+
+namespace holeyc{
+
+/**
+* \class TokenRing
+* Bounded single-producer/single-consumer queue. Each side owns one
+* index and only reads the other's, so no locks are needed: a slot
+* written before the producer publishes its index is visible to the
+* consumer that loads it. Capacity must be a power of two.
+**/
+template <typename T, size_t Capacity>
+class TokenRing{
+	static_assert((Capacity & (Capacity - 1)) == 0,
+		"TokenRing capacity must be a power of two");
+public:
+	TokenRing() : mySlots(Capacity), myHead(0), myCachedTail(0),
+		myTail(0), myCachedHead(0){ }
+
+	/** Producer side; false if the ring is full **/
+	bool push(const T& item){
+		size_t tail = myTail.load(std::memory_order_relaxed);
+		if (tail - myCachedHead == Capacity){
+			myCachedHead = myHead.load(std::memory_order_acquire);
+			if (tail - myCachedHead == Capacity){ return false; }
+		}
+		mySlots[tail & (Capacity - 1)] = item;
+		myTail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	/** Consumer side; false if the ring is empty **/
+	bool pop(T& item){
+		size_t head = myHead.load(std::memory_order_relaxed);
+		if (head == myCachedTail){
+			myCachedTail = myTail.load(std::memory_order_acquire);
+			if (head == myCachedTail){ return false; }
+		}
+		item = mySlots[head & (Capacity - 1)];
+		myHead.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+private:
+	std::vector<T> mySlots;
+	/* Padding keeps the consumer's fields and the producer's on
+	   separate cache lines, so the two threads do not share one */
+	char myPad0[64];
+	std::atomic<size_t> myHead;
+	size_t myCachedTail; /// Consumer's last view of myTail
+	char myPad1[64];
+	std::atomic<size_t> myTail;
+	size_t myCachedHead; /// Producer's last view of myHead
+	char myPad2[64];
+};
+
+/**
+* \class LexerThread
+* Runs another token source (normally a Scanner) on its own thread,
+* ahead of the parser, and hands its tokens over through a TokenRing.
+*
+* The lexer must not share an arena with the parser's thread. The
+* diagnostics it reports are not filed from its thread; they travel
+* with the next token and are reported when the parser takes that
+* token, exactly when a serial scan would have reported them. So the
+* collected order (and an error limit) are the same as without the
+* thread.
+**/
+class LexerThread : public TokenSource{
+public:
+	explicit LexerThread(std::unique_ptr<TokenSource> inner);
+	~LexerThread() override;
+	LexerThread(const LexerThread&) = delete;
+	LexerThread& operator=(const LexerThread&) = delete;
+
+	int yylex(holeyc::Parser::semantic_type * const lval) override;
+	/** Passed on; only takes effect before the first token is read **/
+	void scanOnly() override { myInner->scanOnly(); }
+	void lazyBodies() override { myInner->lazyBodies(); }
+
+private:
+	struct Slot{
+		int kind;
+		Token * token;
+		SourcePos pos;
+		/** Diagnostics reported while scanning this token, if any **/
+		std::vector<Diagnostic> * diags;
+	};
+
+	void produce();
+
+	std::unique_ptr<TokenSource> myInner;
+	TokenRing<Slot, 4096> myRing;
+	std::thread myThread;
+	std::atomic<bool> myStop;
+	/** Set by the lexer thread if the inner source threw **/
+	std::exception_ptr myFailure;
+	bool myStarted;
+	bool myDone;
+	Slot myEnd; /// The END slot, once it has been handed out
+};
+
+} //End namespace holeyc
+
+#endif
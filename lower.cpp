@@ -0,0 +1,437 @@
+#include "lower.hpp"
+#include "errors.hpp"
+
+namespace holeyc{
+
+/* The bytes one value of a type takes in memory */
+static int sizeOf(TypeCode type){
+	return type == TypeCode::Bool || type == TypeCode::Char ? 1 : 8;
+}
+
+static Op binaryOp(NodeKind kind){
+	switch (kind){
+	case NodeKind::Plus: return Op::Add;
+	case NodeKind::Minus: return Op::Sub;
+	case NodeKind::Times: return Op::Mul;
+	case NodeKind::Divide: return Op::Div;
+	case NodeKind::Equals: return Op::Eq;
+	case NodeKind::NotEquals: return Op::Ne;
+	case NodeKind::Less: return Op::Lt;
+	case NodeKind::Greater: return Op::Gt;
+	case NodeKind::LessEq: return Op::Le;
+	case NodeKind::GreaterEq: return Op::Ge;
+	default:
+		throw new InternalError("not a binary operator");
+	}
+}
+
+static TypeCode typeOf(VarDeclNode * decl){
+	return DataType::of(decl->type())->code();
+}
+
+void Lowering::run(ProgramNode * program){
+	/* Every function is numbered before any body calls it */
+	for (auto global : *program->globals()){
+		if (global->kind() == NodeKind::FnDecl){
+			FnDeclNode * fn = static_cast<FnDeclNode *>(global);
+			myGlobals[fn] = myOut.addFunction(fn->id()->name(),
+				fn->signature()->ret()->code(),
+				static_cast<uint32_t>(fn->formals()->formals()->size()));
+		} else {
+			VarDeclNode * decl = static_cast<VarDeclNode *>(global);
+			myGlobals[decl] = myOut.addGlobal(decl->id()->name(),
+				typeOf(decl));
+		}
+	}
+	for (auto global : *program->globals()){
+		if (global->kind() == NodeKind::FnDecl){
+			lowerBody(static_cast<FnDeclNode *>(global));
+		}
+	}
+}
+
+void Lowering::lowerBody(FnDeclNode * fn){
+	myFn = &myOut.function(myGlobals[fn]);
+	myLocals.clear();
+	for (auto formal : *fn->formals()->formals()){
+		myLocals[formal] = myFn->addLocal(formal->id()->name(),
+			typeOf(formal));
+	}
+	myFn->place(myFn->newBlock());
+	Stmts * stmts = fn->body()->stmts()->stmts();
+	myFrames.push_back(Frame{stmts, stmts->begin(), Operand(), Operand()});
+	while (!myFrames.empty()){
+		Frame& frame = myFrames.back();
+		if (frame.at != frame.stmts->end()){
+			lowerStmt(frame);
+			continue;
+		}
+		Frame done = frame;
+		myFrames.pop_back();
+		if (!done.jump.none()){ jumpTo(done.jump); }
+		if (!done.place.none()){ myFn->place(done.place); }
+	}
+	/* Falling off the end returns */
+	if (!myFn->terminated()){ myFn->emit(Op::Ret, Operand()); }
+	myFn->finish();
+}
+
+void Lowering::lowerStmt(Frame& frame){
+	StmtNode * stmt = *frame.at;
+	/* Before any push, which may move frame */
+	++frame.at;
+	switch (stmt->kind()){
+	case NodeKind::VarDecl: {
+		VarDeclNode * decl = static_cast<VarDeclNode *>(stmt);
+		myLocals[decl] = myFn->addLocal(decl->id()->name(), typeOf(decl));
+		break;
+	}
+	case NodeKind::AssignStmt:
+		lowerExp(static_cast<AssignStmtNode *>(stmt)->assign());
+		break;
+	case NodeKind::CallStmt:
+		lowerExp(static_cast<CallStmtNode *>(stmt)->callExp());
+		break;
+	case NodeKind::FromConsole: {
+		LValNode * val = static_cast<FromConsoleStmtNode *>(stmt)->val();
+		TypeCode type = val->type()->code();
+		lowerTarget(val);
+		if (val->kind() == NodeKind::ID){
+			emit(Op::Read, var(static_cast<IDNode *>(val)), Operand(),
+				Operand(), type);
+		} else {
+			assign(val, temp(Op::Read, Operand(), Operand(), type));
+		}
+		break;
+	}
+	case NodeKind::ToConsole: {
+		ExpNode * exp = static_cast<ToConsoleStmtNode *>(stmt)->exp();
+		emit(Op::Write, Operand(), lowerExp(exp), Operand(),
+			exp->type()->code());
+		break;
+	}
+	case NodeKind::PostInc:
+	case NodeKind::PostDec: {
+		LValNode * lval = static_cast<LValNode *>(
+			stmt->kind() == NodeKind::PostInc
+			? static_cast<PostIncStmtNode *>(stmt)->exp()
+			: static_cast<PostDecStmtNode *>(stmt)->exp());
+		Op op = stmt->kind() == NodeKind::PostInc ? Op::Add : Op::Sub;
+		lowerTarget(lval);
+		if (lval->kind() == NodeKind::ID){
+			Operand x = var(static_cast<IDNode *>(lval));
+			emit(op, x, x, myFn->intConst(1));
+		} else {
+			Operand addr = pop();
+			Operand val = temp(Op::Load, addr, Operand(), TypeCode::Int);
+			emit(Op::Store, addr, temp(op, val, myFn->intConst(1)),
+				Operand(), TypeCode::Int);
+		}
+		break;
+	}
+	case NodeKind::Return: {
+		ExpNode * exp = static_cast<ReturnStmtNode *>(stmt)->exp();
+		emit(Op::Ret, Operand(), exp == nullptr ? Operand() : lowerExp(exp));
+		break;
+	}
+	case NodeKind::If: {
+		IfStmtNode * ifStmt = static_cast<IfStmtNode *>(stmt);
+		Operand cond = lowerExp(ifStmt->exp());
+		Operand then = myFn->newBlock(), join = myFn->newBlock();
+		emit(Op::Branch, join, cond, then);
+		myFn->place(then);
+		Stmts * stmts = ifStmt->stmts();
+		myFrames.push_back(Frame{stmts, stmts->begin(), join, join});
+		break;
+	}
+	case NodeKind::IfElse: {
+		IfElseStmtNode * ifElse = static_cast<IfElseStmtNode *>(stmt);
+		Operand cond = lowerExp(ifElse->exp());
+		Operand then = myFn->newBlock(), other = myFn->newBlock();
+		Operand join = myFn->newBlock();
+		emit(Op::Branch, other, cond, then);
+		myFn->place(then);
+		/* The else branch runs once the then branch has placed it */
+		Stmts * stmtsF = ifElse->stmtsF(), * stmtsT = ifElse->stmtsT();
+		myFrames.push_back(Frame{stmtsF, stmtsF->begin(), join, join});
+		myFrames.push_back(Frame{stmtsT, stmtsT->begin(), join, other});
+		break;
+	}
+	case NodeKind::While: {
+		WhileStmtNode * loop = static_cast<WhileStmtNode *>(stmt);
+		Operand head = myFn->newBlock(), body = myFn->newBlock();
+		Operand exit = myFn->newBlock();
+		jumpTo(head);
+		myFn->place(head);
+		Operand cond = lowerExp(loop->exp());
+		emit(Op::Branch, exit, cond, body);
+		myFn->place(body);
+		Stmts * stmts = loop->stmts();
+		myFrames.push_back(Frame{stmts, stmts->begin(), head, exit});
+		break;
+	}
+	default:
+		throw new InternalError("unexpected statement in a body");
+	}
+}
+
+Operand Lowering::lowerExp(ExpNode * exp){
+	myStack.push_back(Item{exp, Stage::Enter, Operand(), Operand()});
+	drain();
+	return pop();
+}
+
+void Lowering::lowerTarget(LValNode * lval){
+	myStack.push_back(Item{lval, Stage::Target, Operand(), Operand()});
+	drain();
+}
+
+void Lowering::drain(){
+	while (!myStack.empty()){
+		Item item = myStack.back();
+		myStack.pop_back();
+		if (item.stage == Stage::Enter){
+			enter(item.node);
+			continue;
+		}
+		if (item.stage != Stage::Target){
+			exit(item);
+			continue;
+		}
+		/* The address, but not yet the value, of an lvalue */
+		switch (item.node->kind()){
+		case NodeKind::Deref:
+			push(var(static_cast<DerefNode *>(item.node)->tgt()));
+			break;
+		case NodeKind::Index: {
+			IndexNode * index = static_cast<IndexNode *>(item.node);
+			push(var(index->tgt()));
+			myStack.push_back(Item{index, Stage::Aimed, Operand(), Operand()});
+			myStack.push_back(Item{index->off(), Stage::Enter, Operand(),
+				Operand()});
+			break;
+		}
+		default: /* A variable, whose quads name it directly */
+			break;
+		}
+	}
+}
+
+void Lowering::enter(ExpNode * node){
+	/* What to evaluate, in order, before exit */
+	ExpNode * operands[2] = { nullptr, nullptr };
+	Stage stage = Stage::Exit;
+	switch (node->kind()){
+	case NodeKind::ID:
+		push(var(static_cast<IDNode *>(node)));
+		return;
+	case NodeKind::IntLit:
+		push(myFn->intConst(static_cast<IntLitNode *>(node)->num()));
+		return;
+	case NodeKind::CharLit:
+		push(myFn->intConst(static_cast<unsigned char>(
+			static_cast<CharLitNode *>(node)->val())));
+		return;
+	case NodeKind::True:
+		push(myFn->intConst(1));
+		return;
+	case NodeKind::False:
+	case NodeKind::NullPtr:
+		push(myFn->intConst(0));
+		return;
+	case NodeKind::StrLit:
+		push(myOut.addString(static_cast<StrLitNode *>(node)->str()));
+		return;
+	case NodeKind::Deref:
+		push(temp(Op::Load, var(static_cast<DerefNode *>(node)->tgt()),
+			Operand(), node->type()->code()));
+		return;
+	case NodeKind::Ref:
+		push(temp(Op::Addr, var(static_cast<RefNode *>(node)->tgt())));
+		return;
+	case NodeKind::Index:
+		push(var(static_cast<IndexNode *>(node)->tgt()));
+		operands[0] = static_cast<IndexNode *>(node)->off();
+		break;
+	case NodeKind::AssignExp: {
+		AssignExpNode * assign = static_cast<AssignExpNode *>(node);
+		myStack.push_back(Item{node, Stage::Exit, Operand(), Operand()});
+		myStack.push_back(Item{assign->src(), Stage::Enter, Operand(),
+			Operand()});
+		myStack.push_back(Item{assign->tgt(), Stage::Target, Operand(),
+			Operand()});
+		return;
+	}
+	case NodeKind::CallExp: {
+		CallExpNode * call = static_cast<CallExpNode *>(node);
+		myStack.push_back(Item{node, Stage::Exit, Operand(), Operand()});
+		if (call->args() == nullptr){ return; }
+		/* Reversed, so the first argument is lowered first */
+		for (auto arg = call->args()->rbegin(); arg != call->args()->rend();
+			++arg){
+			myStack.push_back(Item{*arg, Stage::Enter, Operand(), Operand()});
+		}
+		return;
+	}
+	case NodeKind::And:
+	case NodeKind::Or:
+		operands[0] = static_cast<BinaryExpNode *>(node)->lhs();
+		stage = Stage::Middle;
+		break;
+	case NodeKind::Neg:
+	case NodeKind::Not:
+		operands[0] = static_cast<UnaryExpNode *>(node)->exp();
+		break;
+	default:
+		operands[0] = static_cast<BinaryExpNode *>(node)->lhs();
+		operands[1] = static_cast<BinaryExpNode *>(node)->rhs();
+		break;
+	}
+	myStack.push_back(Item{node, stage, Operand(), Operand()});
+	for (int i = 1; i >= 0; i--){
+		if (operands[i] != nullptr){
+			myStack.push_back(Item{operands[i], Stage::Enter, Operand(),
+				Operand()});
+		}
+	}
+}
+
+void Lowering::exit(const Item& item){
+	ExpNode * node = item.node;
+	switch (node->kind()){
+	case NodeKind::Index: {
+		Operand off = pop();
+		Operand base = pop();
+		int size = sizeOf(node->type()->code());
+		if (size != 1){ off = temp(Op::Mul, off, myFn->intConst(size)); }
+		Operand addr = temp(Op::Add, base, off);
+		if (item.stage == Stage::Aimed){
+			push(addr);
+		} else {
+			push(temp(Op::Load, addr, Operand(), node->type()->code()));
+		}
+		return;
+	}
+	case NodeKind::AssignExp: {
+		Operand src = pop();
+		settle();
+		assign(static_cast<AssignExpNode *>(node)->tgt(), src);
+		push(src);
+		return;
+	}
+	case NodeKind::CallExp: {
+		CallExpNode * call = static_cast<CallExpNode *>(node);
+		size_t count = call->args() == nullptr ? 0 : call->args()->size();
+		/* The arguments are the top count values, first one lowest */
+		for (size_t i = myValues.size() - count; i < myValues.size(); i++){
+			emit(Op::Arg, Operand(), myValues[i]);
+		}
+		myValues.resize(myValues.size() - count);
+		if (mySettled > myValues.size()){ mySettled = myValues.size(); }
+		settle();
+		Operand fn = var(call->id());
+		if (node->type()->code() == TypeCode::Void){
+			emit(Op::Call, Operand(), fn);
+			push(Operand());
+		} else {
+			push(temp(Op::Call, fn));
+		}
+		return;
+	}
+	case NodeKind::And:
+	case NodeKind::Or:
+		if (item.stage == Stage::Middle){
+			Operand lhs = pop();
+			settle();
+			Operand result = temp(Op::Copy, lhs);
+			Operand rhs = myFn->newBlock(), join = myFn->newBlock();
+			/* && needs the rhs when the lhs is true, || when it is false */
+			if (node->kind() == NodeKind::And){
+				emit(Op::Branch, join, result, rhs);
+			} else {
+				emit(Op::Branch, rhs, result, join);
+			}
+			myFn->place(rhs);
+			myStack.push_back(Item{node, Stage::Exit, result, join});
+			myStack.push_back(Item{static_cast<BinaryExpNode *>(node)->rhs(),
+				Stage::Enter, Operand(), Operand()});
+		} else {
+			emit(Op::Copy, item.temp, pop());
+			jumpTo(item.join);
+			myFn->place(item.join);
+			push(item.temp);
+		}
+		return;
+	case NodeKind::Neg:
+		push(temp(Op::Neg, pop()));
+		return;
+	case NodeKind::Not:
+		push(temp(Op::Not, pop()));
+		return;
+	default: {
+		Operand rhs = pop();
+		Operand lhs = pop();
+		push(temp(binaryOp(node->kind()), lhs, rhs));
+		return;
+	}
+	}
+}
+
+void Lowering::assign(LValNode * lval, Operand val){
+	switch (lval->kind()){
+	case NodeKind::ID:
+		emit(Op::Copy, var(static_cast<IDNode *>(lval)), val);
+		break;
+	case NodeKind::Deref:
+	case NodeKind::Index:
+		emit(Op::Store, pop(), val, Operand(), lval->type()->code());
+		break;
+	default: /* ^x, which the checker rejects as a target */
+		throw new InternalError("assignment to an address");
+	}
+}
+
+Operand Lowering::var(IDNode * id){
+	auto local = myLocals.find(id->decl());
+	if (local != myLocals.end()){ return local->second; }
+	auto global = myGlobals.find(id->decl());
+	if (global == myGlobals.end()){
+		throw new InternalError("lowering a name with no declaration");
+	}
+	return global->second;
+}
+
+void Lowering::emit(Op op, Operand dst, Operand a, Operand b, TypeCode type){
+	if (myFn->terminated()){ myFn->place(myFn->newBlock()); }
+	myFn->emit(op, dst, a, b, type);
+}
+
+void Lowering::jumpTo(Operand block){
+	if (!myFn->terminated()){ myFn->emit(Op::Jump, Operand(), block); }
+}
+
+Operand Lowering::temp(Op op, Operand a, Operand b, TypeCode type){
+	Operand dst = myFn->newTemp();
+	emit(op, dst, a, b, type);
+	return dst;
+}
+
+Operand Lowering::pop(){
+	Operand val = myValues.back();
+	myValues.pop_back();
+	if (mySettled > myValues.size()){ mySettled = myValues.size(); }
+	return val;
+}
+
+void Lowering::settle(){
+	/* Each value is looked at once, so this is linear overall */
+	for (size_t i = mySettled; i < myValues.size(); i++){
+		Operand::Kind kind = myValues[i].kind();
+		if (kind == Operand::Local || kind == Operand::Global){
+			myValues[i] = temp(Op::Copy, myValues[i]);
+		}
+	}
+	mySettled = myValues.size();
+}
+
+} //End namespace holeyc
@@ -0,0 +1,109 @@
+#ifndef HOLEYC_LOWER_HPP
+#define HOLEYC_LOWER_HPP
+
+#include <unordered_map>
+#include <vector>
+#include "ast.hpp"
+#include "ir.hpp"
+
+namespace holeyc{
+
+/**
+* \class Lowering
+* Translates a type-checked program into three-address code (-r).
+* Each function body becomes quads in basic blocks: && and ||
+* evaluate their rhs in a block of its own, reached only when the lhs
+* does not decide, and if, if-else and while become branches between
+* blocks. x[i], @p and ^x become address arithmetic, loads and
+* stores, with an int taking 8 bytes, a bool or char 1 and a pointer
+* 8. Code after a return lands in a block nothing jumps to.
+*
+* Operands are evaluated left to right. A variable an operand reads
+* is copied to a temporary before anything later in the expression
+* can change it, that is before a store, a call or a branch.
+*
+* Statements and expressions are walked with explicit stacks, and
+* every quad, block and edge is made in constant time, so time and
+* memory grow linearly with the program, however deep its nesting.
+**/
+class Lowering{
+public:
+	explicit Lowering(IRProgram& out)
+	: myOut(out), myFn(nullptr), mySettled(0){
+	}
+
+	/** Lower every function of program, which must have checked **/
+	void run(ProgramNode * program);
+
+private:
+	using Stmts = NodeList<StmtNode *>;
+	/**
+	* A statement list being lowered, the next statement in it, and
+	* where control goes once it is done: a jump to jump, if any, then
+	* the block place, if any, is placed
+	**/
+	struct Frame{
+		Stmts * stmts;
+		Stmts::iterator at;
+		Operand jump;
+		Operand place;
+	};
+	/**
+	* How far along an expression on the stack is: Enter and Exit
+	* compute its value, with Middle between the operands of && and
+	* ||; Target and Aimed compute the address an lvalue names
+	**/
+	enum class Stage : uint8_t{ Enter, Middle, Exit, Target, Aimed };
+	struct Item{
+		ExpNode * node;
+		Stage stage;
+		Operand temp; /// && and ||: the result
+		Operand join; /// && and ||: the block after the rhs
+	};
+
+	void lowerBody(FnDeclNode * fn);
+	/** Lower the statement at frame's cursor and move the cursor on **/
+	void lowerStmt(Frame& frame);
+	/** Emit exp's quads; returns the operand holding its value **/
+	Operand lowerExp(ExpNode * exp);
+	/** Push the address lval names, or nothing for a variable **/
+	void lowerTarget(LValNode * lval);
+	/** Run the expression stack until it is empty **/
+	void drain();
+	/** Push what node computes, or schedule its operands **/
+	void enter(ExpNode * node);
+	/** Compute item's node from its operands on the value stack **/
+	void exit(const Item& item);
+	/** After lowerTarget(lval): set lval to val **/
+	void assign(LValNode * lval, Operand val);
+
+	Operand var(IDNode * id);
+	/** Emit a quad, into a new block if the current one has ended **/
+	void emit(Op op, Operand dst, Operand a = Operand(),
+		Operand b = Operand(), TypeCode type = TypeCode::Unchecked);
+	void jumpTo(Operand block);
+	/** Emit op into a new temporary, which it returns **/
+	Operand temp(Op op, Operand a = Operand(), Operand b = Operand(),
+		TypeCode type = TypeCode::Unchecked);
+	void push(Operand val){ myValues.push_back(val); }
+	Operand pop();
+	/** Copy the variables on the value stack to temporaries **/
+	void settle();
+
+	IRProgram& myOut;
+	IRFunction * myFn;
+	/** Globals and functions **/
+	std::unordered_map<DeclNode *, Operand> myGlobals;
+	/** The current function's formals and locals **/
+	std::unordered_map<DeclNode *, Operand> myLocals;
+	std::vector<Frame> myFrames;
+	std::vector<Item> myStack;
+	/** Operands computed and not yet used **/
+	std::vector<Operand> myValues;
+	/** How many of myValues are known not to be variables **/
+	size_t mySettled;
+};
+
+} //End namespace holeyc
+
+#endif
@@ -1,183 +1,207 @@
 #include <iostream>
 #include <cstdlib>
 #include <cstring>
-#include <fstream>
+#include <thread>
+#include <vector>
 #include "errors.hpp"
-#include "scanner.hpp"
+#include "driver.hpp"
 
 using namespace holeyc;
 
 static void usageAndDie(){
-	std::cerr << "Usage: holeycc <infile> <options>\n"
+	std::cerr << "Usage: holeycc <infile>... <options>\n"
 	<< " [-u <unparseFile>]: Unparse to <unparseFile>\n"
+	<< " [-i <interfaceFile>]: Write only the declarations, without\n"
+	<< "    function bodies, to <interfaceFile>; bodies are not parsed\n"
+	<< " [-n <namesFile>]: Link each name to its declaration and unparse\n"
+	<< "    to <namesFile> with each name's type after it\n"
+	<< " [-c]: Check names and types; exits with status 1 if either\n"
+	<< "    check fails\n"
+	<< " [-f]: Fold constants and prune code that cannot run, once\n"
+	<< "    types check (as -c); -u and -n show the folded program\n"
+	<< " [-r <irFile>]: Once types check (as -c), lower each function\n"
+	<< "    to three-address code in basic blocks and write it to <irFile>\n"
 	<< " [-p]: Parse the input to check syntax\n"
+	<< " [-v]: Only check syntax, building no tokens or AST;\n"
+	<< "    exits with status 1 if the input does not parse\n"
 	<< " [-t <tokensFile>]: Output tokens to <tokensFile>\n"
+	<< " [-k <tokenFile>]: Write tokens to <tokenFile> in binary form;\n"
+	<< "    an input that is such a file is parsed without lexing\n"
+	<< " [-l]: Lex on a second thread, running ahead of the parser\n"
+	<< " [-P <threads>]: Parse each large file in chunks of top-level\n"
+	<< "    declarations, and check its functions for -n/-c, on\n"
+	<< "    <threads> threads\n"
+	<< " [-s]: Stream: write each declaration for -u/-i as soon as it\n"
+	<< "    is parsed, then free it, so memory stays bounded. After a\n"
+	<< "    syntax error, the declarations before it are still written\n"
+	<< " [-D <depth>]: Reject input nested so deeply that the parser's\n"
+	<< "    stack would pass <depth> entries\n"
+	<< " [-h]: Build each repeated side-effect-free subexpression once\n"
+	<< "    and share it; -m reports the nodes saved. Not with -n, -c,\n"
+	<< "    -f or -r\n"
+	<< " [-m <statsFile>]: Write AST memory usage to <statsFile>\n"
+	<< " [-C <cacheDir>]: Reuse ASTs cached in <cacheDir> for -p/-u\n"
+	<< " [-b <manifest>]: Also compile every file listed in <manifest>\n"
+	<< " [-j <workers>]: Compile inputs on <workers> threads\n"
+	<< " [-e <max>]: Show at most <max> errors per file\n"
+	<< " [-d <text|json>]: Diagnostics format (json: one object per line)\n"
+	<< "With more than one input (or -b/-j), output paths are suffixes\n"
+	<< "appended to each input's name, and -- writes all of them to\n"
+	<< "stdout in input order\n"
 	;
 	exit(1);
 }
 
-static void writeTokenStream(const char * inPath, const char * outPath){
-	std::ifstream inStream(inPath);
-	if (!inStream.good()){
-		std::string msg = "Bad input stream";
-		msg += inPath;
-		throw new InternalError(msg.c_str());
-	}
-	if (outPath == nullptr){
-		std::string msg = "No tokens output file given";
-		throw new InternalError(msg.c_str());
-	}
-
-	Scanner scanner(&inStream);
-	if (strcmp(outPath, "--") == 0){
-		scanner.outputTokens(std::cout);
-	} else {
-		std::ofstream outStream(outPath);
-		if (!outStream.good()){
-			std::string msg = "Bad output file ";
-			msg += outPath;
-			throw new InternalError(msg.c_str());
-		}
-		scanner.outputTokens(outStream);
-		outStream.close();
-	}
-}
-
-static bool parse(const char * inFile){
-	std::ifstream inStream(inFile);
-	if (!inStream.good()){
-		std::string msg = "Bad input stream ";
-		msg += inFile;
-		throw new InternalError(msg.c_str());
-	}
-
-	holeyc::ProgramNode * root = nullptr;
-	holeyc::Scanner scanner(&inStream);
-	holeyc::Parser parser(scanner, &root);
-	int errCode = parser.parse();
-	if (errCode != 0){ return false; }
-
-	return true;
-}
-
-static holeyc::ProgramNode * syntacticAnalysis(const char * inFile){
-	std::ifstream inStream(inFile);
-	if (!inStream.good()){
-		std::string msg = "Bad input stream ";
-		msg += inFile;
-		throw new InternalError(msg.c_str());
-	}
-
-	holeyc::ProgramNode * root = nullptr;
-	holeyc::Scanner scanner(&inStream);
-	holeyc::Parser parser(scanner, &root);
-	int errCode = parser.parse();
-	if (errCode != 0){ return nullptr; }
-
-	return root;
-}
-
-static void doUnparsing(holeyc::ProgramNode * ast, const char * outPath){
-	if (outPath == nullptr){ 
-		std::cerr << "No output path\n"; 
-		return;
-	}
-
-	if (strcmp(outPath, "--") == 0){
-		ast->unparse(std::cout, 0);
-	} else {
-		std::ofstream outStream(outPath);
-		if (!outStream.good()){
-			std::string msg = "Bad output file ";
-			msg += outPath;
-			throw new holeyc::InternalError(msg.c_str());
-		}
-		ast->unparse(outStream, 0);
-	}
-}
-
 int 
 main( const int argc, const char **argv )
 {
 	if (argc == 0){
 		usageAndDie();
 	}
-	const char * inFile = NULL;
-	const char * tokensFile = NULL;
-	bool checkParse = false;
-	const char * unparseFile = NULL;
+	std::vector<const char *> inFiles;
+	const char * manifest = NULL;
+	unsigned workers = 0;
+	bool batch = false;
+	CompileOptions opts;
 	bool useful = false;
-	int i = 1;
 	for (int i = 1 ; i < argc ; i++){
 		if (argv[i][0] == '-'){
 			if (argv[i][1] == 't'){
 				i++;
-				tokensFile = argv[i];
+				opts.tokensFile = argv[i];
+				useful = true;
+			} else if (argv[i][1] == 'k'){
+				i++;
+				opts.binTokensFile = argv[i];
 				useful = true;
 			} else if (argv[i][1] == 'p'){
-				checkParse = true;
+				opts.checkParse = true;
+				useful = true;
+			} else if (argv[i][1] == 'v'){
+				opts.validate = true;
 				useful = true;
 			} else if (argv[i][1] == 'u'){
 				i++;
-				unparseFile = argv[i];
+				opts.unparseFile = argv[i];
+				useful = true;
+			} else if (argv[i][1] == 'i'){
+				i++;
+				opts.interfaceFile = argv[i];
+				useful = true;
+			} else if (argv[i][1] == 'c'){
+				opts.checkTypes = true;
+				useful = true;
+			} else if (argv[i][1] == 'f'){
+				opts.fold = true;
+				useful = true;
+			} else if (argv[i][1] == 'r'){
+				i++;
+				opts.irFile = argv[i];
+				useful = true;
+			} else if (argv[i][1] == 'n'){
+				i++;
+				opts.namesFile = argv[i];
 				useful = true;
+			} else if (argv[i][1] == 'l'){
+				opts.lexThread = true;
+			} else if (argv[i][1] == 's'){
+				opts.stream = true;
+			} else if (argv[i][1] == 'P'){
+				i++;
+				if (argv[i] == NULL || atoi(argv[i]) <= 0){
+					std::cerr << "-P needs a positive thread count\n";
+					usageAndDie();
+				}
+				opts.parseThreads = static_cast<unsigned>(atoi(argv[i]));
+			} else if (argv[i][1] == 'D'){
+				i++;
+				if (argv[i] == NULL || atoi(argv[i]) <= 0){
+					std::cerr << "-D needs a positive depth\n";
+					usageAndDie();
+				}
+				opts.depthLimit = static_cast<size_t>(atoi(argv[i]));
+			} else if (argv[i][1] == 'h'){
+				opts.hashCons = true;
+			} else if (argv[i][1] == 'm'){
+				i++;
+				opts.statsFile = argv[i];
+			} else if (argv[i][1] == 'C'){
+				i++;
+				opts.cacheDir = argv[i];
+			} else if (argv[i][1] == 'b'){
+				i++;
+				manifest = argv[i];
+				batch = true;
+			} else if (argv[i][1] == 'j'){
+				i++;
+				if (argv[i] == NULL || atoi(argv[i]) <= 0){
+					std::cerr << "-j needs a positive worker count\n";
+					usageAndDie();
+				}
+				workers = static_cast<unsigned>(atoi(argv[i]));
+				batch = true;
+			} else if (argv[i][1] == 'e'){
+				i++;
+				if (argv[i] == NULL || atoi(argv[i]) <= 0){
+					std::cerr << "-e needs a positive error count\n";
+					usageAndDie();
+				}
+				opts.errorLimit = static_cast<size_t>(atoi(argv[i]));
+			} else if (argv[i][1] == 'd'){
+				i++;
+				if (argv[i] != NULL && strcmp(argv[i], "json") == 0){
+					opts.diagFormat = DiagFormat::JSON;
+				} else if (argv[i] != NULL && strcmp(argv[i], "text") == 0){
+					opts.diagFormat = DiagFormat::Text;
+				} else {
+					std::cerr << "-d takes text or json\n";
+					usageAndDie();
+				}
 			} else {
 				std::cerr << "Unrecognized argument: ";
 				std::cerr << argv[i] << std::endl;
 				usageAndDie();
 			}
 		} else {
-			if (inFile == NULL){
-				inFile = argv[i];
-			} else {
-				std::cerr << "Only 1 input file allowed";
-				std::cerr << argv[i] << std::endl;
-				usageAndDie();
-			}
+			inFiles.push_back(argv[i]);
 		}
 	}
-	if (inFile == nullptr){
+	if (inFiles.size() > 1){
+		batch = true;
+	}
+	if (inFiles.empty() && manifest == nullptr){
 		usageAndDie();
 	}
 	if (!useful){
 		std::cerr << "Whoops, you didn't tell holeycc what to do!\n";
 		usageAndDie();
 	}
-
-	if (tokensFile != nullptr){
-		try {
-			writeTokenStream(inFile, tokensFile);
-		} catch (InternalError * e){
-			std::cerr << "Error: " << e->msg() << std::endl;
-		}
+	/* A shared node has one position, its first occurrence's, so
+	   errors in the others could not be reported where they are */
+	if (opts.hashCons && (opts.namesFile != nullptr || opts.checkTypes
+		|| opts.fold || opts.irFile != nullptr)){
+		std::cerr << "-h cannot be used with -n, -c, -f or -r\n";
+		exit(1);
 	}
 
-	if (checkParse){
-		try {
-			bool parsed = parse(inFile);
-			if (!parsed){
-				std::cerr << "Parse failed";
-			}
-		} catch (ToDoError * e){
-			std::cerr << "ToDo: " << e->msg() << std::endl;
-			exit(1);
-		}
+	if (!batch){
+		return compileFile(inFiles[0], opts);
 	}
 
-	if (unparseFile != nullptr){
+	if (workers == 0){
+		workers = std::thread::hardware_concurrency();
+	}
+	BatchDriver driver(opts, workers);
+	for (const char * inFile : inFiles){
+		driver.addInput(inFile);
+	}
+	if (manifest != nullptr){
 		try {
-			ProgramNode * ast = syntacticAnalysis(inFile);
-			if (ast){
-				doUnparsing(ast, unparseFile);
-			}
+			driver.addManifest(manifest);
 		} catch (InternalError * e){
 			std::cerr << "Error: " << e->msg() << std::endl;
 			exit(1);
-		} catch (ToDoError * e){
-			std::cerr << "ToDo: " << e->msg() << std::endl;
-			exit(1);
 		}
 	}
-	
-	return 0;
+	return driver.run();
 }
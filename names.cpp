@@ -0,0 +1,262 @@
+#include "names.hpp"
+#include "errors.hpp"
+#include "visitor.hpp"
+
+namespace holeyc{
+
+/* No interned name gets this many symbols */
+static const Symbol EMPTY_SLOT = UINT32_MAX;
+static const size_t FIRST_SLOTS = 64;
+
+ScopeTable::ScopeTable()
+: mySlots(FIRST_SLOTS, Slot{EMPTY_SLOT, 0, nullptr}), myUsed(0){
+}
+
+/* Fibonacci hashing: the high bits of name times 2^64 / phi spread
+   runs of nearby symbols over the whole table */
+size_t ScopeTable::probe(Symbol name) const{
+	size_t mask = mySlots.size() - 1;
+	size_t at = (static_cast<size_t>(name) * 0x9E3779B97F4A7C15ULL >> 32)
+		& mask;
+	while (mySlots[at].name != name && mySlots[at].name != EMPTY_SLOT){
+		at = (at + 1) & mask;
+	}
+	return at;
+}
+
+void ScopeTable::grow(){
+	std::vector<Slot> old(mySlots.size() * 2, Slot{EMPTY_SLOT, 0, nullptr});
+	old.swap(mySlots);
+	for (const Slot& slot : old){
+		if (slot.name != EMPTY_SLOT){ mySlots[probe(slot.name)] = slot; }
+	}
+}
+
+void ScopeTable::enter(){
+	myMarks.push_back(myLog.size());
+}
+
+void ScopeTable::exit(){
+	if (myMarks.empty()){
+		throw new InternalError("left a scope that was never entered");
+	}
+	size_t mark = myMarks.back();
+	myMarks.pop_back();
+	while (myLog.size() > mark){
+		const Undo& undo = myLog.back();
+		Slot& slot = mySlots[probe(undo.name)];
+		slot.depth = undo.depth;
+		slot.decl = undo.decl;
+		myLog.pop_back();
+	}
+}
+
+void ScopeTable::bind(Symbol name, DeclNode * decl){
+	size_t at = probe(name);
+	if (mySlots[at].name == EMPTY_SLOT){
+		if (2 * (myUsed + 1) > mySlots.size()){
+			grow();
+			at = probe(name);
+		}
+		mySlots[at] = Slot{name, 0, nullptr};
+		myUsed++;
+	}
+	Slot& slot = mySlots[at];
+	myLog.push_back(Undo{name, slot.depth, slot.decl});
+	slot.depth = static_cast<uint32_t>(myMarks.size());
+	slot.decl = decl;
+}
+
+DeclNode * ScopeTable::find(Symbol name) const{
+	return mySlots[probe(name)].decl;
+}
+
+DeclNode * ScopeTable::findLocal(Symbol name) const{
+	const Slot& slot = mySlots[probe(name)];
+	return slot.depth == myMarks.size() ? slot.decl : nullptr;
+}
+
+/*
+Each visit schedules the node's children, and the scopes around them,
+in the order they are to be analyzed; analyzeBody() then takes them
+from its stack. Expressions only hold uses, declarations only bind.
+*/
+class NameAnalysis::Step : public ASTVisitor<Step>{
+public:
+	explicit Step(NameAnalysis& pass) : myPass(pass){ }
+
+	/* Locals and formals; globals are bound by declareGlobals */
+	void visitVarDecl(VarDeclNode * node){
+		myPass.declare(myPass.myScopes, node, node->id(),
+			node->type()->kind() == NodeKind::VoidType);
+	}
+	/* The body of the function being analyzed, in its scope */
+	void visitFnDecl(FnDeclNode * node){
+		for (auto formal : *node->formals()->formals()){ child(formal); }
+		stmts(node->body()->stmts()->stmts());
+	}
+
+	void visitAssignStmt(AssignStmtNode * node){ child(node->assign()); }
+	void visitCallStmt(CallStmtNode * node){ child(node->callExp()); }
+	void visitFromConsole(FromConsoleStmtNode * node){ child(node->val()); }
+	void visitToConsole(ToConsoleStmtNode * node){ child(node->exp()); }
+	void visitPostInc(PostIncStmtNode * node){ child(node->exp()); }
+	void visitPostDec(PostDecStmtNode * node){ child(node->exp()); }
+	void visitReturn(ReturnStmtNode * node){
+		if (node->exp() != nullptr){ child(node->exp()); }
+	}
+	void visitIf(IfStmtNode * node){
+		child(node->exp());
+		block(node->stmts());
+	}
+	void visitIfElse(IfElseStmtNode * node){
+		child(node->exp());
+		block(node->stmtsT());
+		block(node->stmtsF());
+	}
+	void visitWhile(WhileStmtNode * node){
+		child(node->exp());
+		block(node->stmts());
+	}
+
+	void visitAssignExp(AssignExpNode * node){
+		child(node->tgt());
+		child(node->src());
+	}
+	void visitCallExp(CallExpNode * node){
+		child(node->id());
+		if (node->args() != nullptr){
+			for (auto arg : *node->args()){ child(arg); }
+		}
+	}
+	void visitBinaryExp(BinaryExpNode * node){
+		child(node->lhs());
+		child(node->rhs());
+	}
+	void visitUnaryExp(UnaryExpNode * node){ child(node->exp()); }
+	void visitDeref(DerefNode * node){ child(node->tgt()); }
+	void visitRef(RefNode * node){ child(node->tgt()); }
+	void visitIndex(IndexNode * node){
+		child(node->tgt());
+		child(node->off());
+	}
+	void visitID(IDNode * node){ myPass.use(node); }
+
+	/* Literals, and types, which hold no names */
+	void visitNode(ASTNode *){ }
+
+private:
+	void child(ASTNode * node){
+		myPass.myFrame.push_back(Item{Item::NODE, node});
+	}
+	void scope(Item::Kind kind){
+		myPass.myFrame.push_back(Item{kind, nullptr});
+	}
+	void stmts(NodeList<StmtNode *> * list){
+		for (auto stmt : *list){ child(stmt); }
+	}
+	void block(NodeList<StmtNode *> * list){
+		scope(Item::ENTER);
+		stmts(list);
+		scope(Item::EXIT);
+	}
+
+	NameAnalysis& myPass;
+};
+
+bool NameAnalysis::run(ProgramNode * program){
+	bool ok = declareGlobals(program);
+	for (auto global : *program->globals()){
+		if (global->kind() == NodeKind::FnDecl){
+			ok = analyzeBody(static_cast<FnDeclNode *>(global)) && ok;
+		}
+	}
+	return ok;
+}
+
+bool NameAnalysis::declareGlobals(ProgramNode * program){
+	myOk = true;
+	myGlobals.enter();
+	for (auto global : *program->globals()){
+		if (global->kind() == NodeKind::FnDecl){
+			FnDeclNode * fn = static_cast<FnDeclNode *>(global);
+			declare(myGlobals, fn, fn->id(), false);
+		} else {
+			VarDeclNode * var = static_cast<VarDeclNode *>(global);
+			declare(myGlobals, var, var->id(),
+				var->type()->kind() == NodeKind::VoidType);
+		}
+	}
+	return myOk;
+}
+
+bool NameAnalysis::analyzeBody(FnDeclNode * fn){
+	myOk = true;
+	myFn = fn;
+	Step step(*this);
+	/* Formals and the top of the body share the function's scope */
+	myStack.push_back(Item{Item::EXIT, nullptr});
+	myStack.push_back(Item{Item::NODE, fn});
+	myStack.push_back(Item{Item::ENTER, nullptr});
+	while (!myStack.empty()){
+		Item item = myStack.back();
+		myStack.pop_back();
+		switch (item.kind){
+		case Item::NODE:
+			/* A shared node means the same thing wherever it occurs */
+			if (item.node->shared() && !mySeen.insert(item.node).second){
+				break;
+			}
+			step.visit(item.node);
+			/* Reversed, so the first scheduled item is on top */
+			myStack.insert(myStack.end(), myFrame.rbegin(), myFrame.rend());
+			myFrame.clear();
+			break;
+		case Item::ENTER: myScopes.enter(); break;
+		case Item::EXIT: myScopes.exit(); break;
+		}
+	}
+	/* Expressions are shared only within a function */
+	mySeen.clear();
+	return myOk;
+}
+
+void NameAnalysis::declare(ScopeTable& scopes, DeclNode * decl, IDNode * id,
+	bool isVoid){
+	bool ok = true;
+	if (isVoid){
+		report(id, DiagCode::BadDeclType);
+		ok = false;
+	}
+	if (scopes.findLocal(id->symbol()) != nullptr){
+		report(id, DiagCode::MultiDecl);
+		ok = false;
+	}
+	if (ok){
+		scopes.bind(id->symbol(), decl);
+		id->link(decl);
+	}
+}
+
+void NameAnalysis::use(IDNode * id){
+	DeclNode * decl = myScopes.find(id->symbol());
+	if (decl == nullptr){
+		/* Globals are bound once and for all, so one declared after
+		   this function must be hidden from it by position */
+		decl = myGlobals.find(id->symbol());
+		if (decl != nullptr && decl->pos() > myFn->pos()){ decl = nullptr; }
+	}
+	if (decl == nullptr){
+		report(id, DiagCode::UndeclaredID);
+	}
+	id->link(decl);
+}
+
+void NameAnalysis::report(IDNode * id, DiagCode code){
+	size_t line, col;
+	myLines.locate(id->pos(), line, col);
+	Report::fatal(line, col, code);
+	myOk = false;
+}
+
+} //End namespace holeyc
@@ -0,0 +1,128 @@
+#ifndef HOLEYC_NAMES_HPP
+#define HOLEYC_NAMES_HPP
+
+#include <unordered_set>
+#include <vector>
+#include "ast.hpp"
+#include "diagnostics.hpp"
+#include "source.hpp"
+
+namespace holeyc{
+
+/**
+* \class ScopeTable
+* The declarations in scope, as one flat open-addressing table keyed
+* by Symbol rather than a map per scope: a lookup is one probe
+* sequence however deeply scopes nest. Binding a name that is already
+* in scope overwrites its slot and logs what was there; leaving a
+* scope replays the log back to where the scope began. Slots are
+* never freed, so a name's slot stays put once made and the table
+* only grows with the number of distinct names.
+**/
+class ScopeTable{
+public:
+	ScopeTable();
+
+	void enter();
+	/** Leave the innermost scope, uncovering what its names shadowed **/
+	void exit();
+	/** Scopes entered and not yet left **/
+	size_t depth() const { return myMarks.size(); }
+
+	/** Bind name to decl in the innermost scope **/
+	void bind(Symbol name, DeclNode * decl);
+	/** The declaration of name in scope, or nullptr **/
+	DeclNode * find(Symbol name) const;
+	/** As find, but only if it was declared in the innermost scope **/
+	DeclNode * findLocal(Symbol name) const;
+
+private:
+	struct Slot{
+		Symbol name;
+		uint32_t depth; /// Of the scope decl was bound in
+		DeclNode * decl; /// nullptr while name is unbound
+	};
+	/** A slot as it was before a bind **/
+	struct Undo{
+		Symbol name;
+		uint32_t depth;
+		DeclNode * decl;
+	};
+
+	/** name's slot, or the empty slot where it would go **/
+	size_t probe(Symbol name) const;
+	void grow();
+
+	std::vector<Slot> mySlots; /// A power of two, at most half full
+	size_t myUsed;
+	std::vector<Undo> myLog;
+	/** Where each open scope's entries in myLog begin **/
+	std::vector<size_t> myMarks;
+};
+
+/**
+* \class NameAnalysis
+* Links every IDNode of a program to the declaration it names (see
+* IDNode::decl), reporting undeclared names, names declared twice in
+* one scope and variables declared void. Globals and functions share
+* the outermost scope; a function's formals and the top of its body
+* share a scope; each if, else and while body opens one more. A
+* function's name is in scope in its own body.
+*
+* It runs in two phases. declareGlobals binds the top-level names, in
+* order, into a table of globals. After that each function body can be
+* analyzed on its own, against the globals declared before it, so
+* bodies may be analyzed on several threads at once: each thread uses
+* its own NameAnalysis (the scratch tables and stacks of one body are
+* reused for the next), all sharing the one table of globals.
+*
+* The walk keeps its own stack, so it takes any depth of nesting, and
+* it visits a node shared under -h only once.
+**/
+class NameAnalysis{
+public:
+	/** lines resolves the positions of the diagnostics **/
+	explicit NameAnalysis(const LineTable& lines)
+	: myLines(lines), myGlobals(myOwnGlobals){ }
+	/** Share globals, which declareGlobals fills, with other passes **/
+	NameAnalysis(const LineTable& lines, ScopeTable& globals)
+	: myLines(lines), myGlobals(globals){ }
+
+	/** Both phases, on this thread; false if any diagnostic was reported **/
+	bool run(ProgramNode * program);
+	/** Bind program's globals; false if any was misdeclared **/
+	bool declareGlobals(ProgramNode * program);
+	/** Link the names in fn's body; false if any was reported **/
+	bool analyzeBody(FnDeclNode * fn);
+
+private:
+	class Step;
+	/** A node to visit, or a scope to enter or leave **/
+	struct Item{
+		enum Kind{ NODE, ENTER, EXIT } kind;
+		ASTNode * node;
+	};
+
+	/** Bind id in scopes, unless it is void or already declared there **/
+	void declare(ScopeTable& scopes, DeclNode * decl, IDNode * id,
+		bool isVoid);
+	void use(IDNode * id);
+	void report(IDNode * id, DiagCode code);
+
+	const LineTable& myLines;
+	ScopeTable myOwnGlobals; /// Unless constructed with a shared table
+	ScopeTable& myGlobals;
+	/** The scopes within the function being analyzed **/
+	ScopeTable myScopes;
+	FnDeclNode * myFn;
+	std::vector<Item> myStack;
+	/** What the node being visited has scheduled, in order **/
+	std::vector<Item> myFrame;
+	/** Shared nodes already visited **/
+	std::unordered_set<ASTNode *> mySeen;
+	bool myOk;
+};
+
+} //End namespace holeyc
+
+#endif
@@ -1,4 +1,4 @@
-#include <fstream>
+#include <cstring>
 #include "scanner.hpp"
 
 using namespace holeyc;
@@ -6,20 +6,18 @@ using namespace holeyc;
 using TokenKind = holeyc::Parser::token;
 using Lexeme = holeyc::Parser::semantic_type;
 
-void Scanner::outputTokens(std::ostream& outstream){
-	Lexeme lexeme;
-	int tokenKind;
-	while(true){
-		tokenKind = this->yylex(&lexeme);
-		if (tokenKind == TokenKind::END){
-			outstream << "EOF" 
-			  << " [" << this->lineNum 
-			  << "," << this->colNum << "]"
-			  << std::endl;
-			return;
-		} else {
-			outstream << lexeme.transToken->toString()
-			  << std::endl;
-		}
+int TokenRecorder::yylex(Lexeme * const lval){
+	int tokenKind = myInner.yylex(lval);
+	myTokens.push_back(lval->transToken);
+	return tokenKind;
+}
+
+int Scanner::LexerInput(char * buf, int max_size){
+	size_t count = static_cast<size_t>(myMemEnd - myMem);
+	if (count > static_cast<size_t>(max_size)){
+		count = static_cast<size_t>(max_size);
 	}
+	memcpy(buf, myMem, count);
+	myMem += count;
+	return static_cast<int>(count);
 }
@@ -5,20 +5,96 @@
 #include <FlexLexer.h>
 #endif
 
+#include <climits>
+#include <utility>
+#include <vector>
 #include "grammar.hh"
 #include "errors.hpp"
+#include "arena.hpp"
+#include "source.hpp"
+#include "chunks.hpp"
 
 using TokenKind = holeyc::Parser::token;
 
 namespace holeyc{
 
-class Scanner : public yyFlexLexer{
+/**
+* Anything the Parser can pull tokens from. Every call stores the
+* token object in lval->transToken and returns its kind; the END
+* token carries the end-of-file position. A source put in scan-only
+* mode may store nullptr instead, recording just the position.
+* Positions are offsets into the source that lines() describes.
+**/
+class TokenSource{
+public:
+   explicit TokenSource(const LineTable& lines)
+   : myLines(&lines), myLastPos(0), myDepthLimit(0){ }
+   virtual ~TokenSource(){ }
+   virtual int yylex(holeyc::Parser::semantic_type * const lval) = 0;
+
+   /**
+   * Stop building token objects: only kinds and positions are
+   * needed (see CompilationSession::validate). Sources that cannot
+   * skip them ignore this.
+   **/
+   virtual void scanOnly(){ }
+
+   /**
+   * Hand each top-level function body to the parser as one LAZYBODY
+   * token instead of scanning it (see LazyBodyToken). Sources that
+   * cannot ignore this.
+   **/
+   virtual void lazyBodies(){ }
+
+   /** What the parser calls: yylex, remembering where the token was **/
+   int next(holeyc::Parser::semantic_type * const lval){
+	int kind = yylex(lval);
+	if (lval->transToken != nullptr){ mark(lval->transToken->pos()); }
+	return kind;
+   }
+
+   /**
+   * Let a parser reading this source grow its stack to at most depth
+   * entries (a few per level of nesting); 0, the default, is no
+   * limit. The parser checks before it takes each token.
+   **/
+   void limitDepth(size_t depth){ myDepthLimit = depth; }
+   bool tooDeep(size_t depth) const {
+	return myDepthLimit != 0 && depth > myDepthLimit;
+   }
+
+   const LineTable& lines() const { return *myLines; }
+   /** Position of the most recent token handed to the parser (its lookahead) **/
+   SourcePos lastPos() const { return myLastPos; }
+protected:
+   void mark(SourcePos pos){ myLastPos = pos; }
+private:
+   const LineTable * myLines;
+   SourcePos myLastPos;
+   size_t myDepthLimit;
+};
+
+class Scanner : public yyFlexLexer, public TokenSource{
 public:
    
-   Scanner(std::istream *in) : yyFlexLexer(in)
+   /**
+   * Scan a SourceFile. It must outlive every token and node built
+   * from it: ID and string lexemes are views into its buffer.
+   **/
+   Scanner(SourceFile& src, Arena& arena)
+   : Scanner(src.data(), src.lines(), arena, 0, src.size()){ }
+
+   /**
+   * Scan just bytes [begin, end) of the source buffer base, whose
+   * lines are lines. Positions are reported as in the whole file.
+   **/
+   Scanner(const char * base, const LineTable& lines, Arena& arena,
+     size_t begin, size_t end)
+   : yyFlexLexer(nullptr), TokenSource(lines), myArena(arena),
+     myBase(base), myMem(base + begin), myMemEnd(base + end),
+     myOffset(begin), myTokStart(begin), myScanOnly(false),
+     myLazyBodies(false), myEofAtLineStart(false)
    {
-	lineNum = 1;
-	colNum = 1;
    };
    virtual ~Scanner() {
    };
@@ -27,93 +103,205 @@ public:
    using FlexLexer::yylex;
 
    // YY_DECL defined in the flex holeyc.l
-   virtual int yylex( holeyc::Parser::semantic_type * const lval);
+   virtual int yylex( holeyc::Parser::semantic_type * const lval) override;
+
+   void scanOnly() override { myScanOnly = true; }
+   void lazyBodies() override { myLazyBodies = true; }
 
    int makeBareToken(int tagIn){
-        this->yylval->transToken = new Token(
-	  this->lineNum, this->colNum, tagIn);
-        colNum += static_cast<size_t>(yyleng);
+	emit<Token>(tagIn);
         return tagIn;
    }
 
-   int makeCharLitToken(const std::string text){
-	char val;
-	if (text.length() == 2){
-		val = text.c_str()[1];
-	} else if (text == "'\\t"){
-		val = '\t';
-	} else if (text == "'\\n"){
-		val = '\n';
-	} else if (text == "'\\\\"){
-		val = '\\';
-	} else {
-		val = text.c_str()[1];
+   int makeEOFToken(){
+	myTokStart = myOffset;
+	if (myEofAtLineStart){
+		myTokStart = lines().lineStart(lines().line(pos()));
+	}
+	emit<Token>(TokenKind::END);
+	return TokenKind::END;
+   }
+
+   /** text is the literal from its quote on, NUL-terminated **/
+   int makeCharLitToken(const char * text){
+	char val = text[1];
+	if (text[1] == '\\'){
+		switch (text[2]){
+		case 't': val = '\t'; break;
+		case 'n': val = '\n'; break;
+		case '\\': val = '\\'; break;
+		default: break;
+		}
 	}
-	this->yylval->transToken = new CharLitToken(
-		this->lineNum, this->colNum, val);
-	colNum += static_cast<size_t>(yyleng);
+	emit<CharLitToken>(val);
 	return TokenKind::CHARLIT;
    }
 
-   void errIllegal(size_t l, size_t c, std::string match){
-	Report::fatal(l, c, "Illegal character "
-		+ match);
+   int makeIDToken(){
+	/* Nothing reads the name in scan-only mode; skip interning it */
+	if (myScanOnly){
+		emit<Token>(TokenKind::ID);
+	} else {
+		emit<IDToken>(Interner::intern(lexeme()));
+	}
+	return TokenKind::ID;
+   }
+
+   int makeIntLitToken(){
+	int intVal;
+	if (!parseIntLit(yytext, static_cast<size_t>(yyleng), intVal)){
+		errIntOverflow();
+		intVal = INT_MAX;
+	}
+	emit<IntLitToken>(intVal);
+	return TokenKind::INTLITERAL;
    }
 
-   void errChrEscEmpty(size_t l, size_t c){
-	Report::fatal(l, c, "Empty escape sequence in"
-	" character literal");
+   int makeStrToken(){
+	emit<StrToken>(lexeme());
+	return TokenKind::STRLITERAL;
    }
 
-   void errChrEmpty(size_t l, size_t c){
-	Report::fatal(l, c, "Empty character literal");
+   /**
+   * Lazy mode, at a '{' (always a function body's, as the body's own
+   * braces are skipped with it): match it by brace depth and hand
+   * the parser the whole body as one token. The scan then resumes
+   * past the body, without flex reading it (see skipTo).
+   **/
+   int makeLazyBodyToken(){
+	size_t size = static_cast<size_t>(myMemEnd - myBase);
+	size_t end = matchBrace(myBase, size, myTokStart);
+	emit<LazyBodyToken>(myBase, lines(), myTokStart, end, myArena);
+	skipTo(end);
+	return TokenKind::LAZYBODY;
    }
 
-   void errChrEsc(size_t l, size_t c){
-	Report::fatal(l, c, "Bad escape sequence in"
-	" char literal");
+   /**
+   * Go on scanning from source offset to: flex's buffer is dropped
+   * and refilled from there, as LexerInput reads straight from the
+   * source. Only for the action that returns the current token.
+   **/
+   void skipTo(size_t to){
+	myOffset = to;
+	myMem = myBase + to;
+	yyrestart(nullptr);
    }
 
-   void errStrEsc(size_t l, size_t c){
-	Report::fatal(l, c, "String literal with bad"
-	" escape sequence ignored");
-	
+   /** The current match, viewed in place in the source buffer **/
+   StrRef lexeme() const {
+	return StrRef(myBase + myTokStart, static_cast<size_t>(yyleng));
    }
 
-   void errStrUnterm(size_t l, size_t c){
-	Report::fatal(l, c, "Unterminated string"
-	" literal ignored");
-	
+   /**
+   * Decimal literal in one pass. Like the old stod/strlen check it
+   * overflows on values above INT_MAX or on more than 10 digits.
+   **/
+   static bool parseIntLit(const char * text, size_t len, int& out){
+	if (len > 10){ return false; }
+	long long val = 0;
+	for (size_t i = 0; i < len; i++){
+		val = val * 10 + (text[i] - '0');
+	}
+	if (val > INT_MAX){ return false; }
+	out = static_cast<int>(val);
+	return true;
    }
 
-   void errStrEscAndUnterm(size_t l, size_t c){
-	Report::fatal(l, c, "Unterminated string literal"
-	"  with bad escape sequence ignored");
+   /* Lexical errors, reported at the start of the current match */
+   void errIllegal(std::string match){
+	fatalHere(DiagCode::IllegalChar, match);
    }
 
-   void errIntOverflow(size_t l, size_t c){
-	Report::fatal(l, c, "Integer literal too large;"
-	"  using max value");
+   void errChrEscEmpty(){ fatalHere(DiagCode::EmptyCharEscape); }
+
+   void errChrEmpty(){ fatalHere(DiagCode::EmptyChar); }
+
+   void errChrEsc(){ fatalHere(DiagCode::BadCharEscape); }
+
+   void errStrEsc(){ fatalHere(DiagCode::BadStrEscape); }
+
+   /** An unterminated string runs to the end of the line; an END
+       right after it is reported at that line's start **/
+   void errStrUnterm(){
+	fatalHere(DiagCode::UntermStr);
+	myEofAtLineStart = true;
    }
 
+   void errStrEscAndUnterm(){
+	fatalHere(DiagCode::UntermStrBadEscape);
+	myEofAtLineStart = true;
+   }
+
+   void errIntOverflow(){ fatalHere(DiagCode::IntOverflow); }
+
    void warn(int lineNumIn, int colNumIn, std::string msg){
-	std::cerr << lineNumIn << ":" << colNumIn 
-		<< " ***WARNING*** " << msg << std::endl;
+	Report::warn(static_cast<size_t>(lineNumIn),
+		static_cast<size_t>(colNumIn), msg);
    }
 
    void error(int lineNumIn, int colNumIn, std::string msg){
-	std::cerr << lineNumIn << ":" << colNumIn 
-		<< " ***ERROR*** " << msg << std::endl;
+	Report::error(static_cast<size_t>(lineNumIn),
+		static_cast<size_t>(colNumIn), msg);
    }
 
    static std::string tokenKindString(int tokenKind);
 
-   void outputTokens(std::ostream& outstream);
+protected:
+   /** Flex's refill hook; copies the next block of the source **/
+   int LexerInput(char * buf, int max_size) override;
 
 private:
+   /** Where the current match starts **/
+   SourcePos pos() const { return static_cast<SourcePos>(myTokStart); }
+
+   void fatalHere(DiagCode code, std::string detail = ""){
+	size_t line, col;
+	lines().locate(pos(), line, col);
+	Report::fatal(line, col, code, std::move(detail));
+   }
+
+   /** Hand the parser a T at the current position (scan-only: just the position) **/
+   template <typename T, typename... Args>
+   void emit(Args&&... args){
+	if (myScanOnly){
+		yylval->transToken = nullptr;
+		mark(pos());
+	} else {
+		yylval->transToken = myArena.make<T>(pos(),
+			std::forward<Args>(args)...);
+	}
+   }
+
    holeyc::Parser::semantic_type *yylval = nullptr;
-   size_t lineNum;
-   size_t colNum;
+   Arena& myArena;
+   const char * myBase;
+   const char * myMem;
+   const char * myMemEnd;
+   size_t myOffset;    /// Source offset just past the current match
+   size_t myTokStart;  /// Source offset of the current match
+   bool myScanOnly;  /// No token objects; see TokenSource::scanOnly
+   bool myLazyBodies; /// See TokenSource::lazyBodies
+   /** The last match was an unterminated string (see errStrUnterm) **/
+   bool myEofAtLineStart;
+};
+
+/**
+* Passes tokens through from another source while keeping a copy
+* of each one (END included), so a single scan can serve both the
+* parser and the token dump.
+**/
+class TokenRecorder : public TokenSource{
+public:
+   TokenRecorder(TokenSource& inner)
+   : TokenSource(inner.lines()), myInner(inner){ }
+   int yylex(holeyc::Parser::semantic_type * const lval) override;
+   const std::vector<Token *>& tokens() const { return myTokens; }
+   bool atEnd() const {
+	return !myTokens.empty() && myTokens.back()->kind() == TokenKind::END;
+   }
+private:
+   TokenSource& myInner;
+   std::vector<Token *> myTokens;
 };
 
 } /* end namespace */
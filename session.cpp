@@ -0,0 +1,403 @@
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <iomanip>
+#include <sstream>
+#include <thread>
+#include "session.hpp"
+#include "fold.hpp"
+#include "hashcons.hpp"
+#include "lexthread.hpp"
+#include "lower.hpp"
+#include "names.hpp"
+#include "tokfile.hpp"
+#include "typecheck.hpp"
+#include "validator.hh"
+
+namespace holeyc{
+
+/** Smallest chunk worth a parser of its own **/
+static const size_t MIN_CHUNK = 64 * 1024;
+/** Runs of functions per thread that semantic analysis splits into **/
+static const size_t RUNS_PER_THREAD = 8;
+
+using Lexeme = holeyc::Parser::semantic_type;
+
+CompilationSession::CompilationSession(const char * inPath,
+	bool lexOnThread)
+: myInput(inPath), myLexOnThread(lexOnThread), myLexer(makeLexer()),
+  myRecorder(*myLexer), myRecording(false), myParsed(false), myAST(nullptr),
+  myNamesDone(false), myNamesOk(false), myTypesDone(false),
+  myTypesOk(false), myFolded(false),
+  myParseThreads(1), myLazyBodies(false), myDepthLimit(0),
+  myHashCons(false){
+	if (!myInput.good()){
+		std::string msg = "Bad input stream ";
+		msg += inPath;
+		throw new InternalError(msg.c_str());
+	}
+	if (myInput.size() >= NO_POS){
+		std::string msg = "Input too large for 32-bit positions ";
+		msg += inPath;
+		throw new InternalError(msg.c_str());
+	}
+}
+
+TokenSource * CompilationSession::makeLexer(){
+	Arena& arena = myLexOnThread ? myTokenArena : myArena;
+	std::unique_ptr<TokenSource> lexer;
+	if (isTokenFile(myInput.data(), myInput.size())){
+		lexer.reset(new TokenReplayer(myInput.data(), myInput.size(), arena));
+	} else {
+		lexer.reset(new Scanner(myInput, arena));
+	}
+	if (myLexOnThread){
+		return new LexerThread(std::move(lexer));
+	}
+	return lexer.release();
+}
+
+void CompilationSession::limitDepth(size_t depth){
+	myDepthLimit = depth;
+	myLexer->limitDepth(depth);
+	myRecorder.limitDepth(depth);
+}
+
+ProgramNode * CompilationSession::ast(){
+	if (myParsed){ return myAST; }
+	myParsed = true;
+
+	/* A token dump must see the tokens inside bodies too */
+	if (myRecording){ myLazyBodies = false; }
+	if (myLazyBodies){ myLexer->lazyBodies(); }
+
+	bool chunkable = myParseThreads > 1 && !myRecording
+		&& !isTokenFile(myInput.data(), myInput.size());
+	if (chunkable){
+		/* A few chunks per thread evens out their uneven costs */
+		size_t minBytes = std::max<size_t>(MIN_CHUNK,
+			myInput.size() / (myParseThreads * 4));
+		std::vector<SourceChunk> chunks =
+			findChunks(myInput.data(), myInput.size(), minBytes);
+		if (chunks.size() > 1){
+			myAST = parseChunks(chunks);
+			if (myAST != nullptr){ return myAST; }
+		}
+	}
+
+	ProgramNode * root = nullptr;
+	TokenSource& source = myRecording
+		? static_cast<TokenSource&>(myRecorder)
+		: *myLexer;
+	int errCode = parse(source, myArena, &root, nullptr, myShared);
+	if (errCode == 0){ myAST = root; }
+	return myAST;
+}
+
+/** What one pooled task reported, held back until its turn **/
+struct TaskReport{
+	Diagnostics diags;
+	std::string out; /// Its Report::outs() text (syntax error messages)
+	std::exception_ptr failure;
+	bool ok = false;
+};
+
+/*
+Run task(i, worker) for every i < count on up to threads threads,
+where worker (< threads) tells apart tasks running at the same time.
+What each task reports is captured in its TaskReport instead.
+*/
+static std::vector<TaskReport> runPooled(size_t count, unsigned threads,
+	const std::function<bool(size_t, size_t)>& task){
+	std::vector<TaskReport> reports(count);
+	std::atomic<size_t> next(0);
+	auto work = [&](size_t worker){
+		size_t i;
+		while ((i = next++) < count){
+			TaskReport& report = reports[i];
+			std::ostringstream out;
+			{
+				ReportCapture capture(out, out);
+				DiagnosticScope scope(report.diags);
+				try {
+					report.ok = task(i, worker);
+				} catch (...){
+					report.failure = std::current_exception();
+				}
+			}
+			report.out = out.str();
+		}
+	};
+	size_t workers = std::min<size_t>(threads, count);
+	std::vector<std::thread> pool;
+	for (size_t w = 1; w < workers; w++){
+		pool.emplace_back(work, w);
+	}
+	work(0);
+	for (std::thread& thread : pool){
+		thread.join();
+	}
+	return reports;
+}
+
+/* Report what a pooled task reported, as if it had just run here */
+static void replay(TaskReport& report){
+	Report::outs() << report.out;
+	for (Diagnostic& d : report.diags.take()){
+		Diagnostics::report(d.severity, d.code, d.line, d.col,
+			std::move(d.detail));
+	}
+	if (report.failure != nullptr){
+		std::rethrow_exception(report.failure);
+	}
+}
+
+/*
+Run check(fn, worker) for every function of program on up to threads
+threads, each task taking a run of neighbouring functions, and report
+what the runs reported in source order; returns whether every check
+passed. A few runs per thread even out bodies of uneven size.
+*/
+static bool forEachFunction(ProgramNode * program, unsigned threads,
+	const std::function<bool(FnDeclNode *, size_t)>& check){
+	std::vector<FnDeclNode *> fns;
+	for (DeclNode * decl : *program->globals()){
+		if (decl->kind() == NodeKind::FnDecl){
+			fns.push_back(static_cast<FnDeclNode *>(decl));
+		}
+	}
+	size_t run = std::max<size_t>(1,
+		fns.size() / (RUNS_PER_THREAD * threads));
+	size_t runs = (fns.size() + run - 1) / run;
+	std::vector<TaskReport> reports = runPooled(runs, threads,
+		[&](size_t i, size_t worker){
+		bool ok = true;
+		size_t end = std::min(fns.size(), (i + 1) * run);
+		for (size_t f = i * run; f < end; f++){
+			ok = check(fns[f], worker) && ok;
+		}
+		return ok;
+	});
+	bool ok = true;
+	for (TaskReport& report : reports){
+		replay(report);
+		ok = ok && report.ok;
+	}
+	return ok;
+}
+
+bool CompilationSession::analyzeNames(){
+	if (myNamesDone){ return myNamesOk; }
+	myNamesDone = true;
+	ProgramNode * program = ast();
+	if (program == nullptr){ return myNamesOk; }
+	if (myLazyBodies){ parseBodies(myParseThreads); }
+	ScopeTable globals;
+	bool ok = NameAnalysis(lines(), globals).declareGlobals(program);
+	std::vector<std::unique_ptr<NameAnalysis>> workers(myParseThreads);
+	ok = forEachFunction(program, myParseThreads,
+		[&](FnDeclNode * fn, size_t worker){
+		if (workers[worker] == nullptr){
+			workers[worker].reset(new NameAnalysis(lines(), globals));
+		}
+		return workers[worker]->analyzeBody(fn);
+	}) && ok;
+	myNamesOk = ok;
+	return myNamesOk;
+}
+
+bool CompilationSession::checkTypes(){
+	if (myTypesDone){ return myTypesOk; }
+	myTypesDone = true;
+	if (!analyzeNames()){ return myTypesOk; }
+	TypeCheck::signFunctions(myAST);
+	std::vector<std::unique_ptr<TypeCheck>> workers(myParseThreads);
+	myTypesOk = forEachFunction(myAST, myParseThreads,
+		[&](FnDeclNode * fn, size_t worker){
+		if (workers[worker] == nullptr){
+			workers[worker].reset(new TypeCheck(lines()));
+		}
+		return workers[worker]->checkBody(fn);
+	});
+	return myTypesOk;
+}
+
+bool CompilationSession::foldConstants(){
+	if (!myFolded && checkTypes()){
+		ConstantFold(myArena).run(myAST);
+		myFolded = true;
+	}
+	return myFolded;
+}
+
+const IRProgram * CompilationSession::lowerIR(){
+	if (myIR == nullptr && checkTypes()){
+		myIR.reset(new IRProgram());
+		Lowering(*myIR).run(myAST);
+	}
+	return myIR.get();
+}
+
+ProgramNode * CompilationSession::parseChunks(
+	const std::vector<SourceChunk>& chunks){
+	std::vector<ProgramNode *> roots(chunks.size(), nullptr);
+	std::vector<SharedCount> shared(chunks.size());
+	for (size_t i = 0; i < chunks.size(); i++){
+		myChunkArenas.emplace_back(new Arena());
+	}
+	std::vector<TaskReport> reports = runPooled(chunks.size(),
+		myParseThreads, [&](size_t i, size_t){
+		Scanner scanner(myInput.data(), myInput.lines(), *myChunkArenas[i],
+			chunks[i].begin, chunks[i].end);
+		if (myLazyBodies){ scanner.lazyBodies(); }
+		scanner.limitDepth(myDepthLimit);
+		return parse(scanner, *myChunkArenas[i], &roots[i], nullptr,
+			shared[i]) == 0;
+	});
+
+	/* On any failure the serial parse that follows reports it all */
+	for (const TaskReport& report : reports){
+		if (!report.ok){
+			myChunkArenas.clear();
+			return nullptr;
+		}
+	}
+	/* Every chunk parsed, so the whole file does too, into the same
+	   declarations. Its lexical errors are reported chunk by chunk,
+	   in the order a serial scan reports them. */
+	NodeList<DeclNode *> * globals =
+		myArena.make<NodeList<DeclNode *>>(myArena);
+	for (size_t i = 0; i < chunks.size(); i++){
+		replay(reports[i]);
+		myShared.built += shared[i].built;
+		myShared.reused += shared[i].reused;
+		for (DeclNode * decl : *roots[i]->globals()){
+			globals->push_back(decl);
+		}
+	}
+	return myArena.make<ProgramNode>(globals);
+}
+
+void CompilationSession::parseBodies(unsigned threads){
+	ProgramNode * program = ast();
+	if (program == nullptr){ return; }
+	std::vector<FnBodyNode *> bodies;
+	for (DeclNode * decl : *program->globals()){
+		if (decl->kind() != NodeKind::FnDecl){ continue; }
+		FnDeclNode * fn = static_cast<FnDeclNode *>(decl);
+		if (fn->body()->isLazy()){ bodies.push_back(fn->body()); }
+	}
+	/* One arena per worker; the bodies it parses live there */
+	size_t first = myBodyArenas.size();
+	for (unsigned t = 0; t < threads; t++){
+		myBodyArenas.emplace_back(new Arena());
+	}
+	std::vector<TaskReport> reports = runPooled(bodies.size(), threads,
+		[&](size_t i, size_t worker){
+		return bodies[i]->parseBody(*myBodyArenas[first + worker],
+			myDepthLimit);
+	});
+	for (TaskReport& report : reports){
+		replay(report);
+	}
+}
+
+void CompilationSession::reportMemory(std::ostream& out) const{
+	std::vector<const Arena *> arenas{&myArena};
+	for (const std::unique_ptr<Arena>& chunk : myChunkArenas){
+		arenas.push_back(chunk.get());
+	}
+	for (const std::unique_ptr<Arena>& bodies : myBodyArenas){
+		arenas.push_back(bodies.get());
+	}
+	Arena::report(out, arenas);
+	out << "line table " << lines().lines() << " lines, "
+		<< lines().bytes() << " bytes\n";
+	if (myHashCons){
+		size_t uses = myShared.built + myShared.reused;
+		out << "shared expressions " << myShared.built << " nodes for "
+			<< uses << " uses";
+		if (uses != 0){
+			out << " (" << std::fixed << std::setprecision(1)
+				<< 100.0 * static_cast<double>(myShared.reused)
+				/ static_cast<double>(uses) << "% fewer)";
+		}
+		out << "\n";
+	}
+	if (myLexOnThread){
+		out << "lexer thread:\n";
+		myTokenArena.report(out);
+	}
+}
+
+bool CompilationSession::validate(){
+	myParsed = true;
+	myLexer->scanOnly();
+	Validator validator(*myLexer);
+	return validator.parse() == 0;
+}
+
+/* Frees each declaration's generation of the arena once the next
+   declaration has been handed over */
+class RecyclingSink : public DeclSink{
+public:
+	RecyclingSink(DeclSink& inner, Arena& arena)
+	: myInner(inner), myArena(arena){ }
+	void declParsed(DeclNode * decl) override{
+		myInner.declParsed(decl);
+		myArena.recycle();
+	}
+private:
+	DeclSink& myInner;
+	Arena& myArena;
+};
+
+bool CompilationSession::stream(DeclSink& sink){
+	myParsed = true;
+	if (myLazyBodies){ myLexer->lazyBodies(); }
+	RecyclingSink recycling(sink, myArena);
+	ProgramNode * root = nullptr;
+	return parse(*myLexer, myArena, &root, &recycling, myShared) == 0;
+}
+
+int CompilationSession::parse(TokenSource& source, Arena& arena,
+	ProgramNode ** root, DeclSink * sink, SharedCount& shared){
+	if (!myHashCons){
+		Parser parser(source, arena, root, nullptr, sink, nullptr);
+		return parser.parse();
+	}
+	ExpTable exps(source, arena);
+	exps.limitDepth(myDepthLimit);
+	Parser parser(exps, arena, root, nullptr, sink, &exps);
+	int errCode = parser.parse();
+	shared.built += exps.built();
+	shared.reused += exps.reused();
+	return errCode;
+}
+
+void CompilationSession::lexRemaining(){
+	Lexeme lexeme;
+	while (!myRecorder.atEnd()){
+		myRecorder.yylex(&lexeme);
+	}
+}
+
+void CompilationSession::writeTokens(std::ostream& out){
+	/* A failed (or skipped) parse leaves the rest of the file
+	   unscanned; the dump still covers all of it. */
+	lexRemaining();
+	Writer writer(out);
+	for (Token * token : myRecorder.tokens()){
+		token->write(writer, lines());
+		writer << '\n';
+		if (token->kind() == TokenKind::END){ break; }
+	}
+}
+
+void CompilationSession::writeBinaryTokens(std::ostream& out){
+	lexRemaining();
+	writeTokenFile(out, myRecorder.tokens(), lines());
+}
+
+} //End namespace holeyc
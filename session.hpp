@@ -0,0 +1,192 @@
+#ifndef HOLEYC_SESSION_HPP
+#define HOLEYC_SESSION_HPP
+
+#include <memory>
+#include <ostream>
+#include <vector>
+#include "arena.hpp"
+#include "ast.hpp"
+#include "chunks.hpp"
+#include "ir.hpp"
+#include "scanner.hpp"
+#include "source.hpp"
+
+namespace holeyc{
+
+/**
+* \class CompilationSession
+* Front end state for one input file. The file is opened (mapped,
+* when it is a regular file) and lexed exactly once: the tokens feed
+* the parser and, when asked for, are recorded for the token dumps on
+* the way through. An input that is a binary token file is replayed
+* instead of scanned. The AST is built at most once and shared by
+* every output that needs it.
+**/
+class CompilationSession{
+public:
+	/**
+	* lexOnThread runs the lexer on its own thread, ahead of the
+	* parser (see LexerThread); its tokens then live in tokenArena().
+	**/
+	CompilationSession(const char * inPath, bool lexOnThread = false);
+
+	/** Keep the token stream for writeTokens (call before ast()) **/
+	void recordTokens(){ myRecording = true; }
+
+	/**
+	* Let ast() split a large source into runs of top-level
+	* declarations (see findChunks) and parse them on up to threads
+	* threads, each with its own Scanner, Parser and arena. The result
+	* and its diagnostics are the same as a serial parse; if any chunk
+	* fails to parse, the whole file is parsed serially instead. Not
+	* used with recordTokens() or for token file inputs.
+	* analyzeNames() and checkTypes() check function bodies on as many
+	* threads, with the same diagnostics as on one.
+	**/
+	void parseInParallel(unsigned threads){ myParseThreads = threads; }
+
+	/**
+	* Let ast() skip function bodies: each FnBodyNode keeps its source
+	* range and is parsed when first used, or all at once by
+	* parseBodies. Diagnostics inside a body only appear when it is
+	* parsed, and a bad body no longer stops the parse of the rest.
+	* For interface consumers; call before ast(). Ignored when
+	* recording tokens and for token file inputs.
+	**/
+	void lazyBodies(){ myLazyBodies = true; }
+
+	/**
+	* Parse every body ast() left lazy now, on up to threads threads.
+	* Diagnostics are reported in declaration order.
+	**/
+	void parseBodies(unsigned threads);
+
+	/**
+	* Let the parse share identical side-effect-free expressions (see
+	* ExpTable); -m then reports how many nodes that saved. Bodies
+	* parsed lazily are not shared. Call before ast() or stream().
+	* A shared node keeps its first occurrence's position, and the
+	* semantic passes report its errors once, there: do not use with
+	* them when every error matters.
+	**/
+	void hashCons(){ myHashCons = true; }
+	/** Shared nodes built under hashCons(), and the times they were reused **/
+	size_t sharedNodes() const { return myShared.built; }
+	size_t sharedReuses() const { return myShared.reused; }
+
+	/**
+	* Fail the parse with a syntax error where its stack would grow
+	* past depth entries (see TokenSource::limitDepth); 0 is no limit.
+	**/
+	void limitDepth(size_t depth);
+
+	/** The program's AST, or nullptr if it failed to parse **/
+	ProgramNode * ast();
+
+	/**
+	* Link every name in ast() to its declaration (see NameAnalysis),
+	* once; returns whether the program parsed and every name was
+	* declared properly.
+	**/
+	bool analyzeNames();
+
+	/**
+	* Give every expression in ast() its type (see TypeCheck), once,
+	* after analyzeNames(); returns whether both found no errors.
+	* Does not check types if name analysis failed.
+	**/
+	bool checkTypes();
+
+	/**
+	* Fold the constants in ast() (see ConstantFold), once, if
+	* checkTypes() passes; returns whether it did.
+	**/
+	bool foldConstants();
+
+	/**
+	* The program in three-address code (see Lowering), made once if
+	* checkTypes() passes, from the folded program if foldConstants()
+	* ran first; nullptr otherwise.
+	**/
+	const IRProgram * lowerIR();
+
+	/**
+	* Syntax check only: runs the action-free Validator grammar over
+	* a scan-only lexer, so neither tokens nor nodes are allocated.
+	* Returns whether the program parses. Use instead of ast(), not
+	* with it or with recordTokens().
+	**/
+	bool validate();
+
+	/**
+	* Parse without building the program: each top-level declaration
+	* goes to sink as soon as it is parsed, and is freed once the
+	* next one is (see Arena::recycle), so memory follows the largest
+	* declaration rather than the file. Returns whether the program
+	* parses; declarations before a syntax error have already been
+	* handed over. Use instead of ast(), and not with recordTokens()
+	* or a lexer thread, whose tokens would pile up.
+	**/
+	bool stream(DeclSink& sink);
+
+	/** Write the token stream in the -t format **/
+	void writeTokens(std::ostream& out);
+
+	/** Write the token stream as a binary token file (see tokfile.hpp) **/
+	void writeBinaryTokens(std::ostream& out);
+
+	Arena& arena(){ return myArena; }
+	/** The -m report: what every arena of this compilation holds **/
+	void reportMemory(std::ostream& out) const;
+	const SourceFile& source() const { return myInput; }
+	/** Resolves the positions in this compilation's tokens and nodes **/
+	const LineTable& lines() const { return myLexer->lines(); }
+
+private:
+	void lexRemaining();
+	TokenSource * makeLexer();
+	ProgramNode * parseChunks(const std::vector<SourceChunk>& chunks);
+	/** What the ExpTables of a parse shared **/
+	struct SharedCount{
+		size_t built = 0;
+		size_t reused = 0;
+	};
+	/**
+	* Parse source into arena, through an ExpTable if hashCons(),
+	* adding what it shared to shared; returns the parser's result
+	**/
+	int parse(TokenSource& source, Arena& arena, ProgramNode ** root,
+		DeclSink * sink, SharedCount& shared);
+
+	SourceFile myInput;
+	Arena myArena;
+	bool myLexOnThread;
+	/** Tokens made on the lexer thread; outlives the thread (below) **/
+	Arena myTokenArena;
+	/** A Scanner, or a TokenReplayer if the input is a token file;
+	    wrapped in a LexerThread if lexOnThread **/
+	std::unique_ptr<TokenSource> myLexer;
+	TokenRecorder myRecorder;
+	bool myRecording;
+	bool myParsed;
+	ProgramNode * myAST;
+	bool myNamesDone;
+	bool myNamesOk;
+	bool myTypesDone;
+	bool myTypesOk;
+	bool myFolded;
+	std::unique_ptr<IRProgram> myIR;
+	unsigned myParseThreads;
+	bool myLazyBodies;
+	size_t myDepthLimit;
+	bool myHashCons;
+	SharedCount myShared; /// Of the parse that built myAST
+	/** Trees of a parallel parse, merged into one in myArena **/
+	std::vector<std::unique_ptr<Arena>> myChunkArenas;
+	/** Bodies parsed by parseBodies, one arena per worker **/
+	std::vector<std::unique_ptr<Arena>> myBodyArenas;
+};
+
+} //End namespace holeyc
+
+#endif
@@ -0,0 +1,121 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include "source.hpp"
+
+namespace holeyc{
+
+SourceFile::SourceFile(const char * path, bool allowMap)
+: myData(nullptr), mySize(0), myOwnsMapping(false), myGood(false){
+	myGood = (allowMap && tryMap(path)) || readAll(path);
+	/* Offsets past NO_POS do not fit a SourcePos */
+	if (myGood && mySize < NO_POS){ myLines = LineTable(myData, mySize); }
+}
+
+SourceFile::~SourceFile(){
+	if (myOwnsMapping){
+		munmap(const_cast<char *>(myData), mySize);
+	}
+}
+
+bool SourceFile::tryMap(const char * path){
+	int fd = open(path, O_RDONLY);
+	if (fd < 0){ return false; }
+
+	struct stat info;
+	if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)){
+		close(fd);
+		return false;
+	}
+
+	mySize = static_cast<size_t>(info.st_size);
+	if (mySize == 0){
+		/* mmap rejects empty lengths; there is nothing to read */
+		close(fd);
+		myData = "";
+		return true;
+	}
+
+	void * mem = mmap(nullptr, mySize, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (mem == MAP_FAILED){
+		mySize = 0;
+		return false;
+	}
+	madvise(mem, mySize, MADV_SEQUENTIAL);
+	myData = static_cast<const char *>(mem);
+	myOwnsMapping = true;
+	return true;
+}
+
+bool SourceFile::readAll(const char * path){
+	std::ifstream in(path, std::ios::binary);
+	if (!in.good()){ return false; }
+
+	const size_t block = 256 * 1024;
+	while (in.good()){
+		size_t had = myOwned.size();
+		myOwned.resize(had + block);
+		in.read(&myOwned[had], static_cast<std::streamsize>(block));
+		myOwned.resize(had + static_cast<size_t>(in.gcount()));
+	}
+	if (in.bad()){ return false; }
+
+	myData = myOwned.data();
+	mySize = myOwned.size();
+	return true;
+}
+
+LineTable::LineTable(const char * data, size_t size) : myStarts(1, 0){
+	const char * end = data + size;
+	const char * at = data;
+	while ((at = static_cast<const char *>(
+		memchr(at, '\n', static_cast<size_t>(end - at)))) != nullptr){
+		at++;
+		myStarts.push_back(static_cast<SourcePos>(at - data));
+	}
+}
+
+void LineTable::locate(SourcePos pos, size_t& line, size_t& col) const {
+	if (pos == NO_POS){
+		line = 0;
+		col = 0;
+		return;
+	}
+	/* The last line starting at or before pos */
+	auto after = std::upper_bound(myStarts.begin(), myStarts.end(), pos);
+	line = static_cast<size_t>(after - myStarts.begin());
+	col = pos - myStarts[line - 1] + 1;
+}
+
+void LineTable::locateNear(SourcePos pos, size_t& line, size_t& col) const {
+	size_t count = myStarts.size();
+	for (size_t near = line; near != 0 && near <= count && near <= line + 1;
+		near++){
+		if (pos == NO_POS || pos < myStarts[near - 1]){ break; }
+		if (near == count || pos < myStarts[near]){
+			line = near;
+			col = pos - myStarts[near - 1] + 1;
+			return;
+		}
+	}
+	locate(pos, line, col);
+}
+
+size_t LineTable::line(SourcePos pos) const {
+	size_t line, col;
+	locate(pos, line, col);
+	return line;
+}
+
+size_t LineTable::col(SourcePos pos) const {
+	size_t line, col;
+	locate(pos, line, col);
+	return col;
+}
+
+} //End namespace holeyc
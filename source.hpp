@@ -0,0 +1,93 @@
+#ifndef HOLEYC_SOURCE_HPP
+#define HOLEYC_SOURCE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace holeyc{
+
+/**
+* Where a token or node starts: its byte offset in the source. A
+* LineTable turns it into a line and column when one is asked for.
+**/
+using SourcePos = uint32_t;
+
+/** The position of nodes that have none (reported as line 0, col 0) **/
+const SourcePos NO_POS = UINT32_MAX;
+
+/**
+* \class LineTable
+* The offset at which each line of a source starts, so positions can
+* be kept as bare offsets and resolved (by binary search) only when
+* a line or column is actually needed. Columns count bytes from 1.
+**/
+class LineTable{
+public:
+	/** A single line starting at 0; grow it with addLine **/
+	LineTable() : myStarts(1, 0){ }
+	/** Every line of the size bytes at data **/
+	LineTable(const char * data, size_t size);
+
+	/** Start another line at start, after every line so far **/
+	void addLine(SourcePos start){ myStarts.push_back(start); }
+
+	size_t line(SourcePos pos) const;
+	size_t col(SourcePos pos) const;
+	/** Both at once, with a single search **/
+	void locate(SourcePos pos, size_t& line, size_t& col) const;
+	/**
+	* As locate, but first tries line as it comes in (the answer for a
+	* nearby position) and the line after it; positions visited in
+	* about source order then resolve without a search
+	**/
+	void locateNear(SourcePos pos, size_t& line, size_t& col) const;
+	/** The offset at which line (from 1) starts **/
+	SourcePos lineStart(size_t line) const { return myStarts[line - 1]; }
+	size_t lines() const { return myStarts.size(); }
+	size_t bytes() const { return myStarts.capacity() * sizeof(SourcePos); }
+
+private:
+	std::vector<SourcePos> myStarts;
+};
+
+/**
+* \class SourceFile
+* The bytes of one input file, kept in place for the whole
+* compilation so lexemes can be viewed rather than copied. Regular
+* files are memory-mapped; pipes, terminals and anything else that
+* cannot be mapped (or a caller that asks for it) are read through a
+* stream, in large blocks, into a buffer owned here. Its LineTable
+* is built once, up front, and only read afterwards, so scanners on
+* any thread can share it.
+**/
+class SourceFile{
+public:
+	SourceFile(const char * path, bool allowMap = true);
+	~SourceFile();
+	SourceFile(const SourceFile&) = delete;
+	SourceFile& operator=(const SourceFile&) = delete;
+
+	bool good() const { return myGood; }
+
+	bool mapped() const { return myOwnsMapping; }
+	const char * data() const { return myData; }
+	size_t size() const { return mySize; }
+	const LineTable& lines() const { return myLines; }
+
+private:
+	bool tryMap(const char * path);
+	bool readAll(const char * path);
+
+	std::string myOwned;
+	const char * myData;
+	size_t mySize;
+	LineTable myLines;
+	bool myOwnsMapping;
+	bool myGood;
+};
+
+} //End namespace holeyc
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef HOLEYC_STRREF_HPP
+#define HOLEYC_STRREF_HPP
+
+#include <cstring>
+#include <ostream>
+#include <string>
+
+namespace holeyc{
+
+/**
+* \class StrRef
+* A non-owning view of characters that outlive it, usually a lexeme
+* in the source buffer. Copying a StrRef never copies the text.
+**/
+class StrRef{
+public:
+	StrRef() : myData(""), mySize(0){ }
+	StrRef(const char * data, size_t size) : myData(data), mySize(size){ }
+	StrRef(const char * cstr) : myData(cstr), mySize(strlen(cstr)){ }
+
+	const char * data() const { return myData; }
+	size_t size() const { return mySize; }
+	bool empty() const { return mySize == 0; }
+	char operator[](size_t i) const { return myData[i]; }
+
+	std::string str() const { return std::string(myData, mySize); }
+
+	bool operator==(const StrRef& other) const {
+		return mySize == other.mySize
+			&& memcmp(myData, other.myData, mySize) == 0;
+	}
+	bool operator!=(const StrRef& other) const {
+		return !(*this == other);
+	}
+
+private:
+	const char * myData;
+	size_t mySize;
+};
+
+inline std::ostream& operator<<(std::ostream& out, const StrRef& ref){
+	return out.write(ref.data(), static_cast<std::streamsize>(ref.size()));
+}
+
+} //End namespace holeyc
+
+#endif
@@ -0,0 +1,173 @@
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "symbols.hpp"
+
+namespace holeyc{
+
+namespace {
+
+struct Entry{
+	const char * data;
+	uint32_t size;
+	uint32_t hash;
+};
+
+/*
+Entries live in fixed-size segments that are never moved, so a
+reader can index them without the lock while another thread is
+appending. A symbol only reaches another thread through something
+that already synchronizes (the lock, a join, a queue), which also
+publishes its entry.
+*/
+const size_t SEG_BITS = 14;
+const size_t SEG_SIZE = size_t(1) << SEG_BITS;
+const size_t MAX_SEGS = size_t(1) << 18;
+
+const size_t TEXT_BLOCK = 64 * 1024;
+
+uint32_t hashOf(StrRef s){
+	uint32_t h = 2166136261u;
+	for (size_t i = 0; i < s.size(); i++){
+		h ^= static_cast<unsigned char>(s[i]);
+		h *= 16777619u;
+	}
+	return h;
+}
+
+/* Open-addressing index from spelling to symbol; slot 0 is empty */
+class Index{
+public:
+	Index() : mySlots(64, 0), myCount(0){ }
+
+	template <typename Match>
+	Symbol * find(uint32_t hash, Match matches){
+		size_t mask = mySlots.size() - 1;
+		for (size_t i = hash & mask; ; i = (i + 1) & mask){
+			if (mySlots[i] == 0){ return nullptr; }
+			if (matches(mySlots[i] - 1)){ return &mySlots[i]; }
+		}
+	}
+
+	template <typename HashOf>
+	void insert(uint32_t hash, Symbol sym, HashOf hashOfSym){
+		if ((myCount + 1) * 2 > mySlots.size()){ grow(hashOfSym); }
+		place(hash, sym);
+		myCount++;
+	}
+
+private:
+	void place(uint32_t hash, Symbol sym){
+		size_t mask = mySlots.size() - 1;
+		size_t i = hash & mask;
+		while (mySlots[i] != 0){ i = (i + 1) & mask; }
+		mySlots[i] = sym + 1;
+	}
+
+	template <typename HashOf>
+	void grow(HashOf hashOfSym){
+		std::vector<uint32_t> old(mySlots.size() * 2, 0);
+		old.swap(mySlots);
+		for (uint32_t slot : old){
+			if (slot != 0){ place(hashOfSym(slot - 1), slot - 1); }
+		}
+	}
+
+	std::vector<uint32_t> mySlots;
+	size_t myCount;
+};
+
+class Table{
+public:
+	Table() : mySegments(new Entry*[MAX_SEGS]()), myCount(0),
+		myText(nullptr), myTextLeft(0){ }
+
+	const Entry& entry(Symbol sym) const {
+		return mySegments[sym >> SEG_BITS][sym & (SEG_SIZE - 1)];
+	}
+
+	Symbol intern(StrRef s, uint32_t hash){
+		std::lock_guard<std::mutex> guard(myLock);
+		Symbol * hit = myIndex.find(hash, [&](Symbol sym){
+			const Entry& e = entry(sym);
+			return e.hash == hash && StrRef(e.data, e.size) == s;
+		});
+		if (hit != nullptr){ return *hit - 1; }
+
+		Symbol sym = static_cast<Symbol>(myCount.load());
+		if ((sym & (SEG_SIZE - 1)) == 0){
+			mySegments[sym >> SEG_BITS] = new Entry[SEG_SIZE];
+		}
+		Entry& e = mySegments[sym >> SEG_BITS][sym & (SEG_SIZE - 1)];
+		e.data = copyText(s);
+		e.size = static_cast<uint32_t>(s.size());
+		e.hash = hash;
+		myIndex.insert(hash, sym, [&](Symbol other){
+			return entry(other).hash;
+		});
+		myCount.store(sym + 1);
+		return sym;
+	}
+
+	size_t count() const { return myCount.load(); }
+
+private:
+	const char * copyText(StrRef s){
+		if (s.size() > myTextLeft){
+			size_t block = s.size() > TEXT_BLOCK ? s.size() : TEXT_BLOCK;
+			myText = new char[block];
+			myTextLeft = block;
+		}
+		char * at = myText;
+		memcpy(at, s.data(), s.size());
+		myText += s.size();
+		myTextLeft -= s.size();
+		return at;
+	}
+
+	std::unique_ptr<Entry*[]> mySegments;
+	std::atomic<size_t> myCount;
+	std::mutex myLock;
+	Index myIndex;
+	char * myText;
+	size_t myTextLeft;
+};
+
+/* Never destroyed: other threads may still be interning during exit */
+Table& table(){
+	static Table * shared = new Table();
+	return *shared;
+}
+
+} //End anonymous namespace
+
+Symbol Interner::intern(StrRef spelling){
+	static thread_local Index cache;
+	Table& shared = table();
+	uint32_t hash = hashOf(spelling);
+
+	Symbol * hit = cache.find(hash, [&](Symbol sym){
+		const Entry& e = shared.entry(sym);
+		return e.hash == hash && StrRef(e.data, e.size) == spelling;
+	});
+	if (hit != nullptr){ return *hit - 1; }
+
+	Symbol sym = shared.intern(spelling, hash);
+	cache.insert(hash, sym, [&](Symbol other){
+		return shared.entry(other).hash;
+	});
+	return sym;
+}
+
+StrRef Interner::spelling(Symbol sym){
+	const Entry& e = table().entry(sym);
+	return StrRef(e.data, e.size);
+}
+
+size_t Interner::count(){
+	return table().count();
+}
+
+} //End namespace holeyc
@@ -0,0 +1,37 @@
+#ifndef HOLEYC_SYMBOLS_HPP
+#define HOLEYC_SYMBOLS_HPP
+
+#include <cstdint>
+#include "strref.hpp"
+
+namespace holeyc{
+
+/**
+* A dense identifier number: 0, 1, 2, ... in order of first sighting.
+* Equal spellings always get the same Symbol, so later passes can
+* compare names with == and keep per-name data in flat arrays.
+**/
+using Symbol = uint32_t;
+
+/**
+* \class Interner
+* The process-wide identifier table shared by the lexer and the AST.
+* Each distinct spelling is copied once into storage that lives as
+* long as the process, so symbols stay valid after the source buffer
+* they came from is gone.
+*
+* intern() is safe to call from several threads: every thread keeps
+* a private cache in front of the shared table and only takes the
+* lock for spellings it has not seen before. spelling() never locks.
+**/
+class Interner{
+public:
+	static Symbol intern(StrRef spelling);
+	static StrRef spelling(Symbol sym);
+	/** Number of symbols handed out so far (one past the largest) **/
+	static size_t count();
+};
+
+} //End namespace holeyc
+
+#endif
@@ -1,3 +1,4 @@
+#include <sstream>
 #include "tokens.hpp" // Get the class declarations
 #include "grammar.hh" // Get the TokenKind definitions
 
@@ -6,7 +7,7 @@ namespace holeyc{
 using TokenKind = holeyc::Parser::token;
 using Lexeme = holeyc::Parser::semantic_type;
 
-static std::string tokenKindString(int tokKind){
+static const char * tokenKindString(int tokKind){
 	switch(tokKind){
 		case TokenKind::END: return "EOF";
 		case TokenKind::AND: return "AND";
@@ -54,98 +55,108 @@ static std::string tokenKindString(int tokKind){
 		case TokenKind::TRUE: return "TRUE";
 		case TokenKind::VOID: return "VOID";
 		case TokenKind::WHILE: return "WHILE";
+		case TokenKind::LAZYBODY: return "LAZYBODY";
+		case TokenKind::BODYSTART: return "BODYSTART";
 		default:	
 			return "OTHER";
 	}
 	
 }
 
-Token::Token(size_t lineIn, size_t columnIn, int kindIn)
-  : myLine(lineIn), myCol(columnIn), myKind(kindIn){
+Token::Token(SourcePos posIn, int kindIn)
+  : myPos(posIn), myKind(kindIn){
 }
 
-std::string Token::toString(){
-	return tokenKindString(kind())
-	+ " [" + std::to_string(line()) 
-	+ "," + std::to_string(col()) + "]";
+static void writePos(Writer& out, const Token * token,
+	const LineTable& lines){
+	size_t line, col;
+	lines.locate(token->pos(), line, col);
+	out << " [" << line << "," << col << "]";
 }
 
-size_t Token::line() const { 
-	return this->myLine; 
+void Token::write(Writer& out, const LineTable& lines) const {
+	out << tokenKindString(kind());
+	writePos(out, this, lines);
 }
 
-size_t Token::col() const { 
-	return this->myCol; 
+std::string Token::toString(const LineTable& lines) const {
+	std::ostringstream text;
+	{
+		Writer out(text);
+		write(out, lines);
+	}
+	return text.str();
 }
 
 int Token::kind() const { 
 	return this->myKind; 
 }
 
-IDToken::IDToken(size_t lIn, size_t cIn, std::string vIn)
-  : Token(lIn, cIn, TokenKind::ID), myValue(vIn){ 
+IDToken::IDToken(SourcePos posIn, Symbol symIn)
+  : Token(posIn, TokenKind::ID), mySymbol(symIn){ 
+}
+
+void IDToken::write(Writer& out, const LineTable& lines) const {
+	out << tokenKindString(kind()) << ":" << this->value();
+	writePos(out, this, lines);
 }
 
-std::string IDToken::toString(){
-	return tokenKindString(kind()) + ":"
-	+ this->myValue
-	+ " [" + std::to_string(line()) 
-	+ "," + std::to_string(col()) + "]";
+Symbol IDToken::symbol() const { 
+	return this->mySymbol; 
 }
 
-const std::string IDToken::value() const { 
-	return this->myValue; 
+StrRef IDToken::value() const { 
+	return Interner::spelling(this->mySymbol); 
 }
 
-StrToken::StrToken(size_t lIn, size_t cIn, std::string sIn)
-  : Token(lIn, cIn, TokenKind::STRLITERAL), myStr(sIn){
+StrToken::StrToken(SourcePos posIn, StrRef sIn)
+  : Token(posIn, TokenKind::STRLITERAL), myStr(sIn){
 }
 
-std::string StrToken::toString(){
-	return tokenKindString(kind()) + ":"
-	+ this->myStr
-	+ " [" + std::to_string(line()) 
-	+ "," + std::to_string(col()) + "]";
+void StrToken::write(Writer& out, const LineTable& lines) const {
+	out << tokenKindString(kind()) << ":" << this->myStr;
+	writePos(out, this, lines);
 }
 
-const std::string StrToken::str() const {
+StrRef StrToken::str() const {
 	return this->myStr;
 }
 
-CharLitToken::CharLitToken(size_t lIn, size_t cIn, char valIn)
-  : Token(lIn, cIn, TokenKind::CHARLIT), myVal(valIn){
+CharLitToken::CharLitToken(SourcePos posIn, char valIn)
+  : Token(posIn, TokenKind::CHARLIT), myVal(valIn){
 }
 
-std::string CharLitToken::toString() {
-	std::string res = tokenKindString(kind()) + ":";
+void CharLitToken::write(Writer& out, const LineTable& lines) const {
+	out << tokenKindString(kind()) << ":";
 
 	char v = this->val();
-	if (v == '\n'){ res += "newline"; }
-	else if (v == '\t'){ res += "tab"; }
-	else { res += std::string(1, v); }
+	if (v == '\n'){ out << "newline"; }
+	else if (v == '\t'){ out << "tab"; }
+	else { out << v; }
 
-	res += " [" + std::to_string(line()) 
-	+ "," + std::to_string(col()) + "]";
-
-	return res;
+	writePos(out, this, lines);
 }
 
 char CharLitToken::val() const {
 	return this->myVal;
 }
 
-IntLitToken::IntLitToken(size_t lIn, size_t cIn, int numIn)
-  : Token(lIn, cIn, TokenKind::INTLITERAL), myNum(numIn){}
+IntLitToken::IntLitToken(SourcePos posIn, int numIn)
+  : Token(posIn, TokenKind::INTLITERAL), myNum(numIn){}
 
-std::string IntLitToken::toString(){
-	return tokenKindString(kind()) + ":"
-	+ std::to_string(this->myNum)
-	+ " [" + std::to_string(line()) 
-	+ "," + std::to_string(col()) + "]";
+void IntLitToken::write(Writer& out, const LineTable& lines) const {
+	out << tokenKindString(kind()) << ":" << this->myNum;
+	writePos(out, this, lines);
 }
 
 int IntLitToken::num() const {
 	return this->myNum;
 }
 
+LazyBodyToken::LazyBodyToken(SourcePos posIn, const char * base,
+	const LineTable& lines, size_t begin, size_t end, Arena& arena)
+: Token(posIn, TokenKind::LAZYBODY), myBase(base), myLines(lines),
+  myBegin(begin), myEnd(end), myArena(arena){
+}
+
 } //End namespace holeyc
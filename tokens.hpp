@@ -2,45 +2,55 @@
 #define HOLEYC_TOKEN_H
 
 #include <string>
+#include "source.hpp"
+#include "strref.hpp"
+#include "writer.hpp"
+#include "symbols.hpp"
 
 namespace holeyc{
 
+class Arena;
+
 class Token{
 public:
-	Token(size_t lineIn, size_t columnIn, int kindIn);
-	virtual std::string toString();
-	size_t line() const;
-	size_t col() const;
+	Token(SourcePos posIn, int kindIn);
+	/** The token's line in the -t dump, without the newline **/
+	virtual void write(Writer& out, const LineTable& lines) const;
+	std::string toString(const LineTable& lines) const;
+	/** Where the token starts; lines turns it into a line and column **/
+	SourcePos pos() const { return myPos; }
 	int kind() const;
 private:
-	const size_t myLine;
-	const size_t myCol;
+	const SourcePos myPos;
 	const int myKind;
 };
 
 class IDToken : public Token{
 public:
-	IDToken(size_t lIn, size_t cIn, std::string valIn);
-	const std::string value() const;
-	virtual std::string toString() override;
+	IDToken(SourcePos posIn, Symbol symIn);
+	Symbol symbol() const;
+	StrRef value() const;
+	virtual void write(Writer& out, const LineTable& lines) const override;
 private:
-	const std::string myValue;
-	
+	/** The interned name; the spelling is looked up on demand **/
+	const Symbol mySymbol;
+
 };
 
 class StrToken : public Token{
 public:
-	StrToken(size_t lIn, size_t cIn, std::string valIn);
-	virtual std::string toString() override;
-	const std::string str() const;
+	StrToken(SourcePos posIn, StrRef valIn);
+	virtual void write(Writer& out, const LineTable& lines) const override;
+	StrRef str() const;
 private:
-	const std::string myStr;
+	/** Literal text (quotes included), viewed in the source buffer **/
+	const StrRef myStr;
 };
 
 class CharLitToken : public Token{
 public:
-	CharLitToken(size_t lIn, size_t cIn, char valIn);
-	virtual std::string toString() override;
+	CharLitToken(SourcePos posIn, char valIn);
+	virtual void write(Writer& out, const LineTable& lines) const override;
 	char val() const;
 private:
 	const char myVal;
@@ -48,13 +58,35 @@ private:
 
 class IntLitToken : public Token{
 public:
-	IntLitToken(size_t lIn, size_t cIn, int numIn);
-	virtual std::string toString() override;
+	IntLitToken(SourcePos posIn, int numIn);
+	virtual void write(Writer& out, const LineTable& lines) const override;
 	int num() const;
 private:
 	const int myNum;
 };
 
+/**
+* A whole function body, braces included, skipped by a Scanner in
+* lazy mode. It stands in for the LCURLY stmtList RCURLY the parser
+* would otherwise have seen; FnBodyNode parses it when asked to.
+**/
+class LazyBodyToken : public Token{
+public:
+	LazyBodyToken(SourcePos posIn, const char * base,
+		const LineTable& lines, size_t begin, size_t end, Arena& arena);
+	const char * base() const { return myBase; }
+	const LineTable& lines() const { return myLines; }
+	size_t begin() const { return myBegin; }
+	size_t end() const { return myEnd; }
+	Arena& arena() const { return myArena; }
+private:
+	const char * const myBase; /// Source buffer the offsets index
+	const LineTable& myLines;  /// That buffer's lines
+	const size_t myBegin;      /// Offset of the '{'
+	const size_t myEnd;        /// Just past the matching '}'
+	Arena& myArena;            /// Where the body is built on demand
+};
+
 }
 
 #endif
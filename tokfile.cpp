@@ -0,0 +1,244 @@
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include "tokfile.hpp"
+
+namespace holeyc{
+
+using TokenKind = holeyc::Parser::token;
+
+static const char MAGIC[8] = { '\x7f', 'H', 'C', 'T', 'O', 'K', '\0', '\1' };
+
+/* Parser token numbers start after bison's two reserved ones */
+static const int KIND_BASE = 257;
+static const int KIND_LIMIT = 64;
+static const int LINE_ESCAPE = 3;
+
+bool isTokenFile(const char * data, size_t size){
+	return size >= sizeof(MAGIC) && memcmp(data, MAGIC, sizeof(MAGIC)) == 0;
+}
+
+static void putVarint(std::string& out, uint32_t val){
+	while (val >= 0x80){
+		out += static_cast<char>((val & 0x7F) | 0x80);
+		val >>= 7;
+	}
+	out += static_cast<char>(val);
+}
+
+static bool hasPayload(int kind){
+	return kind == TokenKind::ID || kind == TokenKind::STRLITERAL
+		|| kind == TokenKind::INTLITERAL || kind == TokenKind::CHARLIT;
+}
+
+void writeTokenFile(std::ostream& out, const std::vector<Token *>& tokens,
+	const LineTable& lines){
+	std::unordered_map<std::string, uint32_t> index;
+	std::string lexemes;
+	std::string body;
+	uint32_t lexemeCount = 0;
+	uint32_t tokenCount = 0;
+	auto lexemeID = [&](StrRef text){
+		auto found = index.emplace(text.str(), lexemeCount);
+		if (found.second){
+			putVarint(lexemes, static_cast<uint32_t>(text.size()));
+			lexemes.append(text.data(), text.size());
+			lexemeCount++;
+		}
+		return found.first->second;
+	};
+
+	size_t line = 0;
+	size_t col = 0;
+	for (Token * token : tokens){
+		int kind = token->kind();
+		if (kind != TokenKind::END
+			&& (kind <= KIND_BASE || kind >= KIND_BASE + KIND_LIMIT)){
+			throw new InternalError("Token kind does not fit a token file");
+		}
+		int code = kind == TokenKind::END ? 0 : kind - KIND_BASE;
+		size_t tokLine = line;
+		size_t tokCol;
+		lines.locateNear(token->pos(), tokLine, tokCol);
+		size_t advance = tokLine - line;
+		int lineTag = advance < LINE_ESCAPE
+			? static_cast<int>(advance) : LINE_ESCAPE;
+		body += static_cast<char>(code | lineTag << 6);
+		if (lineTag == LINE_ESCAPE){
+			putVarint(body, static_cast<uint32_t>(advance));
+		}
+		size_t colField = advance == 0 ? tokCol - col : tokCol;
+		putVarint(body, static_cast<uint32_t>(colField));
+		line = tokLine;
+		col = tokCol;
+		if (kind == TokenKind::ID){
+			putVarint(body, lexemeID(static_cast<IDToken *>(token)->value()));
+		} else if (kind == TokenKind::STRLITERAL){
+			putVarint(body, lexemeID(static_cast<StrToken *>(token)->str()));
+		} else if (kind == TokenKind::INTLITERAL){
+			putVarint(body, static_cast<uint32_t>(
+				static_cast<IntLitToken *>(token)->num()));
+		} else if (kind == TokenKind::CHARLIT){
+			putVarint(body, static_cast<unsigned char>(
+				static_cast<CharLitToken *>(token)->val()));
+		}
+		tokenCount++;
+		if (kind == TokenKind::END){ break; }
+	}
+
+	std::string counts;
+	putVarint(counts, lexemeCount);
+	out.write(MAGIC, sizeof(MAGIC));
+	out.write(counts.data(), static_cast<std::streamsize>(counts.size()));
+	out.write(lexemes.data(), static_cast<std::streamsize>(lexemes.size()));
+	counts.clear();
+	putVarint(counts, tokenCount);
+	out.write(counts.data(), static_cast<std::streamsize>(counts.size()));
+	out.write(body.data(), static_cast<std::streamsize>(body.size()));
+}
+
+TokenReplayer::TokenReplayer(const char * data, size_t size, Arena& arena)
+: TokenSource(myLines), myArena(arena),
+  myCur(reinterpret_cast<const unsigned char *>(data)),
+  myEnd(reinterpret_cast<const unsigned char *>(data) + size),
+  myRemaining(0), myLine(0), myCol(0), myPos(NO_POS), myDone(false){
+	if (!isTokenFile(data, size)){
+		throw new InternalError("Bad token file header");
+	}
+	myCur += sizeof(MAGIC);
+	uint32_t count;
+	if (!readVarint(count)){
+		throw new InternalError("Bad token file lexeme table");
+	}
+	for (uint32_t i = 0; i < count; i++){
+		uint32_t len;
+		if (!readVarint(len) || len > static_cast<size_t>(myEnd - myCur)){
+			throw new InternalError("Bad token file lexeme table");
+		}
+		myLexemes.push_back(
+			StrRef(reinterpret_cast<const char *>(myCur), len));
+		myCur += len;
+	}
+	mySymbols.resize(count);
+	myInterned.resize(count, false);
+	if (!readVarint(myRemaining)){
+		throw new InternalError("Bad token file token count");
+	}
+	layOutLines();
+}
+
+/* Line L of the stand-in source is as wide as its last token's column
+   (at least 1, so that a blank line still has an offset of its own),
+   and line L+1 starts right after it. */
+void TokenReplayer::layOutLines(){
+	const unsigned char * start = myCur;
+	uint32_t usable = 0;
+	size_t line = 0;
+	uint64_t lineStart = 0;
+	uint64_t width = 0;
+	Record rec;
+	while (usable < myRemaining && readRecord(rec)){
+		uint64_t col = rec.lineDelta == 0 ? width + rec.col : rec.col;
+		if (rec.lineDelta > 0){
+			/* Line 1 starts at 0; each line after adds its width */
+			uint64_t grow = line == 0 ? rec.lineDelta - 1
+				: std::max<uint64_t>(width, 1) + rec.lineDelta - 1;
+			if (lineStart + grow + col >= NO_POS){ break; }
+			if (line > 0){
+				lineStart += std::max<uint64_t>(width, 1);
+				myLines.addLine(static_cast<SourcePos>(lineStart));
+			}
+			for (uint32_t i = 1; i < rec.lineDelta; i++){
+				myLines.addLine(static_cast<SourcePos>(++lineStart));
+			}
+			line += rec.lineDelta;
+		} else if (line > 0 && lineStart + col >= NO_POS){
+			break;
+		}
+		/* Scanned tokens start at column 1 or later */
+		if (line > 0 && col == 0){ break; }
+		width = col;
+		usable++;
+	}
+	myRemaining = usable;
+	myCur = start;
+}
+
+bool TokenReplayer::readRecord(Record& rec){
+	if (myCur >= myEnd){ return false; }
+	unsigned char byte = *myCur++;
+	int code = byte & (KIND_LIMIT - 1);
+	rec.kind = code == 0 ? TokenKind::END : code + KIND_BASE;
+	rec.lineDelta = byte >> 6;
+	rec.payload = 0;
+	if (rec.lineDelta == LINE_ESCAPE && !readVarint(rec.lineDelta)){
+		return false;
+	}
+	if (!readVarint(rec.col)
+		|| (hasPayload(rec.kind) && !readVarint(rec.payload))){
+		return false;
+	}
+	if (rec.kind == TokenKind::ID || rec.kind == TokenKind::STRLITERAL){
+		return rec.payload < myLexemes.size();
+	}
+	return true;
+}
+
+bool TokenReplayer::readVarint(uint32_t& out){
+	out = 0;
+	for (unsigned shift = 0; shift < 35 && myCur < myEnd; shift += 7){
+		unsigned char byte = *myCur++;
+		out |= static_cast<uint32_t>(byte & 0x7F) << shift;
+		if ((byte & 0x80) == 0){ return true; }
+	}
+	return false;
+}
+
+int TokenReplayer::yylex(holeyc::Parser::semantic_type * const lval){
+	Record rec;
+	/* layOutLines has already checked every token it let through */
+	if (myDone || myRemaining == 0 || !readRecord(rec)){
+		/* Damaged or cut short: end the stream where it stops */
+		if (!myDone){
+			Report::message("Error: token file is truncated or damaged");
+		}
+		myDone = true;
+		lval->transToken = myArena.make<Token>(myPos, TokenKind::END);
+		return TokenKind::END;
+	}
+	myRemaining--;
+	myLine += rec.lineDelta;
+	myCol = rec.lineDelta == 0 ? myCol + rec.col : rec.col;
+	myPos = myLine == 0 ? NO_POS : static_cast<SourcePos>(
+		myLines.lineStart(myLine) + myCol - 1);
+
+	uint32_t payload = rec.payload;
+	switch (rec.kind){
+	case TokenKind::ID:
+		if (!myInterned[payload]){
+			mySymbols[payload] = Interner::intern(myLexemes[payload]);
+			myInterned[payload] = true;
+		}
+		lval->transToken = myArena.make<IDToken>(myPos, mySymbols[payload]);
+		break;
+	case TokenKind::STRLITERAL:
+		lval->transToken = myArena.make<StrToken>(myPos, myLexemes[payload]);
+		break;
+	case TokenKind::INTLITERAL:
+		lval->transToken = myArena.make<IntLitToken>(myPos,
+			static_cast<int>(payload));
+		break;
+	case TokenKind::CHARLIT:
+		lval->transToken = myArena.make<CharLitToken>(myPos,
+			static_cast<char>(payload));
+		break;
+	default:
+		lval->transToken = myArena.make<Token>(myPos, rec.kind);
+		break;
+	}
+	if (rec.kind == TokenKind::END){ myDone = true; }
+	return rec.kind;
+}
+
+} //End namespace holeyc
@@ -0,0 +1,91 @@
+#ifndef HOLEYC_TOKFILE_HPP
+#define HOLEYC_TOKFILE_HPP
+
+#include <ostream>
+#include <vector>
+#include "scanner.hpp"
+
+namespace holeyc{
+
+/**
+* Binary token files. After an 8-byte magic header, the file holds:
+*
+*   varint lexemeCount, then per lexeme: varint length, bytes
+*   varint tokenCount, then per token:
+*     byte   low 6 bits: kind (0 for END, else the parser's number
+*            minus 257); high 2 bits: lines advanced since the last
+*            token (0-2), or 3 if a varint with the count follows
+*     varint column, as the distance from the previous token's column
+*            when on the same line
+*     varint payload, only for these kinds:
+*       ID, STRLITERAL  index into the lexeme table
+*       INTLITERAL      value
+*       CHARLIT         character
+*
+* Varints are unsigned LEB128. Each distinct ID spelling or string
+* literal is stored once. Lexical errors are not recorded; the file
+* holds only the tokens that were produced.
+*
+* Lines and columns are stored, not offsets. A replayer lays out a
+* stand-in source, just wide enough for each line's tokens, whose
+* LineTable maps its offsets back to the recorded lines and columns.
+**/
+
+/** True if the bytes start with a token file header **/
+bool isTokenFile(const char * data, size_t size);
+
+/**
+* Write tokens, up to and including END, as a token file; lines
+* resolves their positions
+**/
+void writeTokenFile(std::ostream& out, const std::vector<Token *>& tokens,
+	const LineTable& lines);
+
+/**
+* \class TokenReplayer
+* Feeds a token file to the parser in place of a Scanner. Tokens are
+* decoded one at a time straight from the file's bytes, which must
+* outlive every token handed out (string literals are views into
+* them). The constructor checks the header and the lexeme table and
+* throws an InternalError if they are damaged. It also reads the
+* tokens through once to build the stand-in LineTable; tokens past
+* any damage are never handed out.
+**/
+class TokenReplayer : public TokenSource{
+public:
+	TokenReplayer(const char * data, size_t size, Arena& arena);
+	int yylex(holeyc::Parser::semantic_type * const lval) override;
+
+private:
+	/** One token as stored: lines advanced, column field, payload **/
+	struct Record{
+		int kind;
+		uint32_t lineDelta;
+		uint32_t col;
+		uint32_t payload;
+	};
+
+	bool readVarint(uint32_t& out);
+	/** Decode the next token; false if the bytes are damaged **/
+	bool readRecord(Record& rec);
+	/** Build myLines and count the tokens that can be handed out **/
+	void layOutLines();
+
+	Arena& myArena;
+	LineTable myLines;
+	const unsigned char * myCur;
+	const unsigned char * myEnd;
+	std::vector<StrRef> myLexemes;
+	/** Symbol for each lexeme, interned the first time an ID uses it **/
+	std::vector<Symbol> mySymbols;
+	std::vector<bool> myInterned;
+	uint32_t myRemaining;
+	size_t myLine;
+	size_t myCol;
+	SourcePos myPos; /// Of the last token handed out
+	bool myDone;
+};
+
+} //End namespace holeyc
+
+#endif
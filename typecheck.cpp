@@ -0,0 +1,374 @@
+#include "typecheck.hpp"
+#include "errors.hpp"
+#include "visitor.hpp"
+
+namespace holeyc{
+
+static const DataType * const ERROR = DataType::of(TypeCode::Error);
+static const DataType * const VOID = DataType::of(TypeCode::Void);
+static const DataType * const INT = DataType::of(TypeCode::Int);
+static const DataType * const BOOL = DataType::of(TypeCode::Bool);
+
+static bool isInt(const DataType * type){ return type == INT; }
+static bool isBool(const DataType * type){ return type == BOOL; }
+/* What ==, = and TOCONSOLE cannot take */
+static bool isValue(const DataType * type){
+	return type != VOID && !type->isFn();
+}
+
+static const DataType * signatureOf(FnDeclNode * fn){
+	std::vector<const DataType *> formals;
+	for (auto formal : *fn->formals()->formals()){
+		formals.push_back(DataType::of(formal->type()));
+	}
+	return DataType::fn(formals, DataType::of(fn->retType()));
+}
+
+/* The nodes whose types a node's check needs, and the statements
+   below a statement; types and declarations have none */
+class TypeCheck::Children : public ASTVisitor<Children>{
+public:
+	explicit Children(std::vector<ASTNode *>& out) : myOut(out){ }
+
+	void visitAssignStmt(AssignStmtNode * node){ add(node->assign()); }
+	void visitCallStmt(CallStmtNode * node){ add(node->callExp()); }
+	void visitFromConsole(FromConsoleStmtNode * node){ add(node->val()); }
+	void visitToConsole(ToConsoleStmtNode * node){ add(node->exp()); }
+	void visitPostInc(PostIncStmtNode * node){ add(node->exp()); }
+	void visitPostDec(PostDecStmtNode * node){ add(node->exp()); }
+	void visitReturn(ReturnStmtNode * node){
+		if (node->exp() != nullptr){ add(node->exp()); }
+	}
+	void visitIf(IfStmtNode * node){
+		add(node->exp());
+		add(node->stmts());
+	}
+	void visitIfElse(IfElseStmtNode * node){
+		add(node->exp());
+		add(node->stmtsT());
+		add(node->stmtsF());
+	}
+	void visitWhile(WhileStmtNode * node){
+		add(node->exp());
+		add(node->stmts());
+	}
+
+	void visitAssignExp(AssignExpNode * node){
+		add(node->tgt());
+		add(node->src());
+	}
+	void visitCallExp(CallExpNode * node){
+		add(node->id());
+		if (node->args() != nullptr){
+			for (auto arg : *node->args()){ add(arg); }
+		}
+	}
+	void visitBinaryExp(BinaryExpNode * node){
+		add(node->lhs());
+		add(node->rhs());
+	}
+	void visitUnaryExp(UnaryExpNode * node){ add(node->exp()); }
+	void visitDeref(DerefNode * node){ add(node->tgt()); }
+	void visitRef(RefNode * node){ add(node->tgt()); }
+	void visitIndex(IndexNode * node){
+		add(node->tgt());
+		add(node->off());
+	}
+
+	void visitNode(ASTNode *){ }
+
+private:
+	void add(ASTNode * node){ myOut.push_back(node); }
+	void add(NodeList<StmtNode *> * stmts){
+		for (auto stmt : *stmts){ myOut.push_back(stmt); }
+	}
+
+	std::vector<ASTNode *>& myOut;
+};
+
+/*
+Checks one node once its children have been checked: an expression
+gets its type from theirs, a statement checks the types it uses.
+*/
+class TypeCheck::Rules : public ASTVisitor<Rules>{
+public:
+	explicit Rules(TypeCheck& pass) : myPass(pass){ }
+
+	void visitIntLit(IntLitNode * node){ node->setType(INT); }
+	void visitCharLit(CharLitNode * node){
+		node->setType(DataType::of(TypeCode::Char));
+	}
+	void visitStrLit(StrLitNode * node){
+		node->setType(DataType::of(TypeCode::CharPtr));
+	}
+	void visitTrue(TrueNode * node){ node->setType(BOOL); }
+	void visitFalse(FalseNode * node){ node->setType(BOOL); }
+	void visitNullPtr(NullPtrNode * node){
+		node->setType(DataType::of(TypeCode::Null));
+	}
+
+	void visitID(IDNode * node){
+		DeclNode * decl = node->decl();
+		if (decl == nullptr){
+			node->setType(ERROR);
+		} else if (decl->kind() == NodeKind::FnDecl){
+			node->setType(static_cast<FnDeclNode *>(decl)->signature());
+		} else {
+			node->setType(DataType::of(
+				static_cast<VarDeclNode *>(decl)->type()));
+		}
+	}
+
+	void visitPlus(PlusNode * node){ arith(node); }
+	void visitMinus(MinusNode * node){ arith(node); }
+	void visitTimes(TimesNode * node){ arith(node); }
+	void visitDivide(DivideNode * node){ arith(node); }
+	void visitAnd(AndNode * node){ logic(node); }
+	void visitOr(OrNode * node){ logic(node); }
+	void visitLess(LessNode * node){ relation(node); }
+	void visitGreater(GreaterNode * node){ relation(node); }
+	void visitLessEq(LessEqNode * node){ relation(node); }
+	void visitGreaterEq(GreaterEqNode * node){ relation(node); }
+	void visitEquals(EqualsNode * node){ equality(node); }
+	void visitNotEquals(NotEqualsNode * node){ equality(node); }
+	void visitNeg(NegNode * node){
+		node->setType(operand(node, node->exp(), isInt,
+			DiagCode::BadArithOperand) ? INT : ERROR);
+	}
+	void visitNot(NotNode * node){
+		node->setType(operand(node, node->exp(), isBool,
+			DiagCode::BadLogicOperand) ? BOOL : ERROR);
+	}
+
+	void visitAssignExp(AssignExpNode * node){
+		const DataType * tgt = node->tgt()->type();
+		const DataType * src = node->src()->type();
+		DiagCode bad = DiagCode::BadAssignOperand;
+		bool ok = operand(node, node->tgt(), isValue, bad);
+		ok = operand(node, node->src(), isValue, bad) && ok;
+		if (ok && node->tgt()->kind() == NodeKind::Ref){
+			/* ^x is x's address, which is a value, not a place */
+			myPass.report(at(node, node->tgt()), DiagCode::RefTarget);
+			ok = false;
+		} else if (ok && !tgt->accepts(src)){
+			myPass.report(node, DiagCode::TypeMismatch);
+			ok = false;
+		}
+		node->setType(ok ? tgt : ERROR);
+	}
+
+	void visitCallExp(CallExpNode * node){
+		const DataType * fn = node->id()->type();
+		if (fn == ERROR){
+			node->setType(ERROR);
+			return;
+		}
+		if (!fn->isFn()){
+			myPass.report(node->id(), DiagCode::CallNonFn);
+			node->setType(ERROR);
+			return;
+		}
+		/* A bad call still has the function's result type */
+		node->setType(fn->ret());
+		size_t count = node->args() == nullptr ? 0 : node->args()->size();
+		if (count != fn->formals().size()){
+			myPass.report(node, DiagCode::BadArgCount);
+			return;
+		}
+		if (count == 0){ return; }
+		size_t i = 0;
+		for (auto arg : *node->args()){
+			const DataType * actual = arg->type();
+			if (actual != ERROR && !fn->formals()[i]->accepts(actual)){
+				myPass.report(at(node, arg), DiagCode::BadArgType);
+			}
+			i++;
+		}
+	}
+
+	void visitDeref(DerefNode * node){
+		const DataType * tgt = node->tgt()->type();
+		if (tgt == ERROR){
+			node->setType(ERROR);
+		} else if (!tgt->isPtr()){
+			myPass.report(at(node, node->tgt()), DiagCode::DerefNonPtr);
+			node->setType(ERROR);
+		} else {
+			node->setType(tgt->base());
+		}
+	}
+
+	void visitRef(RefNode * node){
+		const DataType * tgt = node->tgt()->type();
+		if (tgt == ERROR){
+			node->setType(ERROR);
+		} else if (!tgt->isBasic()){
+			myPass.report(at(node, node->tgt()), DiagCode::BadRefOperand);
+			node->setType(ERROR);
+		} else {
+			node->setType(tgt->ptrTo());
+		}
+	}
+
+	void visitIndex(IndexNode * node){
+		const DataType * tgt = node->tgt()->type();
+		bool ok = operand(node, node->tgt(), [](const DataType * type){
+			return type->isPtr(); }, DiagCode::IndexNonPtr);
+		ok = operand(node, node->off(), isInt, DiagCode::BadIndex) && ok;
+		node->setType(ok ? tgt->base() : ERROR);
+	}
+
+	void visitPostInc(PostIncStmtNode * node){
+		operand(node, node->exp(), isInt, DiagCode::BadArithOperand);
+	}
+	void visitPostDec(PostDecStmtNode * node){
+		operand(node, node->exp(), isInt, DiagCode::BadArithOperand);
+	}
+	void visitFromConsole(FromConsoleStmtNode * node){
+		if (node->val()->type()->isFn()){
+			myPass.report(at(node, node->val()), DiagCode::ReadFn);
+		} else if (node->val()->kind() == NodeKind::Ref){
+			myPass.report(at(node, node->val()), DiagCode::RefTarget);
+		}
+	}
+	void visitToConsole(ToConsoleStmtNode * node){
+		const DataType * type = node->exp()->type();
+		if (type->isFn()){
+			myPass.report(at(node, node->exp()), DiagCode::WriteFn);
+		} else if (type == VOID){
+			myPass.report(at(node, node->exp()), DiagCode::WriteVoid);
+		}
+	}
+	void visitIf(IfStmtNode * node){
+		operand(node, node->exp(), isBool, DiagCode::BadIfCond);
+	}
+	void visitIfElse(IfElseStmtNode * node){
+		operand(node, node->exp(), isBool, DiagCode::BadIfCond);
+	}
+	void visitWhile(WhileStmtNode * node){
+		operand(node, node->exp(), isBool, DiagCode::BadWhileCond);
+	}
+	void visitReturn(ReturnStmtNode * node){
+		const DataType * ret = myPass.myRet;
+		ExpNode * exp = node->exp();
+		if (exp == nullptr){
+			if (ret != VOID){ myPass.report(node, DiagCode::MissingReturn); }
+		} else if (ret == VOID){
+			myPass.report(at(node, exp), DiagCode::ReturnInVoid);
+		} else if (exp->type() != ERROR && !ret->accepts(exp->type())){
+			myPass.report(at(node, exp), DiagCode::BadReturn);
+		}
+	}
+
+	/* Declarations, and statements that only hold an expression */
+	void visitNode(ASTNode *){ }
+
+private:
+	/* Where to report a misused exp: a shared node carries the
+	   position of its first occurrence only, so one is reported at
+	   the node using it, which is checked where it occurs */
+	static ASTNode * at(ASTNode * user, ExpNode * exp){
+		return exp->shared() ? user : exp;
+	}
+	/* Whether exp is fit for user; a misfit is reported, an
+	   expression that already failed is not */
+	template <typename Fits>
+	bool operand(ASTNode * user, ExpNode * exp, Fits fits, DiagCode code){
+		const DataType * type = exp->type();
+		if (type == ERROR){ return false; }
+		if (!fits(type)){
+			myPass.report(at(user, exp), code);
+			return false;
+		}
+		return true;
+	}
+	template <typename Fits>
+	void binary(BinaryExpNode * node, Fits fits, DiagCode code,
+		const DataType * result){
+		bool ok = operand(node, node->lhs(), fits, code);
+		ok = operand(node, node->rhs(), fits, code) && ok;
+		node->setType(ok ? result : ERROR);
+	}
+	void arith(BinaryExpNode * node){
+		binary(node, isInt, DiagCode::BadArithOperand, INT);
+	}
+	void logic(BinaryExpNode * node){
+		binary(node, isBool, DiagCode::BadLogicOperand, BOOL);
+	}
+	void relation(BinaryExpNode * node){
+		binary(node, isInt, DiagCode::BadRelOperand, BOOL);
+	}
+	void equality(BinaryExpNode * node){
+		const DataType * lhs = node->lhs()->type();
+		const DataType * rhs = node->rhs()->type();
+		DiagCode bad = DiagCode::BadEqOperand;
+		bool ok = operand(node, node->lhs(), isValue, bad);
+		ok = operand(node, node->rhs(), isValue, bad) && ok;
+		if (ok && !lhs->accepts(rhs) && !rhs->accepts(lhs)){
+			myPass.report(node, DiagCode::TypeMismatch);
+			ok = false;
+		}
+		node->setType(ok ? BOOL : ERROR);
+	}
+
+	TypeCheck& myPass;
+};
+
+bool TypeCheck::run(ProgramNode * program){
+	signFunctions(program);
+	bool ok = true;
+	for (auto global : *program->globals()){
+		if (global->kind() != NodeKind::FnDecl){ continue; }
+		ok = checkBody(static_cast<FnDeclNode *>(global)) && ok;
+	}
+	return ok;
+}
+
+void TypeCheck::signFunctions(ProgramNode * program){
+	for (auto global : *program->globals()){
+		if (global->kind() != NodeKind::FnDecl){ continue; }
+		FnDeclNode * fn = static_cast<FnDeclNode *>(global);
+		fn->setSignature(signatureOf(fn));
+	}
+}
+
+bool TypeCheck::checkBody(FnDeclNode * fn){
+	myOk = true;
+	myRet = fn->signature()->ret();
+	Children children(myFrame);
+	Rules rules(*this);
+	for (auto stmt : *fn->body()->stmts()->stmts()){
+		myStack.push_back(Item{stmt, false});
+		while (!myStack.empty()){
+			Item item = myStack.back();
+			myStack.pop_back();
+			if (item.post){
+				rules.visit(item.node);
+				continue;
+			}
+			/* A shared node has one type wherever it occurs */
+			if (item.node->shared()
+				&& static_cast<ExpNode *>(item.node)->typed()){
+				continue;
+			}
+			myStack.push_back(Item{item.node, true});
+			children.visit(item.node);
+			/* Reversed, so the first child is checked first */
+			for (auto child = myFrame.rbegin(); child != myFrame.rend();
+				++child){
+				myStack.push_back(Item{*child, false});
+			}
+			myFrame.clear();
+		}
+	}
+	return myOk;
+}
+
+void TypeCheck::report(ASTNode * node, DiagCode code){
+	size_t line, col;
+	myLines.locate(node->pos(), line, col);
+	Report::fatal(line, col, code);
+	myOk = false;
+}
+
+} //End namespace holeyc
@@ -0,0 +1,60 @@
+#ifndef HOLEYC_TYPECHECK_HPP
+#define HOLEYC_TYPECHECK_HPP
+
+#include <vector>
+#include "ast.hpp"
+#include "diagnostics.hpp"
+#include "source.hpp"
+
+namespace holeyc{
+
+/**
+* \class TypeCheck
+* Gives every expression of a program its type (see ExpNode::type)
+* and every function its signature, reporting operands, arguments,
+* conditions and returns of the wrong type, and assignments or reads
+* into an address (^x), which is no place to store to. Names must
+* already be linked (see NameAnalysis); an undeclared name has the
+* Error type, as does any expression that failed to check, and
+* neither is reported again further up.
+*
+* Once signFunctions has run, each body checks on its own, so bodies
+* may be checked on several threads at once, each thread with its own
+* TypeCheck. Like NameAnalysis, the walk keeps its own stack and types
+* a node shared under -h only once.
+**/
+class TypeCheck{
+public:
+	/** lines resolves the positions of the diagnostics **/
+	explicit TypeCheck(const LineTable& lines) : myLines(lines){ }
+
+	/** Type program; false if any diagnostic was reported **/
+	bool run(ProgramNode * program);
+	/** Give every function of program its signature **/
+	static void signFunctions(ProgramNode * program);
+	/** Check the statements of fn's body, once every function that
+	    it can name is signed; false if any diagnostic was reported **/
+	bool checkBody(FnDeclNode * fn);
+
+private:
+	class Children;
+	class Rules;
+	/** A node whose children are to be scheduled, or to be checked **/
+	struct Item{
+		ASTNode * node;
+		bool post;
+	};
+
+	void report(ASTNode * node, DiagCode code);
+
+	const LineTable& myLines;
+	std::vector<Item> myStack;
+	/** What the node being scheduled has for children, in order **/
+	std::vector<ASTNode *> myFrame;
+	const DataType * myRet; /// Of the function being checked
+	bool myOk;
+};
+
+} //End namespace holeyc
+
+#endif
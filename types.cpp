@@ -0,0 +1,117 @@
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include "types.hpp"
+#include "ast.hpp"
+#include "errors.hpp"
+
+namespace holeyc{
+
+/* The function types handed out so far, by signature */
+class FnTypes{
+public:
+	static const DataType * intern(
+		const std::vector<const DataType *>& formals, const DataType * ret){
+		/* Formals and results are never functions, so their codes
+		   spell the signature */
+		std::string key(1, static_cast<char>(ret->code()));
+		for (const DataType * formal : formals){
+			key += static_cast<char>(formal->code());
+		}
+		static std::mutex lock;
+		static std::unordered_map<std::string, std::unique_ptr<DataType>>
+			types;
+		std::lock_guard<std::mutex> guard(lock);
+		std::unique_ptr<DataType>& type = types[key];
+		if (type == nullptr){ type.reset(new DataType(formals, ret)); }
+		return type.get();
+	}
+};
+
+const DataType * DataType::of(TypeCode code){
+	static const DataType * const types[] = {
+		nullptr,
+		new DataType(TypeCode::Error),
+		new DataType(TypeCode::Void),
+		new DataType(TypeCode::Int),
+		new DataType(TypeCode::Bool),
+		new DataType(TypeCode::Char),
+		new DataType(TypeCode::IntPtr),
+		new DataType(TypeCode::BoolPtr),
+		new DataType(TypeCode::CharPtr),
+		new DataType(TypeCode::Null),
+	};
+	if (code == TypeCode::Unchecked || code == TypeCode::Fn){
+		throw new InternalError("no single type for this code");
+	}
+	return types[static_cast<size_t>(code)];
+}
+
+const DataType * DataType::of(TypeNode * node){
+	switch (node->kind()){
+	case NodeKind::IntType: return of(TypeCode::Int);
+	case NodeKind::BoolType: return of(TypeCode::Bool);
+	case NodeKind::CharType: return of(TypeCode::Char);
+	case NodeKind::VoidType: return of(TypeCode::Void);
+	case NodeKind::IntPtr: return of(TypeCode::IntPtr);
+	case NodeKind::BoolPtr: return of(TypeCode::BoolPtr);
+	case NodeKind::CharPtr: return of(TypeCode::CharPtr);
+	default: break;
+	}
+	throw new InternalError("not a type node");
+}
+
+const DataType * DataType::fn(
+	const std::vector<const DataType *>& formals, const DataType * ret){
+	return FnTypes::intern(formals, ret);
+}
+
+const DataType * DataType::base() const{
+	switch (myCode){
+	case TypeCode::IntPtr: return of(TypeCode::Int);
+	case TypeCode::BoolPtr: return of(TypeCode::Bool);
+	case TypeCode::CharPtr: return of(TypeCode::Char);
+	default: return nullptr;
+	}
+}
+
+const DataType * DataType::ptrTo() const{
+	switch (myCode){
+	case TypeCode::Int: return of(TypeCode::IntPtr);
+	case TypeCode::Bool: return of(TypeCode::BoolPtr);
+	case TypeCode::Char: return of(TypeCode::CharPtr);
+	default: return nullptr;
+	}
+}
+
+std::string DataType::str() const{
+	switch (myCode){
+	case TypeCode::Unchecked: return "?";
+	case TypeCode::Error: return "ERROR";
+	case TypeCode::Void: return "void";
+	case TypeCode::Int: return "int";
+	case TypeCode::Bool: return "bool";
+	case TypeCode::Char: return "char";
+	case TypeCode::IntPtr: return "intptr";
+	case TypeCode::BoolPtr: return "boolptr";
+	case TypeCode::CharPtr: return "charptr";
+	case TypeCode::Null: return "NULLPTR";
+	case TypeCode::Fn: break;
+	}
+	std::string text;
+	for (const DataType * formal : myFormals){
+		if (!text.empty()){ text += ","; }
+		text += formal->str();
+	}
+	return text + "->" + myRet->str();
+}
+
+const DataType * ExpNode::type() const{
+	if (myType == TypeCode::Unchecked){ return nullptr; }
+	if (myType != TypeCode::Fn){ return DataType::of(myType); }
+	/* Only a name can have a function's type */
+	const IDNode * id = static_cast<const IDNode *>(this);
+	return static_cast<FnDeclNode *>(id->decl())->signature();
+}
+
+} //End namespace holeyc
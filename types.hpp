@@ -0,0 +1,90 @@
+#ifndef HOLEYC_TYPES_HPP
+#define HOLEYC_TYPES_HPP
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace holeyc{
+
+class TypeNode;
+
+/**
+* What kind of type a DataType is, and all an ExpNode keeps of its
+* type: one byte, which for every type but a function's is enough to
+* get the DataType back (see DataType::of). Unchecked marks a node
+* the type checker has not reached.
+**/
+enum class TypeCode : uint8_t{
+	Unchecked, Error, Void, Int, Bool, Char, IntPtr, BoolPtr, CharPtr,
+	Null, Fn,
+};
+
+/**
+* \class DataType
+* A semantic type. Each type exists once, so two types are equal
+* exactly when their pointers are: the types a program can write
+* down without a function are fixed singletons, and function types
+* are interned by signature in a process-wide table that, like the
+* Interner, may be used from several threads. A DataType is never
+* freed or moved.
+*
+* Error is the type of an expression that failed to check; the
+* checker lets it through silently, so one mistake is reported once.
+* Null is the type of NULLPTR, which goes wherever a pointer does.
+**/
+class DataType{
+public:
+	DataType(const DataType&) = delete;
+	DataType& operator=(const DataType&) = delete;
+
+	TypeCode code() const { return myCode; }
+	bool isPtr() const {
+		return myCode == TypeCode::IntPtr || myCode == TypeCode::BoolPtr
+			|| myCode == TypeCode::CharPtr;
+	}
+	/** int, bool or char: what a pointer can point to **/
+	bool isBasic() const {
+		return myCode == TypeCode::Int || myCode == TypeCode::Bool
+			|| myCode == TypeCode::Char;
+	}
+	bool isFn() const { return myCode == TypeCode::Fn; }
+	/** What a pointer type points to, or nullptr **/
+	const DataType * base() const;
+	/** The pointer to a basic type, or nullptr **/
+	const DataType * ptrTo() const;
+	/** Whether a value of type from may be stored in this type **/
+	bool accepts(const DataType * from) const {
+		return from == this || (isPtr() && from->myCode == TypeCode::Null);
+	}
+
+	/** A function's formal types and return type **/
+	const std::vector<const DataType *>& formals() const { return myFormals; }
+	const DataType * ret() const { return myRet; }
+
+	/** As written in the source, e.g. intptr or int,bool->void **/
+	std::string str() const;
+
+	/** The singleton for any code but Fn (and Unchecked) **/
+	static const DataType * of(TypeCode code);
+	/** The type a declaration's TypeNode names **/
+	static const DataType * of(TypeNode * node);
+	/** The one function type with these formals and return type **/
+	static const DataType * fn(
+		const std::vector<const DataType *>& formals, const DataType * ret);
+
+private:
+	explicit DataType(TypeCode code) : myCode(code), myRet(nullptr){ }
+	DataType(std::vector<const DataType *> formals, const DataType * ret)
+	: myCode(TypeCode::Fn), myFormals(std::move(formals)), myRet(ret){ }
+	friend class FnTypes;
+
+	TypeCode myCode;
+	std::vector<const DataType *> myFormals;
+	const DataType * myRet;
+};
+
+} //End namespace holeyc
+
+#endif
@@ -1,327 +1,441 @@
-#include "ast.hpp"
+#include <climits>
+#include "errors.hpp"
+#include "unparser.hpp"
+#include "visitor.hpp"
 
 namespace holeyc{
 
+using Unparser = UnparseStack<ASTNode *>;
+
 /*
 doIndent is declared static, which means that it can
 only be called in this file (its symbol is not exported).
 */
-static void doIndent(std::ostream& out, int indent){
-	for (int k = 0 ; k < indent; k++){ out << "\t"; }
+static void doIndent(Unparser& out, int indent){
+	out.indent(indent);
 }
 
 /*
 In this code, the intention is that functions are grouped
-into files by purpose, rather than by class.
-If you're used to having all of the functions of a class
-defined in the same file, this style may be a bit disorienting,
-though it is legal. Thus, we can have
-ProgramNode::unparse, which is the unparse method of ProgramNodes
-defined in the same file as DeclNode::unparse, the unparse method
-of DeclNodes.
+into files by purpose, rather than by class. Here every visit
+method of Unparse prints one kind of node, so the unparse code
+for all of the classes sits together in this file.
 */
 
-void AssignExpNode::unparse(std::ostream& out, int indent){
-	doIndent(out, indent);
-	myTgt->unparse(out,0);
-	out << " = ";
-	mySrc->unparse(out,0);
+/*
+Each visit prints only its node's own text and hands the node's
+children to the Unparser, which prints them from an explicit stack.
+*/
+class Unparse : public ASTVisitor<Unparse>{
+public:
+	/** names: follow each linked name with its type (-n) **/
+	explicit Unparse(Unparser& out, bool names = false)
+	: myOut(out), myIndent(0), myNames(names){ }
+
+	void step(ASTNode * node, int indent){
+		myIndent = indent;
+		visit(node);
+	}
+
+	void visitAssignExp(AssignExpNode * node);
+	void visitBinaryExp(BinaryExpNode * node);
+	void visitCallExp(CallExpNode * node);
+	void visitCharLit(CharLitNode * node);
+	void visitFalse(FalseNode * node);
+	void visitIntLit(IntLitNode * node);
+	void visitDeref(DerefNode * node);
+	void visitID(IDNode * node);
+	void visitIndex(IndexNode * node);
+	void visitRef(RefNode * node);
+	void visitNullPtr(NullPtrNode * node);
+	void visitStrLit(StrLitNode * node);
+	void visitTrue(TrueNode * node);
+	void visitNeg(NegNode * node);
+	void visitNot(NotNode * node);
+	void visitFormalsList(FormalsListNode * node);
+	void visitStmtList(StmtListNode * node);
+	void visitFnBody(FnBodyNode * node);
+	void visitProgram(ProgramNode * node);
+	void visitAssignStmt(AssignStmtNode * node);
+	void visitCallStmt(CallStmtNode * node);
+	void visitFnDecl(FnDeclNode * node);
+	void visitVarDecl(VarDeclNode * node);
+	void visitFormalDecl(FormalDeclNode * node);
+	void visitFromConsole(FromConsoleStmtNode * node);
+	void visitIfElse(IfElseStmtNode * node);
+	void visitIf(IfStmtNode * node);
+	void visitPostDec(PostDecStmtNode * node);
+	void visitPostInc(PostIncStmtNode * node);
+	void visitReturn(ReturnStmtNode * node);
+	void visitToConsole(ToConsoleStmtNode * node);
+	void visitWhile(WhileStmtNode * node);
+	void visitBoolType(BoolTypeNode *){ myOut << "bool"; }
+	void visitCharType(CharTypeNode *){ myOut << "char"; }
+	void visitIntType(IntTypeNode *){ myOut << "int"; }
+	void visitVoidType(VoidTypeNode *){ myOut << "void"; }
+	void visitBoolPtr(BoolPtrNode *){ myOut << "boolptr"; }
+	void visitCharPtr(CharPtrNode *){ myOut << "charptr"; }
+	void visitIntPtr(IntPtrNode *){ myOut << "intptr"; }
+
+private:
+	void typeOf(DeclNode * decl);
+
+	Unparser& myOut;
+	int myIndent; /// The indent of the node being visited
+	bool myNames;
+};
+
+void ASTNode::unparse(Writer& out, int indent){
+	Unparser unparser(out);
+	Unparse pass(unparser);
+	unparser.run(this, indent, [&](Unparser&, ASTNode * node, int at){
+		pass.step(node, at);
+	});
+}
+
+void ProgramNode::unparseNames(Writer& out){
+	Unparser unparser(out);
+	Unparse pass(unparser, true);
+	unparser.run(this, 0, [&](Unparser&, ASTNode * node, int at){
+		pass.step(node, at);
+	});
+}
+
+/* A variable's type, or a function's formal types and return type */
+void Unparse::typeOf(DeclNode * decl){
+	myOut << "(";
+	if (decl->kind() == NodeKind::FnDecl){
+		FnDeclNode * fn = static_cast<FnDeclNode *>(decl);
+		int i = 0;
+		for (auto formal : *fn->formals()->formals()){
+			if (i != 0){
+				myOut << ",";
+			}
+			myOut.child(formal->type(), 0);
+			i++;
+		}
+		myOut << "->";
+		myOut.child(fn->retType(), 0);
+	} else {
+		myOut.child(static_cast<VarDeclNode *>(decl)->type(), 0);
+	}
+	myOut << ")";
+}
+
+static const char * binaryOp(NodeKind kind){
+	switch (kind){
+	case NodeKind::Plus: return " + ";
+	case NodeKind::Minus: return " - ";
+	case NodeKind::Times: return " * ";
+	case NodeKind::Divide: return " / ";
+	case NodeKind::And: return " && ";
+	case NodeKind::Or: return " || ";
+	case NodeKind::Equals: return " == ";
+	case NodeKind::NotEquals: return " != ";
+	case NodeKind::Less: return " < ";
+	case NodeKind::Greater: return " > ";
+	case NodeKind::LessEq: return " <= ";
+	case NodeKind::GreaterEq: return " >= ";
+	default: break;
+	}
+	throw new InternalError("not a binary operator");
 }
 
-void BinaryExpNode::unparse(std::ostream& out, int indent){
-	doIndent(out, indent);
-	out << "(";
-	myLHS->unparse(out,0);
-	out << myOp();
-	myRHS->unparse(out,0);
-	out << ")";
+void Unparse::visitAssignExp(AssignExpNode * node){
+	doIndent(myOut, myIndent);
+	myOut.child(node->tgt(), 0);
+	myOut << " = ";
+	myOut.child(node->src(), 0);
+}
+
+void Unparse::visitBinaryExp(BinaryExpNode * node){
+	doIndent(myOut, myIndent);
+	myOut << "(";
+	myOut.child(node->lhs(), 0);
+	myOut << binaryOp(node->kind());
+	myOut.child(node->rhs(), 0);
+	myOut << ")";
 }
 
-void CallExpNode::unparse(std::ostream& out, int indent){
+void Unparse::visitCallExp(CallExpNode * node){
 	int i = 0;
-	doIndent(out, indent);
-	myId->unparse(out,0);
-	out << "(";
-	if(myExpList != nullptr){
-		for (auto f: *myExpList)
+	doIndent(myOut, myIndent);
+	myOut.child(node->id(), 0);
+	myOut << "(";
+	if(node->args() != nullptr){
+		for (auto f: *node->args())
 		{
 			if (i!=0) {
-				out << ",";
+				myOut << ",";
 			}
-			f->unparse(out, indent+1);
+			myOut.child(f, myIndent+1);
 			i++;
 		}
 	}
-	out << ")";
+	myOut << ")";
 }
 
-void CharLitNode::unparse(std::ostream& out, int indent){
-	doIndent(out, indent);
-	out << myChar;
+void Unparse::visitCharLit(CharLitNode * node){
+	doIndent(myOut, myIndent);
+	myOut << node->val();
 }
 
-void FalseNode::unparse(std::ostream& out, int indent){
-	doIndent(out, indent);
-	out << "false";
+void Unparse::visitFalse(FalseNode * node){
+	doIndent(myOut, myIndent);
+	myOut << "false";
 }
 
-void IntLitNode::unparse(std::ostream& out, int indent){
-	doIndent(out, indent);
-	out << myInt;
+void Unparse::visitIntLit(IntLitNode * node){
+	doIndent(myOut, myIndent);
+	/* Only folding (-f) makes negative literals; write them the way
+	   a negated literal is written, and the one whose magnitude has
+	   no literal as a difference */
+	if (node->num() == INT_MIN){
+		myOut << "((-" << INT_MAX << ") - 1)";
+	} else if (node->num() < 0){
+		myOut << "(" << node->num() << ")";
+	} else {
+		myOut << node->num();
+	}
 }
 
 
 //----------------------------------------------------------------LValNode
-void DerefNode::unparse(std::ostream& out, int indent){
-	doIndent(out, indent);
-	out << "@";
-	myTgt->unparse(out,0);
+void Unparse::visitDeref(DerefNode * node){
+	doIndent(myOut, myIndent);
+	myOut << "@";
+	myOut.child(node->tgt(), 0);
 }
 
-void IDNode::unparse(std::ostream& out, int indent){
-	out << this->myStrVal;
+void Unparse::visitID(IDNode * node){
+	myOut << node->name();
+	if (myNames && node->decl() != nullptr){ typeOf(node->decl()); }
 }
 
-void IndexNode::unparse(std::ostream& out, int indent){
-	doIndent(out, indent);
-	myTgt->unparse(out,0);
-	out << "[";
-	myOff->unparse(out,0);
-	out << "]";
+void Unparse::visitIndex(IndexNode * node){
+	doIndent(myOut, myIndent);
+	myOut.child(node->tgt(), 0);
+	myOut << "[";
+	myOut.child(node->off(), 0);
+	myOut << "]";
 }
 
-void RefNode::unparse(std::ostream& out, int indent){
-	doIndent(out, indent);
-	out << "^";
-	myTgt->unparse(out,0);
+void Unparse::visitRef(RefNode * node){
+	doIndent(myOut, myIndent);
+	myOut << "^";
+	myOut.child(node->tgt(), 0);
 }
 
 
-void NullPtrNode::unparse(std::ostream& out, int indent){
-	out << "NULLPTR";
+void Unparse::visitNullPtr(NullPtrNode * node){
+	myOut << "NULLPTR";
 }
 
-void StrLitNode::unparse(std::ostream& out, int indent){
-	doIndent(out, indent);
-	out << myString;
+void Unparse::visitStrLit(StrLitNode * node){
+	doIndent(myOut, myIndent);
+	myOut << node->str();
 }
 
-void TrueNode::unparse(std::ostream& out, int indent){
-	doIndent(out, indent);
-	out << "true";
+void Unparse::visitTrue(TrueNode * node){
+	doIndent(myOut, myIndent);
+	myOut << "true";
 }
 
 //-----------------------------------------------------------------------UnaryExpNode
-void UnaryExpNode::unparse(std::ostream& out, int indent){
-	doIndent(out, indent);
-	out << "(";
-	myExp->unparse(out,0);
-	out << ")";
+void Unparse::visitNeg(NegNode * node){
+	doIndent(myOut, myIndent);
+	myOut << "(";
+	myOut << "-";
+	myOut.child(node->exp(), 0);
+	myOut << ")";
 }
 
-void NegNode::unparse(std::ostream& out, int indent){
-	doIndent(out, indent);
-	out << "(";
-	out << "-";
-	myExp->unparse(out,0);
-	out << ")";
+void Unparse::visitNot(NotNode * node){
+	doIndent(myOut, myIndent);
+	myOut << "(";
+	myOut << "!";
+	myOut.child(node->exp(), 0);
+	myOut << ")";
 }
 
-void NotNode::unparse(std::ostream& out, int indent){
-	doIndent(out, indent);
-	out << "(";
-	out << "!";
-	myExp->unparse(out,0);
-	out << ")";
-}
-
-void FormalsListNode::unparse(std::ostream& out, int indent){
+void Unparse::visitFormalsList(FormalsListNode * node){
 	int i =0;
-	doIndent(out, indent);
-	for (auto f: *myFormals)
+	doIndent(myOut, myIndent);
+	for (auto f: *node->formals())
 	{
 		if (i != 0) {
-			out << ",";
+			myOut << ",";
 		}
-		f->unparse(out, indent+1);
+		myOut.child(f, myIndent+1);
 		i++;
 	}
 
 }
 
-void StmtListNode::unparse(std::ostream& out, int indent){
-	doIndent(out, indent);
-	for (auto s: *myStmts)
-		s->unparse(out, indent+1);
+void Unparse::visitStmtList(StmtListNode * node){
+	doIndent(myOut, myIndent);
+	for (auto s: *node->stmts())
+		myOut.child(s, myIndent+1);
 }
 
-void FnBodyNode::unparse(std::ostream& out, int indent){
-	doIndent(out, indent);
-	out << "{\n";
-	myStmtList->unparse(out,indent+4);
-	out << "}\n";
+void Unparse::visitFnBody(FnBodyNode * node){
+	doIndent(myOut, myIndent);
+	myOut << "{\n";
+	myOut.child(node->stmts(), myIndent+4);
+	myOut << "}\n";
 }
 
 
-void ProgramNode::unparse(std::ostream& out, int indent){
+void Unparse::visitProgram(ProgramNode * node){
 	/* Oh, hey it's a for-each loop in C++!
 	   The loop iterates over each element in a collection
 	   without that gross i++ nonsense.
 	 */
-	for (auto global : *myGlobals){
+	for (auto global : *node->globals()){
 		/* The auto keyword tells the compiler
-		   to (try to) figure out what the
+		   to (try to) figure myOut what the
 		   type of a variable should be from
 		   context. here, since we're iterating
 		   over a list of DeclNode *s, it's
 		   pretty clear that global is of
 		   type DeclNode *.
 		*/
-		global->unparse(out, indent);
+		myOut.child(global, myIndent);
+	}
+}
+
+void ProgramNode::unparseInterface(Writer& out){
+	for (auto global : *myGlobals){
+		global->unparseInterface(out);
 	}
 }
 
 //--------------------------------------StmtNode
-void AssignStmtNode::unparse(std::ostream& out, int indent){
-	doIndent(out, indent);
-	myAssign->unparse(out,0);
-	out << ";\n";
+void Unparse::visitAssignStmt(AssignStmtNode * node){
+	doIndent(myOut, myIndent);
+	myOut.child(node->assign(), 0);
+	myOut << ";\n";
 }
 
-void CallStmtNode::unparse(std::ostream& out, int indent){
-	doIndent(out, indent);
-	myCallExp->unparse(out,0);
-	out << ";\n";
+void Unparse::visitCallStmt(CallStmtNode * node){
+	doIndent(myOut, myIndent);
+	myOut.child(node->callExp(), 0);
+	myOut << ";\n";
 }
 
 
 //DeclNode
-void FnDeclNode::unparse(std::ostream& out, int indent){
-	doIndent(out, indent);
-	myRe->unparse(out,0);
+void Unparse::visitFnDecl(FnDeclNode * node){
+	doIndent(myOut, myIndent);
+	myOut.child(node->retType(), 0);
+	myOut << " ";
+	myOut.child(node->id(), 0);
+	myOut << "(";
+	myOut.child(node->formals(), 0);
+	myOut << ")";
+	myOut.child(node->body(), 0);
+
+}
+
+/* A function's signature; any other declaration in full */
+void DeclNode::unparseInterface(Writer& out){
+	if (kind() != NodeKind::FnDecl){
+		unparse(out, 0);
+		return;
+	}
+	FnDeclNode * fn = static_cast<FnDeclNode *>(this);
+	fn->retType()->unparse(out,0);
 	out << " ";
-	myID->unparse(out,0);
+	fn->id()->unparse(out,0);
 	out << "(";
-	myFormals->unparse(out, 0);
-	out << ")";
-	myBody->unparse(out, 0);
-
-}
-
-void VarDeclNode::unparse(std::ostream& out, int indent){
-	doIndent(out, indent);
-	this->myType->unparse(out, 0);
-	out << " ";
-	this->myId->unparse(out, 0);
-	out << ";\n";
-}
-
-void FormalDeclNode::unparse(std::ostream& out, int indent){
-	doIndent(out, indent);
-	myType->unparse(out, 0);
-	out << " ";
-	myID->unparse(out, 0);
-}
-
-
-void FromConsoleStmtNode::unparse(std::ostream& out, int indent){
-	doIndent(out, indent);
-	out<<"FROMCONSOLE ";
-	myVal->unparse(out, 0);
-	out<<";\n";
-}
-
-void IfElseStmtNode::unparse(std::ostream& out, int indent){
-	doIndent(out, indent);
-	out << "if (";
-	myExp->unparse(out,0);
-	out << ") {\n";
-	for (auto s: *myStmtsT)
-		s->unparse(out, indent+1);
-	doIndent(out, indent);
-	out << "} else {\n";
-	for (auto s: *myStmtsF)
-		s->unparse(out, indent+1);
-	doIndent(out, indent);
-	out << "}\n";
-}
-
-void IfStmtNode::unparse(std::ostream& out, int indent){
-	doIndent(out, indent);
-	out << "if (";
-	myExp->unparse(out,0);
-	out << ") {\n";
-	for (auto s: *myStmts)
-		s->unparse(out, indent+1);
-	doIndent(out, indent);
-	out << "}\n";
-}
-
-void PostDecStmtNode::unparse(std::ostream& out, int indent){
-	doIndent(out, indent);
-	myExp->unparse(out, 0);
-	out<<"--;\n";
-}
-
-void PostIncStmtNode::unparse(std::ostream& out, int indent){
-	doIndent(out, indent);
-	myExp->unparse(out, 0);
-	out<<"++;\n";
-}
-
-void ReturnStmtNode::unparse(std::ostream& out, int indent){
-	doIndent(out, indent);
-	out<<"return ";
-	if(myExp != nullptr){ myExp->unparse(out, 0); }
-	out<<";\n";
-}
-
-void ToConsoleStmtNode::unparse(std::ostream& out, int indent){
-	doIndent(out, indent);
-	out<<"TOCONSOLE ";
-	myExp->unparse(out, 0);
-	out<<";\n";
-}
-
-void WhileStmtNode::unparse(std::ostream& out, int indent){
-	doIndent(out, indent);
-	out << "while (";
-	myExp->unparse(out,0);
-	out << ") {\n";
-	for (auto s: *myStmts)
-		s->unparse(out, indent+1);
-	doIndent(out, indent);
-	out << "}\n";
-}
-
-
-//TypeNode
-void BoolTypeNode::unparse(std::ostream& out, int indent){
-	out << "bool";
-}
-
-void CharTypeNode::unparse(std::ostream& out, int indent){
-	out << "char";
-}
-
-void IntTypeNode::unparse(std::ostream& out, int indent){
-	out << "int";
-}
-
-void VoidTypeNode::unparse(std::ostream& out, int indent){
-	out << "void";
-}
-
-void BoolPtrNode::unparse(std::ostream& out, int indent){
-	out << "boolptr";
-}
-
-void CharPtrNode::unparse(std::ostream& out, int indent){
-	out << "charptr";
-}
-
-void IntPtrNode::unparse(std::ostream& out, int indent){
-	out << "intptr";
+	fn->formals()->unparse(out, 0);
+	out << ");\n";
+}
+
+void Unparse::visitVarDecl(VarDeclNode * node){
+	doIndent(myOut, myIndent);
+	myOut.child(node->type(), 0);
+	myOut << " ";
+	myOut.child(node->id(), 0);
+	myOut << ";\n";
+}
+
+void Unparse::visitFormalDecl(FormalDeclNode * node){
+	doIndent(myOut, myIndent);
+	myOut.child(node->type(), 0);
+	myOut << " ";
+	myOut.child(node->id(), 0);
+}
+
+
+void Unparse::visitFromConsole(FromConsoleStmtNode * node){
+	doIndent(myOut, myIndent);
+	myOut<<"FROMCONSOLE ";
+	myOut.child(node->val(), 0);
+	myOut<<";\n";
+}
+
+void Unparse::visitIfElse(IfElseStmtNode * node){
+	doIndent(myOut, myIndent);
+	myOut << "if (";
+	myOut.child(node->exp(), 0);
+	myOut << ") {\n";
+	for (auto s: *node->stmtsT())
+		myOut.child(s, myIndent+1);
+	doIndent(myOut, myIndent);
+	myOut << "} else {\n";
+	for (auto s: *node->stmtsF())
+		myOut.child(s, myIndent+1);
+	doIndent(myOut, myIndent);
+	myOut << "}\n";
+}
+
+void Unparse::visitIf(IfStmtNode * node){
+	doIndent(myOut, myIndent);
+	myOut << "if (";
+	myOut.child(node->exp(), 0);
+	myOut << ") {\n";
+	for (auto s: *node->stmts())
+		myOut.child(s, myIndent+1);
+	doIndent(myOut, myIndent);
+	myOut << "}\n";
+}
+
+void Unparse::visitPostDec(PostDecStmtNode * node){
+	doIndent(myOut, myIndent);
+	myOut.child(node->exp(), 0);
+	myOut<<"--;\n";
+}
+
+void Unparse::visitPostInc(PostIncStmtNode * node){
+	doIndent(myOut, myIndent);
+	myOut.child(node->exp(), 0);
+	myOut<<"++;\n";
+}
+
+void Unparse::visitReturn(ReturnStmtNode * node){
+	doIndent(myOut, myIndent);
+	myOut<<"return ";
+	if(node->exp() != nullptr){ myOut.child(node->exp(), 0); }
+	myOut<<";\n";
+}
+
+void Unparse::visitToConsole(ToConsoleStmtNode * node){
+	doIndent(myOut, myIndent);
+	myOut<<"TOCONSOLE ";
+	myOut.child(node->exp(), 0);
+	myOut<<";\n";
+}
+
+void Unparse::visitWhile(WhileStmtNode * node){
+	doIndent(myOut, myIndent);
+	myOut << "while (";
+	myOut.child(node->exp(), 0);
+	myOut << ") {\n";
+	for (auto s: *node->stmts())
+		myOut.child(s, myIndent+1);
+	doIndent(myOut, myIndent);
+	myOut << "}\n";
 }
 
 } // End namespace holeyc
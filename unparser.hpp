@@ -0,0 +1,100 @@
+#ifndef HOLEYC_UNPARSER_HPP
+#define HOLEYC_UNPARSER_HPP
+
+#include <vector>
+#include "strref.hpp"
+#include "writer.hpp"
+
+namespace holeyc{
+
+/**
+* \class UnparseStack
+* Explicit work stack behind the unparsers, so that a tree of any
+* depth prints without deep native recursion. A step prints one node:
+* it writes the node's own text with operator<< and schedules its
+* children with child(). Text that follows a scheduled child is held
+* on the stack until that child (and all below it) has been printed;
+* text before the first child goes straight to the Writer.
+**/
+template <typename Node>
+class UnparseStack{
+public:
+	explicit UnparseStack(Writer& out) : myOut(out){ }
+	UnparseStack(const UnparseStack&) = delete;
+	UnparseStack& operator=(const UnparseStack&) = delete;
+
+	/**
+	* Print root at indent and everything below it, calling
+	* step(*this, node, indent) once per node.
+	**/
+	template <typename Step>
+	void run(Node root, int indent, Step step){
+		myStack.push_back(Item{Item::NODE, root, indent, StrRef()});
+		while (!myStack.empty()){
+			Item item = myStack.back();
+			myStack.pop_back();
+			switch (item.kind){
+			case Item::NODE:
+				step(*this, item.node, item.num);
+				/* Reversed, so the first scheduled piece is on top */
+				myStack.insert(myStack.end(),
+					myFrame.rbegin(), myFrame.rend());
+				myFrame.clear();
+				break;
+			case Item::TEXT: myOut << item.text; break;
+			case Item::INT: myOut << item.num; break;
+			case Item::CHAR: myOut << static_cast<char>(item.num); break;
+			case Item::INDENT: myOut.indent(item.num); break;
+			}
+		}
+	}
+
+	/** Print node at indent once the text scheduled so far is out **/
+	void child(Node node, int indent){
+		myFrame.push_back(Item{Item::NODE, node, indent, StrRef()});
+	}
+
+	UnparseStack& operator<<(StrRef text){
+		if (myFrame.empty()){ myOut << text; }
+		else { hold(Item::TEXT, 0, text); }
+		return *this;
+	}
+	UnparseStack& operator<<(const char * text){
+		return *this << StrRef(text);
+	}
+	UnparseStack& operator<<(int num){
+		if (myFrame.empty()){ myOut << num; }
+		else { hold(Item::INT, num, StrRef()); }
+		return *this;
+	}
+	UnparseStack& operator<<(char ch){
+		if (myFrame.empty()){ myOut << ch; }
+		else { hold(Item::CHAR, ch, StrRef()); }
+		return *this;
+	}
+	void indent(int indent){
+		if (myFrame.empty()){ myOut.indent(indent); }
+		else { hold(Item::INDENT, indent, StrRef()); }
+	}
+
+private:
+	struct Item{
+		enum Kind{ NODE, TEXT, INT, CHAR, INDENT } kind;
+		Node node;
+		int num; /// The indent of a NODE, or the value to print
+		StrRef text;
+	};
+
+	void hold(typename Item::Kind kind, int num, StrRef text){
+		myFrame.push_back(Item{kind, Node(), num, text});
+	}
+
+	Writer& myOut;
+	std::vector<Item> myStack;
+	/** What the current step has scheduled, in order **/
+	std::vector<Item> myFrame;
+};
+
+} //End namespace holeyc
+
+#endif
@@ -0,0 +1,62 @@
+# Derives validator.yy from holeyc.yy: the same grammar with every
+# action and semantic type stripped, generating holeyc::Validator.
+# It accepts exactly the programs Parser accepts (same tables, same
+# syntax error messages) but builds no AST; see
+# CompilationSession::validate. Keep holeyc.yy free of '{' and '}'
+# outside actions in the rules section, or this will misread it.
+
+BEGIN { section = 0; depth = 0; inUnion = 0 }
+
+/^%%/ { section++; print; next }
+
+# Declarations: rename the class and drop everything about values
+section == 0 {
+	if ($0 ~ /^%define api.parser.class/){
+		print "%define api.parser.class {Validator}"
+		next
+	}
+	if ($0 ~ /^%output/){
+		print "%output \"validator.cc\""
+		next
+	}
+	if ($0 ~ /^%parse-param/ && $0 !~ /TokenSource/){ next }
+	if ($0 ~ /^%code requires/){
+		print
+		print "\t#include \"grammar.hh\""
+		next
+	}
+	# Shares Parser's value type, so both pull from TokenSource::next
+	if ($0 ~ /^%union/){
+		inUnion = 1
+		print "%define api.value.type {holeyc::Parser::semantic_type}"
+		next
+	}
+	if (inUnion){
+		if ($0 ~ /^}/){ inUnion = 0 }
+		next
+	}
+	if ($0 ~ /^%type/){ next }
+	if ($0 ~ /^%token/){ sub(/<[A-Za-z_]*>/, "") }
+	print
+	next
+}
+
+# Rules: keep the productions, drop the braced actions
+section == 1 {
+	out = ""
+	inAction = depth > 0
+	for (i = 1; i <= length($0); i++){
+		c = substr($0, i, 1)
+		if (c == "{"){ depth++; inAction = 1; continue }
+		if (c == "}"){ depth--; continue }
+		if (depth == 0){ out = out c }
+	}
+	if (!inAction || out ~ /[^ \t]/){ print out }
+	next
+}
+
+# Epilogue: the same error hook, on the other class
+{
+	gsub(/Parser::error/, "Validator::error")
+	print
+}
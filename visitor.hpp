@@ -0,0 +1,220 @@
+#ifndef HOLEYC_VISITOR_HPP
+#define HOLEYC_VISITOR_HPP
+
+#include "ast.hpp"
+
+namespace holeyc{
+
+/**
+* \class ASTVisitor
+* Base for passes over the pointer tree. visit() switches on the
+* node's kind and calls Derived's visitX for the node's class, with
+* the node already cast; there are no virtual calls, so a pass's
+* methods can be inlined into the switch.
+*
+* A pass defines only the visitX it cares about. The rest fall back
+* along the class hierarchy, e.g. visitPlus to visitBinaryExp to
+* visitExp to visitNode, whose default does nothing and returns R().
+*
+* Visiting does not descend: a pass visits children itself, or
+* schedules them on an explicit stack for trees of any depth (see
+* unparse.cpp and flatten.cpp).
+**/
+template <typename Derived, typename R = void>
+class ASTVisitor{
+public:
+	R visit(ASTNode * node){
+		switch (node->kind()){
+		case NodeKind::Program:
+			return self().visitProgram(static_cast<ProgramNode *>(node));
+		case NodeKind::VarDecl:
+			return self().visitVarDecl(static_cast<VarDeclNode *>(node));
+		case NodeKind::FormalDecl:
+			return self().visitFormalDecl(
+				static_cast<FormalDeclNode *>(node));
+		case NodeKind::FnDecl:
+			return self().visitFnDecl(static_cast<FnDeclNode *>(node));
+		case NodeKind::FormalsList:
+			return self().visitFormalsList(
+				static_cast<FormalsListNode *>(node));
+		case NodeKind::StmtList:
+			return self().visitStmtList(static_cast<StmtListNode *>(node));
+		case NodeKind::FnBody:
+			return self().visitFnBody(static_cast<FnBodyNode *>(node));
+		case NodeKind::IntType:
+			return self().visitIntType(static_cast<IntTypeNode *>(node));
+		case NodeKind::BoolType:
+			return self().visitBoolType(static_cast<BoolTypeNode *>(node));
+		case NodeKind::CharType:
+			return self().visitCharType(static_cast<CharTypeNode *>(node));
+		case NodeKind::VoidType:
+			return self().visitVoidType(static_cast<VoidTypeNode *>(node));
+		case NodeKind::IntPtr:
+			return self().visitIntPtr(static_cast<IntPtrNode *>(node));
+		case NodeKind::BoolPtr:
+			return self().visitBoolPtr(static_cast<BoolPtrNode *>(node));
+		case NodeKind::CharPtr:
+			return self().visitCharPtr(static_cast<CharPtrNode *>(node));
+		case NodeKind::AssignStmt:
+			return self().visitAssignStmt(
+				static_cast<AssignStmtNode *>(node));
+		case NodeKind::CallStmt:
+			return self().visitCallStmt(static_cast<CallStmtNode *>(node));
+		case NodeKind::FromConsole:
+			return self().visitFromConsole(
+				static_cast<FromConsoleStmtNode *>(node));
+		case NodeKind::ToConsole:
+			return self().visitToConsole(
+				static_cast<ToConsoleStmtNode *>(node));
+		case NodeKind::PostInc:
+			return self().visitPostInc(static_cast<PostIncStmtNode *>(node));
+		case NodeKind::PostDec:
+			return self().visitPostDec(static_cast<PostDecStmtNode *>(node));
+		case NodeKind::If:
+			return self().visitIf(static_cast<IfStmtNode *>(node));
+		case NodeKind::IfElse:
+			return self().visitIfElse(static_cast<IfElseStmtNode *>(node));
+		case NodeKind::While:
+			return self().visitWhile(static_cast<WhileStmtNode *>(node));
+		case NodeKind::Return:
+			return self().visitReturn(static_cast<ReturnStmtNode *>(node));
+		case NodeKind::AssignExp:
+			return self().visitAssignExp(static_cast<AssignExpNode *>(node));
+		case NodeKind::CallExp:
+			return self().visitCallExp(static_cast<CallExpNode *>(node));
+		case NodeKind::Plus:
+			return self().visitPlus(static_cast<PlusNode *>(node));
+		case NodeKind::Minus:
+			return self().visitMinus(static_cast<MinusNode *>(node));
+		case NodeKind::Times:
+			return self().visitTimes(static_cast<TimesNode *>(node));
+		case NodeKind::Divide:
+			return self().visitDivide(static_cast<DivideNode *>(node));
+		case NodeKind::And:
+			return self().visitAnd(static_cast<AndNode *>(node));
+		case NodeKind::Or:
+			return self().visitOr(static_cast<OrNode *>(node));
+		case NodeKind::Equals:
+			return self().visitEquals(static_cast<EqualsNode *>(node));
+		case NodeKind::NotEquals:
+			return self().visitNotEquals(static_cast<NotEqualsNode *>(node));
+		case NodeKind::Less:
+			return self().visitLess(static_cast<LessNode *>(node));
+		case NodeKind::Greater:
+			return self().visitGreater(static_cast<GreaterNode *>(node));
+		case NodeKind::LessEq:
+			return self().visitLessEq(static_cast<LessEqNode *>(node));
+		case NodeKind::GreaterEq:
+			return self().visitGreaterEq(static_cast<GreaterEqNode *>(node));
+		case NodeKind::Neg:
+			return self().visitNeg(static_cast<NegNode *>(node));
+		case NodeKind::Not:
+			return self().visitNot(static_cast<NotNode *>(node));
+		case NodeKind::ID:
+			return self().visitID(static_cast<IDNode *>(node));
+		case NodeKind::IntLit:
+			return self().visitIntLit(static_cast<IntLitNode *>(node));
+		case NodeKind::CharLit:
+			return self().visitCharLit(static_cast<CharLitNode *>(node));
+		case NodeKind::StrLit:
+			return self().visitStrLit(static_cast<StrLitNode *>(node));
+		case NodeKind::True:
+			return self().visitTrue(static_cast<TrueNode *>(node));
+		case NodeKind::False:
+			return self().visitFalse(static_cast<FalseNode *>(node));
+		case NodeKind::NullPtr:
+			return self().visitNullPtr(static_cast<NullPtrNode *>(node));
+		case NodeKind::Deref:
+			return self().visitDeref(static_cast<DerefNode *>(node));
+		case NodeKind::Ref:
+			return self().visitRef(static_cast<RefNode *>(node));
+		case NodeKind::Index:
+			return self().visitIndex(static_cast<IndexNode *>(node));
+		}
+		return self().visitNode(node);
+	}
+
+	//Concrete classes
+	R visitProgram(ProgramNode * node){ return self().visitNode(node); }
+	R visitVarDecl(VarDeclNode * node){ return self().visitDecl(node); }
+	R visitFormalDecl(FormalDeclNode * node){
+		return self().visitVarDecl(node);
+	}
+	R visitFnDecl(FnDeclNode * node){ return self().visitDecl(node); }
+	R visitFormalsList(FormalsListNode * node){
+		return self().visitNode(node);
+	}
+	R visitStmtList(StmtListNode * node){ return self().visitNode(node); }
+	R visitFnBody(FnBodyNode * node){ return self().visitNode(node); }
+
+	R visitIntType(IntTypeNode * node){ return self().visitType(node); }
+	R visitBoolType(BoolTypeNode * node){ return self().visitType(node); }
+	R visitCharType(CharTypeNode * node){ return self().visitType(node); }
+	R visitVoidType(VoidTypeNode * node){ return self().visitType(node); }
+	R visitIntPtr(IntPtrNode * node){ return self().visitType(node); }
+	R visitBoolPtr(BoolPtrNode * node){ return self().visitType(node); }
+	R visitCharPtr(CharPtrNode * node){ return self().visitType(node); }
+
+	R visitAssignStmt(AssignStmtNode * node){ return self().visitStmt(node); }
+	R visitCallStmt(CallStmtNode * node){ return self().visitStmt(node); }
+	R visitFromConsole(FromConsoleStmtNode * node){
+		return self().visitStmt(node);
+	}
+	R visitToConsole(ToConsoleStmtNode * node){
+		return self().visitStmt(node);
+	}
+	R visitPostInc(PostIncStmtNode * node){ return self().visitStmt(node); }
+	R visitPostDec(PostDecStmtNode * node){ return self().visitStmt(node); }
+	R visitIf(IfStmtNode * node){ return self().visitStmt(node); }
+	R visitIfElse(IfElseStmtNode * node){ return self().visitStmt(node); }
+	R visitWhile(WhileStmtNode * node){ return self().visitStmt(node); }
+	R visitReturn(ReturnStmtNode * node){ return self().visitStmt(node); }
+
+	R visitAssignExp(AssignExpNode * node){ return self().visitExp(node); }
+	R visitCallExp(CallExpNode * node){ return self().visitExp(node); }
+	R visitPlus(PlusNode * node){ return self().visitBinaryExp(node); }
+	R visitMinus(MinusNode * node){ return self().visitBinaryExp(node); }
+	R visitTimes(TimesNode * node){ return self().visitBinaryExp(node); }
+	R visitDivide(DivideNode * node){ return self().visitBinaryExp(node); }
+	R visitAnd(AndNode * node){ return self().visitBinaryExp(node); }
+	R visitOr(OrNode * node){ return self().visitBinaryExp(node); }
+	R visitEquals(EqualsNode * node){ return self().visitBinaryExp(node); }
+	R visitNotEquals(NotEqualsNode * node){
+		return self().visitBinaryExp(node);
+	}
+	R visitLess(LessNode * node){ return self().visitBinaryExp(node); }
+	R visitGreater(GreaterNode * node){ return self().visitBinaryExp(node); }
+	R visitLessEq(LessEqNode * node){ return self().visitBinaryExp(node); }
+	R visitGreaterEq(GreaterEqNode * node){
+		return self().visitBinaryExp(node);
+	}
+	R visitNeg(NegNode * node){ return self().visitUnaryExp(node); }
+	R visitNot(NotNode * node){ return self().visitUnaryExp(node); }
+	R visitID(IDNode * node){ return self().visitLVal(node); }
+	R visitIntLit(IntLitNode * node){ return self().visitExp(node); }
+	R visitCharLit(CharLitNode * node){ return self().visitExp(node); }
+	R visitStrLit(StrLitNode * node){ return self().visitExp(node); }
+	R visitTrue(TrueNode * node){ return self().visitExp(node); }
+	R visitFalse(FalseNode * node){ return self().visitExp(node); }
+	R visitNullPtr(NullPtrNode * node){ return self().visitExp(node); }
+	R visitDeref(DerefNode * node){ return self().visitLVal(node); }
+	R visitRef(RefNode * node){ return self().visitLVal(node); }
+	R visitIndex(IndexNode * node){ return self().visitLVal(node); }
+
+	//Abstract classes
+	R visitDecl(DeclNode * node){ return self().visitStmt(node); }
+	R visitStmt(StmtNode * node){ return self().visitNode(node); }
+	R visitType(TypeNode * node){ return self().visitNode(node); }
+	R visitBinaryExp(BinaryExpNode * node){ return self().visitExp(node); }
+	R visitUnaryExp(UnaryExpNode * node){ return self().visitExp(node); }
+	R visitLVal(LValNode * node){ return self().visitExp(node); }
+	R visitExp(ExpNode * node){ return self().visitNode(node); }
+	R visitNode(ASTNode *){ return R(); }
+
+protected:
+	Derived& self(){ return *static_cast<Derived *>(this); }
+};
+
+} //End namespace holeyc
+
+#endif
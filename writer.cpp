@@ -0,0 +1,51 @@
+#include "writer.hpp"
+
+namespace holeyc{
+
+static const char TABS[] =
+	"\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t"
+	"\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t";
+
+void Writer::indent(int indent){
+	size_t left = indent > 0 ? static_cast<size_t>(indent) : 0;
+	while (left > 0){
+		size_t chunk = left < sizeof(TABS) - 1 ? left : sizeof(TABS) - 1;
+		write(TABS, chunk);
+		left -= chunk;
+	}
+}
+
+Writer& Writer::operator<<(size_t num){
+	char digits[20];
+	size_t at = sizeof(digits);
+	do {
+		digits[--at] = static_cast<char>('0' + num % 10);
+		num /= 10;
+	} while (num != 0);
+	write(digits + at, sizeof(digits) - at);
+	return *this;
+}
+
+Writer& Writer::operator<<(int num){
+	if (num < 0){
+		*this << '-';
+		/* Negate in unsigned arithmetic so INT_MIN survives */
+		return *this << static_cast<size_t>(
+			0u - static_cast<unsigned>(num));
+	}
+	return *this << static_cast<size_t>(num);
+}
+
+void Writer::drain(){
+	if (myLen > 0){
+		myOut.write(myBuf.get(), static_cast<std::streamsize>(myLen));
+		myLen = 0;
+	}
+}
+
+void Writer::flush(){
+	drain();
+	myOut.flush();
+}
+
+} //End namespace holeyc
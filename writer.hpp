@@ -0,0 +1,78 @@
+#ifndef HOLEYC_WRITER_HPP
+#define HOLEYC_WRITER_HPP
+
+#include <cstring>
+#include <memory>
+#include <ostream>
+#include <string>
+#include "strref.hpp"
+
+namespace holeyc{
+
+/**
+* \class Writer
+* Buffered text sink for the unparse and token dumps. Output is
+* gathered in a large block and handed to the stream only when the
+* block fills, on flush(), or when the Writer goes away; nothing is
+* flushed per line.
+**/
+class Writer{
+public:
+	explicit Writer(std::ostream& out)
+	: myOut(out), myBuf(new char[CAPACITY]), myLen(0){ }
+	~Writer(){ flush(); }
+	Writer(const Writer&) = delete;
+	Writer& operator=(const Writer&) = delete;
+
+	void write(const char * data, size_t size){
+		if (size > CAPACITY - myLen){
+			drain();
+			if (size > CAPACITY){
+				myOut.write(data, static_cast<std::streamsize>(size));
+				return;
+			}
+		}
+		memcpy(myBuf.get() + myLen, data, size);
+		myLen += size;
+	}
+
+	Writer& operator<<(char ch){
+		if (myLen == CAPACITY){ drain(); }
+		myBuf[myLen++] = ch;
+		return *this;
+	}
+	Writer& operator<<(const char * text){
+		write(text, strlen(text));
+		return *this;
+	}
+	Writer& operator<<(StrRef text){
+		write(text.data(), text.size());
+		return *this;
+	}
+	Writer& operator<<(const std::string& text){
+		write(text.data(), text.size());
+		return *this;
+	}
+	Writer& operator<<(int num);
+	Writer& operator<<(size_t num);
+
+	/** indent tabs, copied from a precomputed slab **/
+	void indent(int indent);
+
+	/** Pass everything buffered on to the stream **/
+	void flush();
+
+private:
+	static const size_t CAPACITY = 256 * 1024;
+
+	/** Hand the buffered block to the stream without flushing it **/
+	void drain();
+
+	std::ostream& myOut;
+	std::unique_ptr<char[]> myBuf;
+	size_t myLen;
+};
+
+} //End namespace holeyc
+
+#endif